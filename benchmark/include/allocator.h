@@ -66,6 +66,9 @@ public:
         if (n == 0)
             return nullptr;
 
+        if (alignof(T) > alignof(std::max_align_t))   // 超过默认对齐的类型
+            return static_cast<pointer>(thread_cache.allocate_aligned(n * sizeof(T), alignof(T)));
+
         return static_cast<pointer>(thread_cache.allocate(n * sizeof(T)));
     }
 
@@ -78,7 +81,12 @@ public:
     {
         if (ptr == nullptr)
             return;
-        
+
+        if (alignof(T) > alignof(std::max_align_t)) {
+            thread_cache.deallocate_aligned(ptr, n * sizeof(T), alignof(T));
+            return;
+        }
+
         thread_cache.deallocate(ptr, n * sizeof(T));
     }
 
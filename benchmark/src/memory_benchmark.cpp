@@ -1,103 +1,720 @@
+#include <mutex>
+#include <atomic>
 #include <chrono>
-#include <vector>
+#include <deque>
+#include <random>
+#include <string>
 #include <thread>
-#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
-#include <allocator.h>
+#include <ThreadCache.h>
 
 using namespace WW;
 
-constexpr size_type THREAD = 4;                 // 线程数
-constexpr size_type ROUND = 1000;               // 轮数
-constexpr size_type SIZE = 128;                 // 单次操作内存大小
-constexpr size_type TIMES = 1000;               // 单次测试操作次数
+#ifndef WW_BENCHMARK_MALLOC
+#define WW_BENCHMARK_MALLOC "glibc"             // 可执行文件链接的malloc实现
+#endif
+
+constexpr size_type LATENCY_SAMPLE = 64;        // 每隔多少次操作记录一次耗时
+constexpr size_type SIZE_SAMPLES = 1 << 16;     // 每个线程预先生成的大小数
+constexpr size_type INBOX_CAPACITY = 4;         // 跨线程释放时每个线程最多积压的批数
+constexpr double POWER_LAW_ALPHA = 1.2;         // 幂律分布的指数
+
+using steady_clock = std::chrono::steady_clock;
+using time_point = std::chrono::steady_clock::time_point;
+using nanoseconds = std::chrono::duration<double, std::nano>;
+
+/**
+ * @brief 测试参数
+ */
+class Options
+{
+public:
+    std::vector<std::string> allocators = { "pool", "malloc" };
+    std::vector<std::string> distributions = { "uniform", "powerlaw" };
+    std::vector<std::string> orders = { "lifo", "fifo", "random" };
+    std::vector<std::string> patterns = { "local", "remote" };
+    std::vector<size_type> threads;
+    size_type ops = 1 << 21;                    // 每个线程的申请次数
+    size_type batch = 1000;                     // 每批申请后再释放的数量
+    size_type min_size = 8;                     // 最小内存大小
+    size_type max_size = 4096;                  // 最大内存大小
+    std::string trace;                          // 记录的大小文件
+    std::string format = "text";                // 输出格式
+};
+
+/**
+ * @brief 单次测试的配置
+ */
+class Workload
+{
+public:
+    std::string allocator;
+    std::string distribution;
+    std::string order;
+    std::string pattern;
+    size_type threads;
+};
+
+/**
+ * @brief 单次测试的结果
+ */
+class Result
+{
+public:
+    double seconds = 0;                         // 总耗时
+    double ops_per_second = 0;                  // 每秒申请和释放次数
+    double p50_ns = 0;                          // 单次操作耗时的分位数
+    double p99_ns = 0;
+    double p999_ns = 0;
+    long peak_rss_kb = -1;                      // 测试期间的最大常驻内存，不支持时为-1
+    long peak_live_kb = 0;                      // 同时存活的最大申请内存
+    double fragmentation = -1;                  // 常驻内存中没有被申请使用的比例，不支持时为-1
+};
 
 /**
- * @brief 测试结构
+ * @brief 被测试的分配器
  */
-class TestCase
+class Allocator
 {
 public:
-    char padding[SIZE];
+    void * (*allocate)(size_type);
+    void (*deallocate)(void *, size_type);
 };
 
-using high_resolution_clock = std::chrono::high_resolution_clock;
-using time_point = std::chrono::high_resolution_clock::time_point;
-using duration = std::chrono::duration<double, std::milli>;
+void * pool_allocate(size_type size)
+{
+    return ThreadCache::get_thread_cache().allocate(size);
+}
 
-int main()
+void pool_deallocate(void * ptr, size_type size)
 {
-    printf("================================== MEMORY BENCHMARK =======================================\n");
-    printf("=== MALLOC TEST ===========================================================================\n");
+    ThreadCache::get_thread_cache().deallocate(ptr, size);
+}
 
-    // malloc测试
-    std::vector<std::thread> malloc_threads;
-    malloc_threads.reserve(THREAD);
+void * malloc_allocate(size_type size)
+{
+    return std::malloc(size);
+}
 
-    time_point malloc_start = high_resolution_clock::now();
+void malloc_deallocate(void * ptr, size_type size)
+{
+    (void)size;
+    std::free(ptr);
+}
 
-    for (size_type i = 0; i < THREAD; i++) {
-        malloc_threads.emplace_back([]() {
-            
-            for (size_type j = 0; j < ROUND; j++) {
-                std::vector<void *> ptrs;
-                ptrs.reserve(TIMES);
+Allocator get_allocator(const std::string & name)
+{
+    if (name == "pool") {
+        return Allocator{ pool_allocate, pool_deallocate };
+    }
 
-                for (size_type k = 0; k < TIMES; k++) {
-                    void * ptr = malloc(SIZE);
-                    ptrs.emplace_back(ptr);
-                }
+    return Allocator{ malloc_allocate, malloc_deallocate };
+}
 
-                for (void * ptr : ptrs) {
-                    free(ptr);
-                }
+/**
+ * @brief 拆分逗号分隔的参数
+ */
+std::vector<std::string> split(const std::string & value)
+{
+    std::vector<std::string> items;
+    size_type begin = 0;
+    while (begin <= value.size()) {
+        size_type end = value.find(',', begin);
+        if (end == std::string::npos) {
+            end = value.size();
+        }
+        if (end > begin) {
+            items.emplace_back(value.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return items;
+}
+
+/**
+ * @brief 默认从1个线程翻倍到CPU数
+ */
+std::vector<size_type> default_threads()
+{
+    size_type cpus = std::thread::hardware_concurrency();
+    if (cpus == 0) {
+        cpus = 1;
+    }
+
+    std::vector<size_type> threads;
+    for (size_type count = 1; count < cpus; count <<= 1) {
+        threads.emplace_back(count);
+    }
+    threads.emplace_back(cpus);
+    return threads;
+}
+
+/**
+ * @brief 读取记录的大小文件
+ * @details 每行一个大小，或者`大小 次数`，`#`开头的行为注释
+ */
+std::vector<size_type> load_trace(const std::string & path)
+{
+    std::vector<size_type> sizes;
+    FILE * file = std::fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        std::fprintf(stderr, "cannot open trace %s\n", path.c_str());
+        std::exit(1);
+    }
+
+    char line[256];
+    while (std::fgets(line, sizeof(line), file) != nullptr) {
+        if (line[0] == '#') {
+            continue;
+        }
+
+        unsigned long long size = 0;
+        unsigned long long count = 1;
+        int fields = std::sscanf(line, "%llu %llu", &size, &count);
+        if (fields < 1 || size == 0) {
+            continue;
+        }
+
+        for (unsigned long long i = 0; i < count && sizes.size() < SIZE_SAMPLES; ++i) {
+            sizes.emplace_back(static_cast<size_type>(size));
+        }
+    }
+
+    std::fclose(file);
+    if (sizes.empty()) {
+        std::fprintf(stderr, "trace %s has no sizes\n", path.c_str());
+        std::exit(1);
+    }
+    return sizes;
+}
+
+/**
+ * @brief 按分布生成一个线程使用的大小序列
+ */
+std::vector<size_type> make_sizes(const Options & options, const std::string & distribution,
+    const std::vector<size_type> & trace, std::mt19937_64 & engine)
+{
+    std::vector<size_type> sizes;
+    sizes.reserve(SIZE_SAMPLES);
+
+    if (distribution == "trace") {
+        // 从记录中随机抽样，保持原有的大小比例
+        std::uniform_int_distribution<size_type> pick(0, trace.size() - 1);
+        for (size_type i = 0; i < SIZE_SAMPLES; ++i) {
+            sizes.emplace_back(trace[pick(engine)]);
+        }
+    } else if (distribution == "powerlaw") {
+        // 帕累托分布，小内存占多数，偶尔出现大内存
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        for (size_type i = 0; i < SIZE_SAMPLES; ++i) {
+            double size = options.min_size * std::pow(1.0 - uniform(engine), -1.0 / POWER_LAW_ALPHA);
+            sizes.emplace_back(size > options.max_size ? options.max_size : static_cast<size_type>(size));
+        }
+    } else {
+        std::uniform_int_distribution<size_type> uniform(options.min_size, options.max_size);
+        for (size_type i = 0; i < SIZE_SAMPLES; ++i) {
+            sizes.emplace_back(uniform(engine));
+        }
+    }
+
+    return sizes;
+}
+
+/**
+ * @brief 一批内存块
+ */
+class Batch
+{
+public:
+    std::vector<void *> ptrs;
+    std::vector<size_type> sizes;
+    size_type bytes = 0;
+};
+
+/**
+ * @brief 跨线程释放时接收其他线程的批次
+ */
+class Inbox
+{
+public:
+    std::mutex mutex;
+    std::deque<Batch> batches;
+};
+
+/**
+ * @brief 单个线程的测试状态
+ */
+class Worker
+{
+public:
+    Allocator allocator;
+    std::string order;
+    std::vector<size_type> sizes;
+    std::vector<double> latencies;
+    std::mt19937_64 engine;
+    size_type next_size = 0;
+    size_type ops = 0;
+
+    /**
+     * @brief 申请一批内存块，每隔`LATENCY_SAMPLE`次记录耗时
+     */
+    void fill(Batch & batch, size_type count)
+    {
+        batch.ptrs.clear();
+        batch.sizes.clear();
+        batch.bytes = 0;
+
+        for (size_type i = 0; i < count; ++i) {
+            size_type size = sizes[next_size++ % sizes.size()];
+            void * ptr = nullptr;
+            if (++ops % LATENCY_SAMPLE == 0) {
+                time_point start = steady_clock::now();
+                ptr = allocator.allocate(size);
+                latencies.emplace_back(nanoseconds(steady_clock::now() - start).count());
+            } else {
+                ptr = allocator.allocate(size);
             }
-        });
+
+            // 写入首字节，使内存真正被访问
+            static_cast<char *>(ptr)[0] = 1;
+            batch.ptrs.emplace_back(ptr);
+            batch.sizes.emplace_back(size);
+            batch.bytes += size;
+        }
     }
 
-    for (auto & thread : malloc_threads) {
-        thread.join();
+    /**
+     * @brief 按释放顺序释放一批内存块
+     */
+    void drain(Batch & batch)
+    {
+        size_type count = batch.ptrs.size();
+        if (order == "random") {
+            for (size_type i = count; i > 1; --i) {
+                size_type j = std::uniform_int_distribution<size_type>(0, i - 1)(engine);
+                std::swap(batch.ptrs[i - 1], batch.ptrs[j]);
+                std::swap(batch.sizes[i - 1], batch.sizes[j]);
+            }
+        } else if (order == "lifo") {
+            std::reverse(batch.ptrs.begin(), batch.ptrs.end());
+            std::reverse(batch.sizes.begin(), batch.sizes.end());
+        }
+
+        for (size_type i = 0; i < count; ++i) {
+            if (++ops % LATENCY_SAMPLE == 0) {
+                time_point start = steady_clock::now();
+                allocator.deallocate(batch.ptrs[i], batch.sizes[i]);
+                latencies.emplace_back(nanoseconds(steady_clock::now() - start).count());
+            } else {
+                allocator.deallocate(batch.ptrs[i], batch.sizes[i]);
+            }
+        }
+
+        batch.ptrs.clear();
+        batch.sizes.clear();
+    }
+};
+
+/**
+ * @brief 读取`/proc/self/status`中的字段，单位为KB
+ */
+long read_status_kb(const char * field)
+{
+#if defined(__linux__)
+    FILE * file = std::fopen("/proc/self/status", "r");
+    if (file == nullptr) {
+        return -1;
+    }
+
+    long value = -1;
+    char line[256];
+    size_type length = std::strlen(field);
+    while (std::fgets(line, sizeof(line), file) != nullptr) {
+        if (std::strncmp(line, field, length) == 0 && line[length] == ':') {
+            value = std::strtol(line + length + 1, nullptr, 10);
+            break;
+        }
+    }
+
+    std::fclose(file);
+    return value;
+#else
+    (void)field;
+    return -1;
+#endif
+}
+
+/**
+ * @brief 重置最大常驻内存，之后`VmHWM`从当前常驻内存开始统计
+ */
+bool reset_peak_rss()
+{
+#if defined(__linux__)
+    FILE * file = std::fopen("/proc/self/clear_refs", "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool reset = std::fputs("5", file) >= 0;
+    reset = std::fclose(file) == 0 && reset;
+    return reset;
+#else
+    return false;
+#endif
+}
+
+double percentile(std::vector<double> & values, double rank)
+{
+    if (values.empty()) {
+        return 0;
+    }
+
+    size_type index = static_cast<size_type>(rank * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+/**
+ * @brief 运行一次测试
+ * @details `local`每个线程释放自己申请的内存，`remote`每个线程把申请的批次交给下一个线程释放
+ */
+Result run(const Options & options, const Workload & workload, const std::vector<size_type> & trace)
+{
+    size_type threads = workload.threads;
+    size_type rounds = (options.ops + options.batch - 1) / options.batch;
+    std::vector<Worker> workers(threads);
+    std::vector<Inbox> inboxes(threads);
+    std::atomic<size_type> live_bytes(0);
+    std::atomic<size_type> peak_bytes(0);
+
+    for (size_type i = 0; i < threads; ++i) {
+        workers[i].allocator = get_allocator(workload.allocator);
+        workers[i].order = workload.order;
+        workers[i].engine.seed(42 + i);
+        workers[i].sizes = make_sizes(options, workload.distribution, trace, workers[i].engine);
+        workers[i].latencies.reserve(2 * rounds * options.batch / LATENCY_SAMPLE + 1);
     }
 
-    time_point malloc_end = high_resolution_clock::now();
-    duration malloc_duration = malloc_end - malloc_start;
+    auto add_live = [&](size_type bytes) {
+        size_type live = live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_type peak = peak_bytes.load(std::memory_order_relaxed);
+        while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+    };
 
-    printf("%zu threads operated %zu rounds with %zu times each malloc and free, cost %.2f ms\n", THREAD, ROUND, TIMES, malloc_duration.count());
-    printf("=== MEMORY POOL TEST ======================================================================\n");
+    long baseline_rss = read_status_kb("VmRSS");
+    bool peak_reset = reset_peak_rss();
 
-    // memory-pool测试
-    std::vector<std::thread> pool_threads;
-    pool_threads.reserve(THREAD);
+    std::vector<std::thread> pool;
+    time_point start = steady_clock::now();
 
-    time_point pool_start = high_resolution_clock::now();
+    for (size_type i = 0; i < threads; ++i) {
+        pool.emplace_back([&, i]() {
+            Worker & worker = workers[i];
+            Batch batch;
 
-    for (size_type i = 0; i < THREAD; ++i) {
-        pool_threads.emplace_back([i]() {
-            allocator<TestCase> alloc;
-            
-            for (size_type j = 0; j < ROUND; ++j) {
-                std::vector<TestCase *> ptrs;
-                ptrs.reserve(TIMES);
+            if (workload.pattern == "local") {
+                for (size_type round = 0; round < rounds; ++round) {
+                    worker.fill(batch, options.batch);
+                    add_live(batch.bytes);
+                    size_type bytes = batch.bytes;
+                    worker.drain(batch);
+                    live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+                }
+                return;
+            }
+
+            // 交给下一个线程释放，同时释放上一个线程交来的批次
+            Inbox & own = inboxes[i];
+            Inbox & next = inboxes[(i + 1) % threads];
+            size_type received = 0;
 
-                for (size_type k = 0; k < TIMES; ++k) {
-                    TestCase * ptr = alloc.allocate(1);
-                    ptrs.emplace_back(ptr);
+            auto drain_own = [&]() {
+                Batch incoming;
+                {
+                    std::lock_guard<std::mutex> lock(own.mutex);
+                    if (own.batches.empty()) {
+                        return false;
+                    }
+                    incoming = std::move(own.batches.front());
+                    own.batches.pop_front();
                 }
 
-                for (size_type k = 0; k < TIMES; ++k) {
-                    alloc.deallocate(ptrs[k], 1);
+                size_type bytes = incoming.bytes;
+                worker.drain(incoming);
+                live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+                ++received;
+                return true;
+            };
+
+            for (size_type round = 0; round < rounds; ++round) {
+                worker.fill(batch, options.batch);
+                add_live(batch.bytes);
+
+                for (;;) {
+                    {
+                        std::lock_guard<std::mutex> lock(next.mutex);
+                        if (next.batches.size() < INBOX_CAPACITY) {
+                            next.batches.emplace_back(std::move(batch));
+                            break;
+                        }
+                    }
+
+                    // 下一个线程积压过多，先处理自己的
+                    if (!drain_own()) {
+                        std::this_thread::yield();
+                    }
+                }
+                batch = Batch();
+            }
+
+            while (received < rounds) {
+                if (!drain_own()) {
+                    std::this_thread::yield();
                 }
             }
         });
     }
 
-    for (auto & thread : pool_threads) {
+    for (std::thread & thread : pool) {
         thread.join();
     }
 
-    time_point pool_end = high_resolution_clock::now();
-    duration pool_duration = pool_end - pool_start;
+    Result result;
+    result.seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+    result.ops_per_second = 2.0 * rounds * options.batch * threads / result.seconds;
+
+    std::vector<double> latencies;
+    for (Worker & worker : workers) {
+        latencies.insert(latencies.end(), worker.latencies.begin(), worker.latencies.end());
+    }
+    result.p50_ns = percentile(latencies, 0.5);
+    result.p99_ns = percentile(latencies, 0.99);
+    result.p999_ns = percentile(latencies, 0.999);
+
+    result.peak_live_kb = static_cast<long>(peak_bytes.load() / 1024);
+    long peak_rss = read_status_kb("VmHWM");
+    if (peak_reset && peak_rss >= 0 && baseline_rss >= 0) {
+        result.peak_rss_kb = peak_rss;
+        long grown = peak_rss - baseline_rss;
+        if (grown > 0) {
+            double used = static_cast<double>(result.peak_live_kb) / grown;
+            result.fragmentation = used >= 1.0 ? 0.0 : 1.0 - used;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief 在子进程中运行，每次测试的常驻内存和分配器状态互不影响
+ */
+Result run_isolated(const Options & options, const Workload & workload, const std::vector<size_type> & trace)
+{
+#if defined(__linux__)
+    int fds[2];
+    if (pipe(fds) == 0) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            Result result = run(options, workload, trace);
+            ssize_t written = write(fds[1], &result, sizeof(result));
+            _exit(written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+        }
+
+        close(fds[1]);
+        if (pid > 0) {
+            Result result;
+            ssize_t length = read(fds[0], &result, sizeof(result));
+            int status = 0;
+            waitpid(pid, &status, 0);
+            close(fds[0]);
+            if (length == static_cast<ssize_t>(sizeof(result))) {
+                return result;
+            }
+
+            std::fprintf(stderr, "benchmark child failed\n");
+            std::exit(1);
+        }
+        close(fds[0]);
+    }
+#endif
+
+    return run(options, workload, trace);
+}
+
+std::string allocator_name(const std::string & allocator)
+{
+    return allocator == "pool" ? "ww-memory-pool" : WW_BENCHMARK_MALLOC;
+}
+
+void print_header(const Options & options)
+{
+    if (options.format == "csv") {
+        std::printf("allocator,distribution,order,pattern,threads,seconds,ops_per_sec,"
+            "p50_ns,p99_ns,p999_ns,peak_rss_kb,peak_live_kb,fragmentation\n");
+    } else if (options.format == "json") {
+        std::printf("[\n");
+    } else {
+        std::printf("%-16s %-9s %-6s %-6s %7s %12s %8s %8s %9s %12s %12s %6s\n",
+            "allocator", "sizes", "order", "free", "threads", "ops/s",
+            "p50(ns)", "p99(ns)", "p999(ns)", "peak_rss(KB)", "live(KB)", "frag");
+    }
+}
+
+void print_result(const Options & options, const Workload & workload, const Result & result, bool first)
+{
+    std::string name = allocator_name(workload.allocator);
+    if (options.format == "csv") {
+        std::printf("%s,%s,%s,%s,%zu,%.6f,%.0f,%.1f,%.1f,%.1f,%ld,%ld,%.4f\n",
+            name.c_str(), workload.distribution.c_str(), workload.order.c_str(), workload.pattern.c_str(),
+            workload.threads, result.seconds, result.ops_per_second,
+            result.p50_ns, result.p99_ns, result.p999_ns,
+            result.peak_rss_kb, result.peak_live_kb, result.fragmentation);
+    } else if (options.format == "json") {
+        std::printf("%s  {\"allocator\": \"%s\", \"distribution\": \"%s\", \"order\": \"%s\", \"pattern\": \"%s\", "
+            "\"threads\": %zu, \"seconds\": %.6f, \"ops_per_sec\": %.0f, "
+            "\"p50_ns\": %.1f, \"p99_ns\": %.1f, \"p999_ns\": %.1f, "
+            "\"peak_rss_kb\": %ld, \"peak_live_kb\": %ld, \"fragmentation\": %.4f}",
+            first ? "" : ",\n",
+            name.c_str(), workload.distribution.c_str(), workload.order.c_str(), workload.pattern.c_str(),
+            workload.threads, result.seconds, result.ops_per_second,
+            result.p50_ns, result.p99_ns, result.p999_ns,
+            result.peak_rss_kb, result.peak_live_kb, result.fragmentation);
+    } else {
+        std::printf("%-16s %-9s %-6s %-6s %7zu %12.0f %8.1f %8.1f %9.1f %12ld %12ld %6.3f\n",
+            name.c_str(), workload.distribution.c_str(), workload.order.c_str(), workload.pattern.c_str(),
+            workload.threads, result.ops_per_second,
+            result.p50_ns, result.p99_ns, result.p999_ns,
+            result.peak_rss_kb, result.peak_live_kb, result.fragmentation);
+    }
+    std::fflush(stdout);
+}
+
+void print_footer(const Options & options)
+{
+    if (options.format == "json") {
+        std::printf("\n]\n");
+    }
+}
+
+void usage(const char * program)
+{
+    std::printf("usage: %s [options]\n"
+        "  --allocators=pool,malloc        allocators to compare, malloc is %s\n"
+        "  --sizes=uniform,powerlaw,trace  size distributions\n"
+        "  --trace=FILE                    recorded sizes, one per line or \"size count\"\n"
+        "  --min-size=N --max-size=N       size range for uniform and powerlaw\n"
+        "  --orders=lifo,fifo,random       free order inside each batch\n"
+        "  --patterns=local,remote         free in the same thread or in the next thread\n"
+        "  --threads=1,2,4                 thread counts, default doubles up to nproc\n"
+        "  --ops=N                         allocations per thread\n"
+        "  --batch=N                       allocations before each free pass\n"
+        "  --format=text|csv|json          output format\n",
+        program, WW_BENCHMARK_MALLOC);
+}
+
+Options parse(int argc, char * argv[])
+{
+    Options options;
+    options.threads = default_threads();
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_type equal = arg.find('=');
+        std::string key = arg.substr(0, equal);
+        std::string value = equal == std::string::npos ? "" : arg.substr(equal + 1);
+
+        if (key == "--allocators") {
+            options.allocators = split(value);
+        } else if (key == "--sizes") {
+            options.distributions = split(value);
+        } else if (key == "--trace") {
+            options.trace = value;
+        } else if (key == "--min-size") {
+            options.min_size = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "--max-size") {
+            options.max_size = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "--orders") {
+            options.orders = split(value);
+        } else if (key == "--patterns") {
+            options.patterns = split(value);
+        } else if (key == "--threads") {
+            options.threads.clear();
+            for (const std::string & item : split(value)) {
+                options.threads.emplace_back(std::strtoull(item.c_str(), nullptr, 10));
+            }
+        } else if (key == "--ops") {
+            options.ops = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "--batch") {
+            options.batch = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "--format") {
+            options.format = value;
+        } else {
+            usage(argv[0]);
+            std::exit(key == "--help" ? 0 : 1);
+        }
+    }
+
+    // 指定记录文件时默认使用记录的大小
+    if (!options.trace.empty() && std::find(options.distributions.begin(), options.distributions.end(), "trace") == options.distributions.end()) {
+        options.distributions.emplace_back("trace");
+    }
+
+    if (options.min_size == 0) {
+        options.min_size = 1;
+    }
+    if (options.max_size < options.min_size) {
+        options.max_size = options.min_size;
+    }
+    if (options.batch == 0) {
+        options.batch = 1;
+    }
+
+    return options;
+}
+
+int main(int argc, char * argv[])
+{
+    Options options = parse(argc, argv);
+
+    std::vector<size_type> trace;
+    if (std::find(options.distributions.begin(), options.distributions.end(), "trace") != options.distributions.end()) {
+        if (options.trace.empty()) {
+            std::fprintf(stderr, "--sizes=trace requires --trace=FILE\n");
+            return 1;
+        }
+        trace = load_trace(options.trace);
+    }
+
+    print_header(options);
+
+    bool first = true;
+    for (const std::string & distribution : options.distributions) {
+        for (const std::string & pattern : options.patterns) {
+            for (const std::string & order : options.orders) {
+                for (size_type threads : options.threads) {
+                    for (const std::string & allocator : options.allocators) {
+                        Workload workload{ allocator, distribution, order, pattern, threads == 0 ? 1 : threads };
+                        Result result = run_isolated(options, workload, trace);
+                        print_result(options, workload, result, first);
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
 
-    printf("%zu threads operated %zu rounds with %zu times each allocate and deallocate, cost %.2f ms\n", THREAD, ROUND, TIMES, pool_duration.count());
-    printf("===========================================================================================\n");
-}
\ No newline at end of file
+    print_footer(options);
+}
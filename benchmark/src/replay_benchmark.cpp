@@ -0,0 +1,482 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#include <ThreadCache.h>
+#include <RemoteFree.h>
+#include <Trace.h>
+
+using namespace WW;
+
+#ifndef WW_BENCHMARK_MALLOC
+#define WW_BENCHMARK_MALLOC "glibc"             // 可执行文件链接的malloc实现
+#endif
+
+using steady_clock = std::chrono::steady_clock;
+
+/**
+ * @brief 测试参数
+ */
+class Options
+{
+public:
+    std::string trace;                          // 轨迹文件
+    std::vector<std::string> allocators = { "pool", "pool-remote", "malloc" };
+    std::string mode = "relaxed";               // 线程间的同步方式
+    size_type repeat = 1;                       // 每种分配器重复次数
+    std::string format = "text";                // 输出格式
+};
+
+/**
+ * @brief 回放的一次操作
+ */
+class Operation
+{
+public:
+    size_type sequence;                         // 全局顺序
+    size_type slot;                             // 内存块编号，对应`Replay::slots`
+    size_type size;                             // 内存大小，不带大小释放时为0
+    bool allocate;                              // 是否为申请
+};
+
+/**
+ * @brief 整理后的轨迹
+ */
+class Replay
+{
+public:
+    std::vector<std::vector<Operation>> threads;    // 每个线程按原顺序执行的操作
+    std::vector<size_type> sizes;                   // 每个内存块的申请大小
+    size_type operations = 0;                       // 操作总数
+    size_type skipped = 0;                          // 找不到申请的释放数
+    size_type peak_live_bytes = 0;                  // 按全局顺序同时存活的最大申请内存
+};
+
+/**
+ * @brief 单次回放的结果
+ */
+class Result
+{
+public:
+    double seconds = 0;                         // 总耗时
+    double ops_per_second = 0;                  // 每秒申请和释放次数
+    long peak_rss_kb = -1;                      // 回放期间的最大常驻内存，不支持时为-1
+};
+
+/**
+ * @brief 被测试的分配器
+ */
+class Allocator
+{
+public:
+    void * (*allocate)(size_type);
+    void (*deallocate)(void *, size_type);
+};
+
+void * pool_allocate(size_type size)
+{
+    return ThreadCache::get_thread_cache().allocate(size);
+}
+
+void pool_deallocate(void * ptr, size_type size)
+{
+    // 保持记录时是否带大小
+    if (size == 0) {
+        ThreadCache::get_thread_cache().deallocate(ptr);
+    } else {
+        ThreadCache::get_thread_cache().deallocate(ptr, size);
+    }
+}
+
+void * malloc_allocate(size_type size)
+{
+    return std::malloc(size);
+}
+
+void malloc_deallocate(void * ptr, size_type size)
+{
+    (void)size;
+    std::free(ptr);
+}
+
+Allocator get_allocator(const std::string & name)
+{
+    if (name == "pool" || name == "pool-remote") {
+        return Allocator{ pool_allocate, pool_deallocate };
+    }
+
+    return Allocator{ malloc_allocate, malloc_deallocate };
+}
+
+/**
+ * @brief 拆分逗号分隔的参数
+ */
+std::vector<std::string> split(const std::string & value)
+{
+    std::vector<std::string> items;
+    size_type begin = 0;
+    while (begin <= value.size()) {
+        size_type end = value.find(',', begin);
+        if (end == std::string::npos) {
+            end = value.size();
+        }
+        if (end > begin) {
+            items.emplace_back(value.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return items;
+}
+
+/**
+ * @brief 整理轨迹
+ * @details 按每个线程累加的时间恢复全局顺序，同一时间保持文件中的顺序。地址在释放后会被重新使用，
+ * 所以每次申请分配新的内存块编号，释放对应同一地址最近一次申请
+ */
+Replay prepare(const std::vector<TraceEvent> & events)
+{
+    class Timed
+    {
+    public:
+        std::uint64_t time;
+        size_type index;
+    };
+
+    std::vector<std::uint64_t> clocks;
+    std::vector<Timed> order;
+    order.reserve(events.size());
+    for (size_type i = 0; i < events.size(); ++i) {
+        const TraceEvent & event = events[i];
+        if (event.thread >= clocks.size()) {
+            clocks.resize(event.thread + 1, 0);
+        }
+
+        clocks[event.thread] += event.delta;
+        if (event.type == static_cast<std::uint16_t>(TraceEventType::TIME)) {
+            clocks[event.thread] += event.size;
+            continue;
+        }
+        order.emplace_back(Timed{ clocks[event.thread], i });
+    }
+
+    std::stable_sort(order.begin(), order.end(), [](const Timed & a, const Timed & b) {
+        return a.time < b.time;
+    });
+
+    Replay replay;
+    replay.threads.resize(clocks.size());
+    std::unordered_map<std::uint64_t, size_type> live;
+    size_type live_bytes = 0;
+    for (const Timed & timed : order) {
+        const TraceEvent & event = events[timed.index];
+        Operation operation{ replay.operations, 0, static_cast<size_type>(event.size), false };
+
+        if (event.type == static_cast<std::uint16_t>(TraceEventType::ALLOCATE)) {
+            operation.slot = replay.sizes.size();
+            operation.allocate = true;
+            replay.sizes.emplace_back(operation.size);
+            live[event.object] = operation.slot;
+            live_bytes += operation.size;
+            replay.peak_live_bytes = std::max(replay.peak_live_bytes, live_bytes);
+        } else {
+            auto it = live.find(event.object);
+            if (it == live.end()) {
+                // 开始记录之前申请的内存
+                ++replay.skipped;
+                continue;
+            }
+            operation.slot = it->second;
+            live.erase(it);
+            live_bytes -= replay.sizes[operation.slot];
+        }
+
+        replay.threads[event.thread].emplace_back(operation);
+        ++replay.operations;
+    }
+
+    return replay;
+}
+
+/**
+ * @brief 读取`/proc/self/status`中的字段，单位为KB
+ */
+long read_status_kb(const char * field)
+{
+#if defined(__linux__)
+    FILE * file = std::fopen("/proc/self/status", "r");
+    if (file == nullptr) {
+        return -1;
+    }
+
+    long value = -1;
+    char line[256];
+    size_type length = std::strlen(field);
+    while (std::fgets(line, sizeof(line), file) != nullptr) {
+        if (std::strncmp(line, field, length) == 0 && line[length] == ':') {
+            value = std::strtol(line + length + 1, nullptr, 10);
+            break;
+        }
+    }
+
+    std::fclose(file);
+    return value;
+#else
+    (void)field;
+    return -1;
+#endif
+}
+
+/**
+ * @brief 重置最大常驻内存，之后`VmHWM`从当前常驻内存开始统计
+ */
+bool reset_peak_rss()
+{
+#if defined(__linux__)
+    FILE * file = std::fopen("/proc/self/clear_refs", "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool reset = std::fputs("5", file) >= 0;
+    reset = std::fclose(file) == 0 && reset;
+    return reset;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief 每个记录的线程对应一个回放线程
+ * @details `strict`严格按照全局顺序执行，`relaxed`只在释放其他线程申请的内存时等待申请完成
+ */
+Result run(const Options & options, const std::string & name, const Replay & replay)
+{
+    Allocator allocator = get_allocator(name);
+    RemoteFree::get_remote_free().set_enabled(name == "pool-remote");
+    bool strict = options.mode == "strict";
+
+    std::unique_ptr<std::atomic<void *>[]> slots(new std::atomic<void *>[replay.sizes.size()]);
+    for (size_type i = 0; i < replay.sizes.size(); ++i) {
+        slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+    std::atomic<size_type> sequence(0);
+
+    bool peak_reset = reset_peak_rss();
+    std::atomic<bool> go(false);
+    std::vector<std::thread> pool;
+    for (const std::vector<Operation> & operations : replay.threads) {
+        pool.emplace_back([&]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            for (const Operation & operation : operations) {
+                if (strict) {
+                    while (sequence.load(std::memory_order_acquire) != operation.sequence) {
+                        std::this_thread::yield();
+                    }
+                }
+
+                if (operation.allocate) {
+                    void * ptr = allocator.allocate(operation.size);
+                    slots[operation.slot].store(ptr, std::memory_order_release);
+                } else {
+                    void * ptr = slots[operation.slot].load(std::memory_order_acquire);
+                    while (ptr == nullptr) {
+                        std::this_thread::yield();
+                        ptr = slots[operation.slot].load(std::memory_order_acquire);
+                    }
+                    allocator.deallocate(ptr, operation.size);
+                    slots[operation.slot].store(nullptr, std::memory_order_relaxed);
+                }
+
+                if (strict) {
+                    sequence.store(operation.sequence + 1, std::memory_order_release);
+                }
+            }
+        });
+    }
+
+    steady_clock::time_point start = steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread & thread : pool) {
+        thread.join();
+    }
+
+    Result result;
+    result.seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+    result.ops_per_second = result.seconds > 0 ? replay.operations / result.seconds : 0;
+    long peak_rss = read_status_kb("VmHWM");
+    if (peak_reset && peak_rss >= 0) {
+        result.peak_rss_kb = peak_rss;
+    }
+
+    // 轨迹结束时仍然存活的内存
+    for (size_type i = 0; i < replay.sizes.size(); ++i) {
+        void * ptr = slots[i].load(std::memory_order_relaxed);
+        if (ptr != nullptr) {
+            allocator.deallocate(ptr, replay.sizes[i]);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief 在子进程中运行，每次回放的常驻内存和分配器状态互不影响
+ */
+Result run_isolated(const Options & options, const std::string & name, const Replay & replay)
+{
+#if defined(__linux__)
+    int fds[2];
+    if (pipe(fds) == 0) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            Result result = run(options, name, replay);
+            ssize_t written = write(fds[1], &result, sizeof(result));
+            _exit(written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+        }
+
+        close(fds[1]);
+        if (pid > 0) {
+            Result result;
+            ssize_t length = read(fds[0], &result, sizeof(result));
+            int status = 0;
+            waitpid(pid, &status, 0);
+            close(fds[0]);
+            if (length == static_cast<ssize_t>(sizeof(result))) {
+                return result;
+            }
+
+            std::fprintf(stderr, "replay child failed\n");
+            std::exit(1);
+        }
+        close(fds[0]);
+    }
+#endif
+
+    return run(options, name, replay);
+}
+
+std::string allocator_name(const std::string & allocator)
+{
+    if (allocator == "pool") {
+        return "ww-memory-pool";
+    } else if (allocator == "pool-remote") {
+        return "ww-memory-pool-remote";
+    }
+    return WW_BENCHMARK_MALLOC;
+}
+
+void print_header(const Options & options)
+{
+    if (options.format == "csv") {
+        std::printf("allocator,mode,threads,operations,seconds,ops_per_sec,peak_rss_kb,peak_live_kb\n");
+    } else {
+        std::printf("%-22s %-8s %7s %12s %10s %12s %12s %12s\n",
+            "allocator", "mode", "threads", "operations", "seconds", "ops/s", "peak_rss(KB)", "live(KB)");
+    }
+}
+
+void print_result(const Options & options, const std::string & allocator, const Replay & replay, const Result & result)
+{
+    std::string name = allocator_name(allocator);
+    long live_kb = static_cast<long>(replay.peak_live_bytes / 1024);
+    if (options.format == "csv") {
+        std::printf("%s,%s,%zu,%zu,%.6f,%.0f,%ld,%ld\n",
+            name.c_str(), options.mode.c_str(), replay.threads.size(), replay.operations,
+            result.seconds, result.ops_per_second, result.peak_rss_kb, live_kb);
+    } else {
+        std::printf("%-22s %-8s %7zu %12zu %10.4f %12.0f %12ld %12ld\n",
+            name.c_str(), options.mode.c_str(), replay.threads.size(), replay.operations,
+            result.seconds, result.ops_per_second, result.peak_rss_kb, live_kb);
+    }
+    std::fflush(stdout);
+}
+
+void usage(const char * program)
+{
+    std::printf("usage: %s --trace=FILE [options]\n"
+        "  --trace=FILE                         trace recorded with WW_TRACE=FILE\n"
+        "  --allocators=pool,pool-remote,malloc allocators to compare, malloc is %s\n"
+        "  --mode=relaxed|strict                relaxed only waits for cross-thread frees,\n"
+        "                                       strict follows the recorded global order\n"
+        "  --repeat=N                           runs per allocator\n"
+        "  --format=text|csv                    output format\n",
+        program, WW_BENCHMARK_MALLOC);
+}
+
+Options parse(int argc, char * argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_type equal = arg.find('=');
+        std::string key = arg.substr(0, equal);
+        std::string value = equal == std::string::npos ? "" : arg.substr(equal + 1);
+
+        if (key == "--trace") {
+            options.trace = value;
+        } else if (key == "--allocators") {
+            options.allocators = split(value);
+        } else if (key == "--mode" && (value == "relaxed" || value == "strict")) {
+            options.mode = value;
+        } else if (key == "--repeat") {
+            options.repeat = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "--format") {
+            options.format = value;
+        } else {
+            usage(argv[0]);
+            std::exit(key == "--help" ? 0 : 1);
+        }
+    }
+
+    if (options.trace.empty()) {
+        usage(argv[0]);
+        std::exit(1);
+    }
+    if (options.repeat == 0) {
+        options.repeat = 1;
+    }
+
+    return options;
+}
+
+int main(int argc, char * argv[])
+{
+    Options options = parse(argc, argv);
+
+    std::vector<TraceEvent> events;
+    if (!Trace::load(options.trace.c_str(), events)) {
+        std::fprintf(stderr, "cannot load trace: %s\n", options.trace.c_str());
+        return 1;
+    }
+
+    Replay replay = prepare(events);
+    if (replay.skipped > 0) {
+        std::fprintf(stderr, "skipped %zu frees without a recorded allocation\n", replay.skipped);
+    }
+
+    print_header(options);
+    for (const std::string & allocator : options.allocators) {
+        for (size_type i = 0; i < options.repeat; ++i) {
+            Result result = run_isolated(options, allocator, replay);
+            print_result(options, allocator, replay, result);
+        }
+    }
+}
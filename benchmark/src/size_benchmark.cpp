@@ -0,0 +1,111 @@
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include <Size.h>
+
+using namespace WW;
+
+constexpr size_type COUNT = 1 << 20;            // 大小样本数
+constexpr size_type ROUND = 100;                // 轮数
+
+using high_resolution_clock = std::chrono::high_resolution_clock;
+using time_point = std::chrono::high_resolution_clock::time_point;
+using duration = std::chrono::duration<double, std::milli>;
+
+/**
+ * @brief 分支判断实现的对齐和索引计算，作为对照
+ */
+__attribute__((noinline)) size_type ladder_round_up(size_type size)
+{
+    if (size <= 128) {
+        return (size + 8 - 1) & ~(8 - 1);
+    } else if (size <= 1024) {
+        return (size + 16 - 1) & ~(16 - 1);
+    } else if (size <= 8192) {
+        return (size + 128 - 1) & ~(128 - 1);
+    } else if (size <= 65536) {
+        return (size + 1024 - 1) & ~(1024 - 1);
+    } else {
+        return (size + 8192 - 1) & ~(8192 - 1);
+    }
+}
+
+__attribute__((noinline)) size_type ladder_size_to_index(size_type size)
+{
+    if (size <= 128) {
+        return (size + 7) / 8 - 1;
+    } else if (size <= 1024) {
+        return 16 + (size - 129) / 16;
+    } else if (size <= 8192) {
+        return 72 + (size - 1025) / 128;
+    } else if (size <= 65536) {
+        return 128 + (size - 8193) / 1024;
+    } else {
+        return 184 + (size - 65537) / 8192;
+    }
+}
+
+/**
+ * @brief 生成混合大小，按指数分布覆盖所有区间，使分支难以预测
+ */
+std::vector<size_type> make_sizes()
+{
+    std::mt19937_64 engine(42);
+    std::uniform_int_distribution<int> shift(3, 18);
+    std::vector<size_type> sizes;
+    sizes.reserve(COUNT);
+
+    for (size_type i = 0; i < COUNT; ++i) {
+        size_type upper = static_cast<size_type>(1) << shift(engine);
+        std::uniform_int_distribution<size_type> size(1, upper);
+        sizes.emplace_back(size(engine));
+    }
+
+    return sizes;
+}
+
+int main(int argc, char * argv[])
+{
+    // 可以只运行一种实现，便于配合 perf stat -e branch-misses 使用
+    std::string mode = argc > 1 ? argv[1] : "all";
+    std::vector<size_type> sizes = make_sizes();
+
+    printf("================================== SIZE BENCHMARK =========================================\n");
+
+    if (mode == "all" || mode == "ladder") {
+        size_type checksum = 0;
+        time_point start = high_resolution_clock::now();
+
+        for (size_type i = 0; i < ROUND; ++i) {
+            for (size_type size : sizes) {
+                size_type round_size = ladder_round_up(size);
+                checksum += ladder_size_to_index(round_size) + round_size;
+            }
+        }
+
+        duration cost = high_resolution_clock::now() - start;
+        printf("ladder: %zu lookups cost %.2f ms, %.2f ns/op, checksum %zu\n",
+            COUNT * ROUND, cost.count(), cost.count() * 1e6 / (COUNT * ROUND), checksum);
+    }
+
+    if (mode == "all" || mode == "table") {
+        size_type checksum = 0;
+        time_point start = high_resolution_clock::now();
+
+        for (size_type i = 0; i < ROUND; ++i) {
+            for (size_type size : sizes) {
+                SizeClass size_class = Size::size_to_class(size);
+                checksum += size_class.index + size_class.size;
+            }
+        }
+
+        duration cost = high_resolution_clock::now() - start;
+        printf("table:  %zu lookups cost %.2f ms, %.2f ns/op, checksum %zu\n",
+            COUNT * ROUND, cost.count(), cost.count() * 1e6 / (COUNT * ROUND), checksum);
+    }
+
+    printf("===========================================================================================\n");
+}
@@ -0,0 +1,506 @@
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <ThreadCache.h>
+#include <RemoteFree.h>
+#include <Numa.h>
+#include <Platform.h>
+#include <Trace.h>
+#include <Profiler.h>
+#include <Latency.h>
+#include <Stats.h>
+
+/**
+ * glibc导出的原始分配函数
+ * 内存池内部需要分配内存或者对齐要求超出页大小时，转交给glibc
+ */
+extern "C"
+{
+void * __libc_malloc(size_t _Size);
+void __libc_free(void * _Ptr);
+void * __libc_calloc(size_t _Count, size_t _Size);
+void * __libc_realloc(void * _Ptr, size_t _Size);
+void * __libc_memalign(size_t _Alignment, size_t _Size);
+}
+
+namespace
+{
+
+using WW::size_type;
+
+/**
+ * @brief `malloc`要求的最小对齐
+ * @details 与`alignof(max_align_t)`一致
+ */
+constexpr size_type MIN_ALIGNMENT = 16;
+
+/**
+ * @brief 当前线程是否正在内存池内部执行
+ * @details 内存池内部的分配会重入，此时转交给glibc，使用initial-exec模型，访问时不会分配内存
+ */
+__attribute__((tls_model("initial-exec"))) thread_local bool _In_pool = false;
+
+/**
+ * @brief 内存池守卫
+ * @details 构造时标记进入内存池，析构时标记离开
+ */
+class PoolGuard
+{
+public:
+    PoolGuard() noexcept
+    {
+        _In_pool = true;
+    }
+
+    ~PoolGuard()
+    {
+        _In_pool = false;
+    }
+
+    PoolGuard(const PoolGuard &) = delete;
+
+    PoolGuard & operator=(const PoolGuard &) = delete;
+};
+
+/**
+ * @brief 是否是2的幂
+ */
+bool _Is_power_of_two(size_type _Value) noexcept
+{
+    return _Value != 0 && (_Value & (_Value - 1)) == 0;
+}
+
+/**
+ * @brief 查找内存所属的页段
+ * @return 属于内存池时返回`Span *`，否则返回`nullptr`
+ */
+WW::Span * _Pool_span(void * _Ptr) noexcept
+{
+    return WW::PageCache::get_page_cache().object_to_span(_Ptr);
+}
+
+void * _Pool_malloc(size_type _Size) noexcept
+{
+    if (_In_pool) {
+        return __libc_malloc(_Size);
+    }
+
+    if (_Size == 0) {
+        // malloc(0)需要返回可以释放的唯一指针
+        _Size = 1;
+    } else if (_Size > 8) {
+        // 超过8字节的内存需要16字节对齐，内存块从页首开始切分，大小对齐即可
+        _Size = (_Size + MIN_ALIGNMENT - 1) & ~(MIN_ALIGNMENT - 1);
+    }
+
+    PoolGuard _Guard;
+    return WW::ThreadCache::get_thread_cache().allocate(_Size);
+}
+
+void _Pool_free(void * _Ptr) noexcept
+{
+    if (_Ptr == nullptr) {
+        return;
+    }
+
+    if (!_In_pool) {
+        PoolGuard _Guard;
+        WW::Span * _Span = _Pool_span(_Ptr);
+        if (_Span != nullptr) {
+            if (_Span->is_large()) {
+                // 对齐的大内存可能不超过小内存的管理范围，不能按大小释放
+                WW::ThreadCache::get_thread_cache().deallocate(_Ptr);
+            } else {
+                WW::ThreadCache::get_thread_cache().deallocate(_Ptr, _Span->object_size());
+            }
+            return;
+        }
+    }
+
+    // 内存池之外的内存都来自glibc
+    __libc_free(_Ptr);
+}
+
+void * _Pool_memalign(size_type _Alignment, size_type _Size) noexcept
+{
+    if (_Alignment <= sizeof(void *)) {
+        return _Pool_malloc(_Size);
+    }
+
+    if (_In_pool) {
+        return __libc_memalign(_Alignment, _Size);
+    }
+
+    if (_Size == 0) {
+        _Size = 1;
+    }
+
+    // 按对齐选择内存块，超过页大小的对齐使用首页对齐的页段
+    PoolGuard _Guard;
+    return WW::ThreadCache::get_thread_cache().allocate_aligned(_Size, _Alignment);
+}
+
+size_type _Pool_usable_size(void * _Ptr) noexcept
+{
+    if (_Ptr == nullptr) {
+        return 0;
+    }
+
+    WW::Span * _Span = _Pool_span(_Ptr);
+    if (_Span != nullptr) {
+        return WW::ThreadCache::get_thread_cache().usable_size(_Ptr);
+    }
+
+    // 来自glibc的内存，交给glibc计算
+    using usable_size_function = size_t (*)(void *);
+    static usable_size_function _Libc_usable_size = nullptr;
+    if (_Libc_usable_size == nullptr) {
+        PoolGuard _Guard;
+        _Libc_usable_size = reinterpret_cast<usable_size_function>(dlsym(RTLD_NEXT, "malloc_usable_size"));
+        if (_Libc_usable_size == nullptr) {
+            return 0;
+        }
+    }
+
+    return _Libc_usable_size(_Ptr);
+}
+
+void * _Pool_realloc(void * _Ptr, size_type _Size) noexcept
+{
+    if (_Ptr == nullptr) {
+        return _Pool_malloc(_Size);
+    }
+
+    if (_Size == 0) {
+        _Pool_free(_Ptr);
+        return nullptr;
+    }
+
+    WW::Span * _Span = _Pool_span(_Ptr);
+    if (_Span == nullptr) {
+        // 来自glibc的内存继续由glibc调整
+        return __libc_realloc(_Ptr, _Size);
+    }
+
+    if (_Size > 8) {
+        // 和malloc一样保证16字节对齐
+        _Size = (_Size + MIN_ALIGNMENT - 1) & ~(MIN_ALIGNMENT - 1);
+    }
+
+    // 原内存块放得下或者大内存可以原地扩展时返回原指针
+    PoolGuard _Guard;
+    return WW::ThreadCache::get_thread_cache().reallocate(_Ptr, _Span->object_size(), _Size);
+}
+
+/**
+ * @brief `operator new`的分配流程
+ * @details 失败时调用`new_handler`，没有`new_handler`时抛出`std::bad_alloc`
+ */
+void * _Pool_new(size_type _Size)
+{
+    for (;;) {
+        void * _Ptr = _Pool_malloc(_Size);
+        if (_Ptr != nullptr) {
+            return _Ptr;
+        }
+
+        std::new_handler _Handler = std::get_new_handler();
+        if (_Handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        _Handler();
+    }
+}
+
+void * _Pool_new_nothrow(size_type _Size) noexcept
+{
+    try {
+        return _Pool_new(_Size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+/**
+ * @brief `fork`前锁住所有缓存，保证子进程中的缓存状态一致
+ */
+void _Prepare_fork() noexcept
+{
+    WW::Trace::get_trace().lock();
+    WW::Profiler::get_profiler().lock();
+    WW::ThreadCacheRegistry::get_thread_cache_registry().lock();
+    WW::RemoteFree::get_remote_free().lock();
+    WW::StatsRegistry::get_stats_registry().lock();
+
+    // 先锁所有中心缓存再锁所有页缓存，和中心缓存访问页缓存的顺序一致
+    WW::size_type _Node_count = WW::Numa::get_numa().max_node_count();
+    for (WW::size_type _Node = 0; _Node < _Node_count; ++_Node) {
+        WW::CentralCache::get_central_cache(_Node).lock();
+    }
+    for (WW::size_type _Node = 0; _Node < _Node_count; ++_Node) {
+        WW::PageCache::get_page_cache(_Node).lock();
+    }
+
+    // 页缓存持锁时会向系统申请内存，系统内存锁最后加
+    WW::Platform::lock();
+}
+
+/**
+ * @brief `fork`后解锁所有缓存
+ */
+void _Finish_fork() noexcept
+{
+    WW::Platform::unlock();
+
+    WW::size_type _Node_count = WW::Numa::get_numa().max_node_count();
+    for (WW::size_type _Node = 0; _Node < _Node_count; ++_Node) {
+        WW::PageCache::get_page_cache(_Node).unlock();
+    }
+    for (WW::size_type _Node = 0; _Node < _Node_count; ++_Node) {
+        WW::CentralCache::get_central_cache(_Node).unlock();
+    }
+    WW::StatsRegistry::get_stats_registry().unlock();
+    WW::RemoteFree::get_remote_free().unlock();
+    WW::ThreadCacheRegistry::get_thread_cache_registry().unlock();
+    WW::Profiler::get_profiler().unlock();
+    WW::Trace::get_trace().unlock();
+}
+
+/**
+ * @brief 动态库加载时初始化
+ * @details 提前创建缓存单例并注册`fork`处理函数
+ */
+__attribute__((constructor)) void _Initialize() noexcept
+{
+    {
+        PoolGuard _Guard;
+        WW::Numa::get_numa();
+        WW::PageCache::get_page_cache();
+        WW::CentralCache::get_central_cache();
+        WW::ThreadCacheRegistry::get_thread_cache_registry();
+        WW::RemoteFree::get_remote_free();
+        WW::Trace::get_trace();
+        WW::Profiler::get_profiler();
+        WW::Latency::get_latency();
+    }
+
+    pthread_atfork(_Prepare_fork, _Finish_fork, _Finish_fork);
+}
+
+} // namespace
+
+extern "C"
+{
+
+__attribute__((visibility("default"))) void * malloc(size_t _Size) noexcept
+{
+    void * _Ptr = _Pool_malloc(_Size);
+    if (_Ptr == nullptr) {
+        errno = ENOMEM;
+    }
+    return _Ptr;
+}
+
+__attribute__((visibility("default"))) void free(void * _Ptr) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+__attribute__((visibility("default"))) void * calloc(size_t _Count, size_t _Size) noexcept
+{
+    if (_Size != 0 && _Count > static_cast<size_t>(-1) / _Size) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    if (_In_pool) {
+        return __libc_calloc(_Count, _Size);
+    }
+
+    // 内存池中的内存块会被复用，需要清零
+    void * _Ptr = _Pool_malloc(_Count * _Size);
+    if (_Ptr == nullptr) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    std::memset(_Ptr, 0, _Count * _Size);
+    return _Ptr;
+}
+
+__attribute__((visibility("default"))) void * realloc(void * _Ptr, size_t _Size) noexcept
+{
+    return _Pool_realloc(_Ptr, _Size);
+}
+
+__attribute__((visibility("default"))) void * memalign(size_t _Alignment, size_t _Size) noexcept
+{
+    if (!_Is_power_of_two(_Alignment)) {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    void * _Ptr = _Pool_memalign(_Alignment, _Size);
+    if (_Ptr == nullptr) {
+        errno = ENOMEM;
+    }
+    return _Ptr;
+}
+
+__attribute__((visibility("default"))) void * aligned_alloc(size_t _Alignment, size_t _Size) noexcept
+{
+    return memalign(_Alignment, _Size);
+}
+
+__attribute__((visibility("default"))) int posix_memalign(void ** _Memptr, size_t _Alignment, size_t _Size) noexcept
+{
+    if (!_Is_power_of_two(_Alignment) || _Alignment % sizeof(void *) != 0) {
+        return EINVAL;
+    }
+
+    void * _Ptr = _Pool_memalign(_Alignment, _Size);
+    if (_Ptr == nullptr) {
+        return ENOMEM;
+    }
+
+    *_Memptr = _Ptr;
+    return 0;
+}
+
+__attribute__((visibility("default"))) void * valloc(size_t _Size) noexcept
+{
+    return memalign(WW::PAGE_SIZE, _Size);
+}
+
+__attribute__((visibility("default"))) void * pvalloc(size_t _Size) noexcept
+{
+    return memalign(WW::PAGE_SIZE, (_Size + WW::PAGE_SIZE - 1) & ~(WW::PAGE_SIZE - 1));
+}
+
+__attribute__((visibility("default"))) size_t malloc_usable_size(void * _Ptr) noexcept
+{
+    return _Pool_usable_size(_Ptr);
+}
+
+__attribute__((visibility("default"))) void malloc_stats() noexcept
+{
+    // 输出内存池的统计信息，替代glibc的实现
+    WW::print_stats();
+
+    // 开启延迟统计时一起输出
+    if (WW::Latency::get_latency().enabled()) {
+        WW::print_latency();
+    }
+}
+
+} // extern "C"
+
+__attribute__((visibility("default"))) void * operator new(std::size_t _Size)
+{
+    return _Pool_new(_Size);
+}
+
+__attribute__((visibility("default"))) void * operator new[](std::size_t _Size)
+{
+    return _Pool_new(_Size);
+}
+
+__attribute__((visibility("default"))) void * operator new(std::size_t _Size, const std::nothrow_t &) noexcept
+{
+    return _Pool_new_nothrow(_Size);
+}
+
+__attribute__((visibility("default"))) void * operator new[](std::size_t _Size, const std::nothrow_t &) noexcept
+{
+    return _Pool_new_nothrow(_Size);
+}
+
+__attribute__((visibility("default"))) void operator delete(void * _Ptr) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+__attribute__((visibility("default"))) void operator delete[](void * _Ptr) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+__attribute__((visibility("default"))) void operator delete(void * _Ptr, const std::nothrow_t &) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+__attribute__((visibility("default"))) void operator delete[](void * _Ptr, const std::nothrow_t &) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+__attribute__((visibility("default"))) void operator delete(void * _Ptr, std::size_t) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+__attribute__((visibility("default"))) void operator delete[](void * _Ptr, std::size_t) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+#if defined(__cpp_aligned_new)
+
+__attribute__((visibility("default"))) void * operator new(std::size_t _Size, std::align_val_t _Alignment)
+{
+    for (;;) {
+        void * _Ptr = _Pool_memalign(static_cast<size_type>(_Alignment), _Size);
+        if (_Ptr != nullptr) {
+            return _Ptr;
+        }
+
+        std::new_handler _Handler = std::get_new_handler();
+        if (_Handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        _Handler();
+    }
+}
+
+__attribute__((visibility("default"))) void * operator new[](std::size_t _Size, std::align_val_t _Alignment)
+{
+    return operator new(_Size, _Alignment);
+}
+
+__attribute__((visibility("default"))) void * operator new(std::size_t _Size, std::align_val_t _Alignment, const std::nothrow_t &) noexcept
+{
+    return _Pool_memalign(static_cast<size_type>(_Alignment), _Size);
+}
+
+__attribute__((visibility("default"))) void * operator new[](std::size_t _Size, std::align_val_t _Alignment, const std::nothrow_t &) noexcept
+{
+    return _Pool_memalign(static_cast<size_type>(_Alignment), _Size);
+}
+
+__attribute__((visibility("default"))) void operator delete(void * _Ptr, std::align_val_t) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+__attribute__((visibility("default"))) void operator delete[](void * _Ptr, std::align_val_t) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+__attribute__((visibility("default"))) void operator delete(void * _Ptr, std::size_t, std::align_val_t) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+__attribute__((visibility("default"))) void operator delete[](void * _Ptr, std::size_t, std::align_val_t) noexcept
+{
+    _Pool_free(_Ptr);
+}
+
+#endif
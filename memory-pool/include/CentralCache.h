@@ -1,21 +1,36 @@
 #pragma once
 
+#include <atomic>
+
 #include <PageCache.h>
+#include <TransferCache.h>
 
 namespace WW
 {
 
+class MemoryStats;
+
 /**
  * @brief 中心缓存
+ * @details 启用NUMA时每个节点一个，从同一节点的页缓存获取页段，其他节点的内存块归还时转交所属节点。
+ * 每种大小的页段按使用情况分别放在全部使用、部分使用和完全空闲的链表中，部分使用的页段再按空闲内存块数分组，
+ * 内存块数跨过分组边界时移动页段，获取时直接取空闲最少的一组，不需要遍历
  */
 class CentralCache
 {
 private:
-    std::array<SpanList, MAX_ARRAY_SIZE> _Spans;        // 页段链表数组
-    std::mutex _Mutex;                                  // 中心缓存锁
+    using PartialSpanLists = std::array<SpanList, CENTRAL_PARTIAL_LIST_NUM>;
+
+    std::array<SpanList, MAX_ARRAY_SIZE> _Spans;                    // 全部使用的页段链表，它的锁保护同一大小的所有链表
+    std::array<PartialSpanLists, MAX_ARRAY_SIZE> _Partial_spans;    // 部分使用的页段链表，按空闲内存块数分组
+    std::array<SpanList, MAX_ARRAY_SIZE> _Empty_spans;              // 完全空闲的页段链表
+    std::atomic<size_type> _Empty_pages;                            // 完全空闲的页段总页数
+    std::array<TransferCache, MAX_ARRAY_SIZE> _Transfer_caches;     // 传输缓存数组
+    std::mutex _Mutex;                                              // 中心缓存锁
+    size_type _Node;                                                // 所属的NUMA节点
 
 private:
-    CentralCache();
+    explicit CentralCache(size_type _Node);
 
     CentralCache(const CentralCache &) = delete;
 
@@ -30,6 +45,13 @@ public:
      */
     static CentralCache & get_central_cache();
 
+    /**
+     * @brief 获取指定NUMA节点的中心缓存
+     * @param _Node 节点
+     * @details 按需创建，除第0个节点外不会析构
+     */
+    static CentralCache & get_central_cache(size_type _Node);
+
     /**
      * @brief 获取指定大小的空闲内存块
      * @param _Size 内存块大小
@@ -38,20 +60,99 @@ public:
      */
     FreeObject * fetch_range(size_type _Size, size_type _Count);
 
+    /**
+     * @brief 获取指定大小的空闲内存块
+     * @param _Size 内存块大小
+     * @param _Count 个数
+     * @param _Begin 获取到的首个内存块
+     * @param _End 获取到的最后一个内存块
+     * @param _Owner 获取内存块的线程缓存的远程队列编号，从页段切出时记录到页段，0表示没有所属线程。从传输缓存整批获取时不记录，页段保留之前的记录，只作为远程释放的参考
+     * @return 实际获取的个数，失败时返回0
+     * @details 同时返回链表尾部和数量，便于线程缓存整段拼接，优先从传输缓存中整批获取
+     */
+    size_type fetch_range(size_type _Size, size_type _Count, FreeObject *& _Begin, FreeObject *& _End, size_type _Owner = 0);
+
     /**
      * @brief 将空闲内存块归还到中心缓存
      * @param _Size 内存块大小
      * @param _Free_object 空闲内存块链表
+     * @details 逐个归还到所属页段中
      */
     void return_range(size_type _Size, FreeObject * _Free_object);
 
+    /**
+     * @brief 将一批空闲内存块归还到中心缓存
+     * @param _Size 内存块大小
+     * @param _Begin 首个内存块
+     * @param _End 最后一个内存块
+     * @param _Count 内存块数量
+     * @details 优先整批放入传输缓存，传输缓存已满时逐个归还到所属页段中
+     */
+    void return_range(size_type _Size, FreeObject * _Begin, FreeObject * _End, size_type _Count);
+
+    /**
+     * @brief 统计每种大小持有的页段和空闲内存块
+     * @param _Stats 统计信息，累加到中心缓存和传输缓存相关的字段
+     * @details `in_use`填写从页段中取出的内存块数，包含其他各层缓存中的内存块
+     */
+    void collect_stats(MemoryStats & _Stats);
+
+    /**
+     * @brief 将传输缓存中的内存块全部归还到所属页段中
+     * @details 用于归还内存给系统之前，完全空闲的页段因此可以还给页缓存
+     */
+    void flush_transfer_caches();
+
+    /**
+     * @brief 将完全空闲的页段全部还给页缓存
+     * @details 用于归还内存给系统之前，页段在页缓存中合并后才能归还
+     */
+    void release_empty_spans();
+
+    /**
+     * @brief 给所有页段链表加锁
+     * @details 用于`fork`前保持中心缓存状态一致
+     */
+    void lock() noexcept;
+
+    /**
+     * @brief 给所有页段链表解锁
+     */
+    void unlock() noexcept;
+
 private:
+    /**
+     * @brief 将空闲内存块逐个归还到所属页段中
+     * @param _Index 内存块所在的索引
+     * @param _Free_object 空闲内存块链表
+     * @details 属于其他节点的内存块转交该节点的中心缓存
+     */
+    void _Return_to_spans(size_type _Index, FreeObject * _Free_object);
+
     /**
      * @brief 获取一个空闲的页段
      * @param _Size 内存块大小
      * @return 成功时返回`Span *`，失败时返回`nullptr`
+     * @details 依次从空闲最少的部分使用页段、完全空闲的页段中选择，都没有时向页缓存申请
      */
     Span * _Get_free_span(size_type _Size);
+
+    /**
+     * @brief 获取页段按使用情况应该所在的链表
+     * @param _Index 内存块所在的索引
+     * @param _Used 已使用的内存块数
+     * @param _Free 空闲的内存块数
+     */
+    SpanList & _Span_list(size_type _Index, size_type _Used, size_type _Free) noexcept;
+
+    /**
+     * @brief 页段的内存块数变化后移动到对应的链表
+     * @param _Index 内存块所在的索引
+     * @param _Span 页段，调用者持有该大小的锁
+     * @param _Old_used 变化前已使用的内存块数
+     * @param _Old_free 变化前空闲的内存块数
+     */
+    void _Move_span(size_type _Index, Span * _Span, size_type _Old_used, size_type _Old_free) noexcept;
 };
 
 } // namespace WW
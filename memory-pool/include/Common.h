@@ -45,4 +45,187 @@ constexpr size_type MAX_MEMORY_SIZE = PAGE_SIZE * MAX_PAGE_NUM / 2;
  */
 constexpr size_type MAX_BLOCK_NUM = 512;
 
+/**
+ * @brief 线程缓存向中心缓存申请内存块，每次最少2个
+ */
+constexpr size_type MIN_BLOCK_NUM = 2;
+
+/**
+ * @brief 线程缓存每批内存块的总大小
+ * @details 每种大小一批的数量为该值除以内存块大小，限制在`MIN_BLOCK_NUM`和`MAX_BLOCK_NUM`之间
+ */
+constexpr size_type MAX_BATCH_SIZE = 64 * 1024;
+
+/**
+ * @brief 线程缓存自由表的最大长度为一批数量的倍数
+ */
+constexpr size_type MAX_LIST_BATCH_NUM = 4;
+
+/**
+ * @brief 线程缓存自由表连续超长该次数后缩短最大长度
+ */
+constexpr size_type MAX_LIST_OVERAGES = 3;
+
+/**
+ * @brief 所有线程缓存默认最多保存的内存
+ * @details 可以通过环境变量`WW_THREAD_CACHE_SIZE`或者运行时修改
+ */
+constexpr size_type DEFAULT_THREAD_CACHE_SIZE = 32 * 1024 * 1024;
+
+/**
+ * @brief 每个线程缓存至少可以保存的内存
+ * @details 总量不足时也会保证该大小，总量可能因此被超出
+ */
+constexpr size_type MIN_THREAD_CACHE_SIZE = 2 * MAX_MEMORY_SIZE;
+
+/**
+ * @brief 线程缓存每次扩大上限时获取的内存
+ */
+constexpr size_type THREAD_CACHE_STEAL_SIZE = 64 * 1024;
+
+/**
+ * @brief 线程缓存扩大上限时最多尝试的其他线程数
+ */
+constexpr size_type MAX_STEAL_TRIES = 8;
+
+/**
+ * @brief 远程释放队列的最大数量
+ * @details 超出数量的线程不接收其他线程的远程释放
+ */
+constexpr size_type MAX_REMOTE_QUEUE_NUM = 1024;
+
+/**
+ * @brief 每个远程释放队列中每种大小最多保存的内存大小
+ * @details 超出时释放线程自行处理，避免所属线程长时间不申请内存时队列无限增长
+ */
+constexpr size_type MAX_REMOTE_QUEUE_BYTES = 256 * 1024;
+
+/**
+ * @brief 最多支持的NUMA节点数，每个节点对应一个页缓存和中心缓存
+ */
+constexpr size_type MAX_NUMA_NODE_NUM = 8;
+
+/**
+ * @brief 表示不绑定NUMA节点
+ */
+constexpr size_type NO_NUMA_NODE = static_cast<size_type>(-1);
+
+/**
+ * @brief 记录分配轨迹时每个线程缓冲的事件数
+ * @details 缓冲区满时整体写入文件
+ */
+constexpr size_type TRACE_BUFFER_SIZE = 1024;
+
+/**
+ * @brief 堆采样关闭时检查是否开启的申请字节间隔
+ * @details 已有线程在申请这么多内存后才会按新的采样间隔采样
+ */
+constexpr size_type PROFILER_RECHECK_SIZE = 1024 * 1024;
+
+/**
+ * @brief 每个采样最多记录的调用栈深度
+ */
+constexpr size_type PROFILER_MAX_DEPTH = 32;
+
+/**
+ * @brief 采样记录哈希表的桶数，必须是2的幂
+ */
+constexpr size_type PROFILER_BUCKET_NUM = 4096;
+
+/**
+ * @brief 采样记录哈希表的锁数，每个锁保护桶号同余的桶
+ */
+constexpr size_type PROFILER_LOCK_NUM = 64;
+
+/**
+ * @brief 延迟直方图每个2的幂区间细分的子桶数的位数
+ * @details 4位即每个区间16个子桶，相对误差不超过1/16
+ */
+constexpr size_type LATENCY_SUB_BUCKET_BITS = 4;
+
+/**
+ * @brief 延迟直方图的桶数，覆盖64位的周期数
+ */
+constexpr size_type LATENCY_BUCKET_NUM = (64 - LATENCY_SUB_BUCKET_BITS + 1) << LATENCY_SUB_BUCKET_BITS;
+
+/**
+ * @brief 中心缓存每种大小的部分使用页段链表数
+ * @details 按空闲内存块数的2的幂分组，空闲最少的一组优先使用，最后一组包含更多空闲的页段
+ */
+constexpr size_type CENTRAL_PARTIAL_LIST_NUM = 8;
+
+/**
+ * @brief 每个中心缓存中完全空闲的页段最多保存的总页数
+ * @details 超出时完全空闲的页段直接还给页缓存，向系统归还内存前全部还给页缓存
+ */
+constexpr size_type MAX_CENTRAL_EMPTY_PAGES = 256;
+
+/**
+ * @brief 传输缓存中每种大小最多保存的批数
+ */
+constexpr size_type MAX_TRANSFER_NUM = 64;
+
+/**
+ * @brief 传输缓存中每种大小最多保存的内存
+ */
+constexpr size_type MAX_TRANSFER_SIZE = 512 * 1024;
+
+/**
+ * @brief 每个CPU缓存中每种大小最多保存的内存块数
+ */
+constexpr size_type MAX_CPU_CACHE_NUM = 64;
+
+/**
+ * @brief 每个CPU缓存中每种大小最多保存的内存
+ * @details 超过该大小的内存块不经过CPU缓存
+ */
+constexpr size_type MAX_CPU_CACHE_SIZE = 16 * 1024;
+
+/**
+ * @brief 页缓存中每种页数的页段缓存最多保存的页数
+ * @details 至少可以保存一个页段
+ */
+constexpr size_type MAX_SPAN_CACHE_PAGES = 256;
+
+/**
+ * @brief 对象池每次从系统获取的内存大小
+ * @details 用于页段等元数据，页大小的整数倍
+ */
+constexpr size_type OBJECT_POOL_CHUNK_SIZE = 16 * PAGE_SIZE;
+
+/**
+ * @brief 直接向系统映射的最小内存
+ * @details 达到该大小的内存不经过页缓存，释放时立即交还给系统
+ */
+constexpr size_type DIRECT_MMAP_SIZE = 32 * 1024 * 1024;
+
+/**
+ * @brief 大页大小
+ * @details 使用大页时，向系统预留的内存按该大小对齐
+ */
+constexpr size_type HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * @brief 每次向系统预留的虚拟内存大小
+ * @details 预留的内存通过移动指针依次分配给页缓存
+ */
+constexpr size_type SYSTEM_RESERVE_SIZE = 64 * 1024 * 1024;
+
+/**
+ * @brief 后台回收线程默认每秒归还给系统的页数
+ */
+constexpr size_type DEFAULT_RELEASE_RATE = 256;
+
 } // namespace WW
+
+/**
+ * @brief 定义一个不会析构的静态对象指针
+ * @param _Type 对象类型
+ * @param _Name 指针名
+ * @param _Arguments 带括号的构造参数
+ * @details 对象构造在静态存储上，进程退出时不调用析构函数。替换malloc时，
+ * 进程退出阶段仍然会有线程退出、内存被释放，这些路径用到的单例必须一直有效。使用处需要包含`<new>`
+ */
+#define WW_NEVER_DESTROYED(_Type, _Name, _Arguments)                        \
+    alignas(_Type) static unsigned char _Name##_storage[sizeof(_Type)];    \
+    static _Type * _Name = new(_Name##_storage) _Type _Arguments
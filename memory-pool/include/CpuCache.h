@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include <Common.h>
+
+namespace WW
+{
+
+class MemoryStats;
+
+/**
+ * @brief 单个CPU上一种大小的内存块数组
+ * @details 只在所属CPU上通过restartable sequences修改，不需要加锁
+ */
+class CpuFreeList
+{
+public:
+    size_type count;                            // 内存块数量，提交操作写入的字段
+    size_type capacity;                         // 最多保存的数量
+    void * slots[MAX_CPU_CACHE_NUM];            // 内存块数组，按栈使用
+};
+
+/**
+ * @brief 单个CPU的缓存
+ */
+class CpuSlab
+{
+public:
+    std::array<CpuFreeList, MAX_ARRAY_SIZE> lists;  // 每种大小的内存块数组
+};
+
+/**
+ * @brief CPU缓存
+ * @details 使用Linux restartable sequences (rseq)实现的每CPU前端缓存，
+ * 缓存的内存随CPU数量而不是线程数量增长，rseq不可用时由线程缓存兜底
+ */
+class CpuCache
+{
+private:
+    std::atomic<CpuSlab *> * _Slabs;                // 每个CPU的缓存，按需创建
+    size_type _Cpu_count;                           // CPU数量
+    bool _Available;                                // rseq是否可用
+    std::atomic<bool> _Enabled;                     // 是否启用
+
+private:
+    CpuCache();
+
+    CpuCache(const CpuCache &) = delete;
+
+    CpuCache & operator=(const CpuCache &) = delete;
+
+public:
+    ~CpuCache() = default;
+
+public:
+    /**
+     * @brief 获取CPU缓存单例
+     */
+    static CpuCache & get_cpu_cache();
+
+    /**
+     * @brief 当前平台是否支持CPU缓存
+     * @details 需要x86-64 Linux，并且glibc已经为线程注册了rseq
+     */
+    bool available() const noexcept;
+
+    /**
+     * @brief 是否已经启用
+     * @details 默认关闭，可以通过环境变量`WW_PER_CPU_CACHE=1`或者`set_enabled`启用
+     */
+    bool enabled() const noexcept;
+
+    /**
+     * @brief 启用或关闭CPU缓存
+     * @return 设置后的启用状态，不可用时始终返回`false`
+     */
+    bool set_enabled(bool _Enabled) noexcept;
+
+    /**
+     * @brief 从当前CPU的缓存申请内存块
+     * @param _Index 内存块所在的索引
+     * @param _Size 对齐后的内存块大小
+     * @return 成功返回`void *`，当前线程无法使用CPU缓存或者失败时返回`nullptr`
+     * @details 缓存为空时从中心缓存批量补充，超过`MAX_CPU_CACHE_SIZE`的内存块直接从中心缓存获取
+     */
+    void * allocate(size_type _Index, size_type _Size) noexcept;
+
+    /**
+     * @brief 将内存块归还到当前CPU的缓存
+     * @param _Ptr 内存块指针
+     * @param _Index 内存块所在的索引
+     * @param _Size 对齐后的内存块大小
+     * @return 成功时返回`true`，当前线程无法使用CPU缓存时返回`false`
+     * @details 缓存已满时将一半内存块归还中心缓存，仍然放不下的内存块和超过`MAX_CPU_CACHE_SIZE`的内存块直接归还中心缓存
+     */
+    bool deallocate(void * _Ptr, size_type _Index, size_type _Size) noexcept;
+
+    /**
+     * @brief 统计所有CPU缓存中的内存块
+     * @param _Stats 统计信息，填写CPU缓存相关的字段
+     * @details 不会打断其他CPU上的操作，读取到的数量可能略有滞后
+     */
+    void collect_stats(MemoryStats & _Stats) noexcept;
+
+private:
+    /**
+     * @brief 获取指定CPU的缓存
+     * @return 成功时返回`CpuSlab *`，内存不足时返回`nullptr`
+     */
+    CpuSlab * _Get_slab(size_type _Cpu) noexcept;
+
+    /**
+     * @brief 从中心缓存补充当前CPU的缓存
+     * @return 留给调用者的一个内存块，失败时返回`nullptr`
+     */
+    void * _Fetch_from_central_cache(size_type _Index, size_type _Size) noexcept;
+
+    /**
+     * @brief 将单个内存块直接归还中心缓存
+     */
+    void _Return_object(void * _Ptr, size_type _Size) noexcept;
+
+    /**
+     * @brief 将当前CPU缓存中一半的内存块归还中心缓存
+     */
+    void _Return_to_central_cache(size_type _Index, size_type _Size) noexcept;
+};
+
+} // namespace WW
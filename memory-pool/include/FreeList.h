@@ -80,7 +80,7 @@ public:
 
 /**
  * @brief 空闲内存块链表
- * @details 单向链表
+ * @details 单向链表，记录尾节点和数量，整段链表可以O(1)拼接
  */
 class FreeList
 {
@@ -89,6 +89,7 @@ public:
 
 private:
     FreeObject _Head;           // 虚拟头节点
+    FreeObject * _Tail;         // 尾节点，链表为空时为`nullptr`
     size_type _Size;            // 空闲内存块数量
     size_type _Max_size;        // 最大数量
 
@@ -113,6 +114,25 @@ public:
      */
     void pop_front();
 
+    /**
+     * @brief 将一段链表整体插入到链表头部
+     * @param _Begin 首个内存块
+     * @param _End 最后一个内存块
+     * @param _Count 内存块数量
+     * @details 只修改首尾节点，不遍历链表
+     */
+    void push_range(FreeObject * _Begin, FreeObject * _End, size_type _Count) noexcept;
+
+    /**
+     * @brief 从链表头部取出一段链表
+     * @param _Count 期望取出的数量
+     * @param _Begin 取出的首个内存块
+     * @param _End 取出的最后一个内存块，其后继被置为`nullptr`
+     * @return 实际取出的数量
+     * @details 取出全部内存块时不遍历链表，否则只读取前`_Count`个节点的后继
+     */
+    size_type pop_range(size_type _Count, FreeObject *& _Begin, FreeObject *& _End) noexcept;
+
     /**
      * @brief 获取链表头部
      */
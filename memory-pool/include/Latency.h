@@ -0,0 +1,194 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+#include <Common.h>
+
+namespace WW
+{
+
+/**
+ * @brief 记录延迟的层间调用
+ * @details 外层的延迟包含内层，例如获取页段包含向系统申请
+ */
+enum class LatencyTier : size_type
+{
+    FETCH_RANGE = 0,        // 从中心缓存获取一批内存块
+    RETURN_RANGE = 1,       // 向中心缓存归还一批内存块
+    FETCH_SPAN = 2,         // 从页缓存获取页段
+    RETURN_SPAN = 3,        // 向页缓存归还页段
+    SYSTEM_FETCH = 4,       // 页缓存向系统申请内存
+    COUNT = 5,
+};
+
+/**
+ * @brief 延迟直方图
+ * @details 对数线性分桶，小于`2^LATENCY_SUB_BUCKET_BITS`的周期数每个值一个桶，
+ * 之后每个2的幂区间等分为`2^LATENCY_SUB_BUCKET_BITS`个桶
+ */
+class LatencyHistogram
+{
+public:
+    std::array<std::uint64_t, LATENCY_BUCKET_NUM> buckets;  // 每个桶的次数
+    std::uint64_t count;                                    // 总次数
+    std::uint64_t total_cycles;                             // 总周期数
+    std::uint64_t max_cycles;                               // 最大周期数
+
+public:
+    /**
+     * @brief 计算分位数
+     * @param _Rank 0到1之间的比例
+     * @return 所在桶的上界，不超过最大值，没有记录时为0
+     */
+    std::uint64_t percentile(double _Rank) const noexcept;
+
+    /**
+     * @brief 计算平均周期数
+     */
+    double mean() const noexcept;
+
+    /**
+     * @brief 计算周期数所在的桶
+     */
+    static size_type bucket_index(std::uint64_t _Cycles) noexcept;
+
+    /**
+     * @brief 获取桶的下界
+     */
+    static std::uint64_t bucket_lower(size_type _Index) noexcept;
+
+    /**
+     * @brief 获取桶的上界，包含在桶内
+     */
+    static std::uint64_t bucket_upper(size_type _Index) noexcept;
+};
+
+/**
+ * @brief 所有层间调用的延迟
+ */
+class LatencySnapshot
+{
+public:
+    std::array<LatencyHistogram, static_cast<size_type>(LatencyTier::COUNT)> tiers;    // 每种调用的直方图
+    double cycles_per_ns;                                                               // 每纳秒的周期数
+};
+
+/**
+ * @brief 层间调用延迟统计
+ * @details 在线程缓存之下的慢路径上用周期计数器计时，x86使用`rdtsc`，ARM使用虚拟计数器，
+ * 其他平台使用单调时钟的纳秒数。直方图的计数都是原子变量，记录时不加锁。
+ * 默认关闭，关闭时每次调用只检查一次开关，可以通过环境变量`WW_LATENCY=1`或者`set_enabled`开启
+ */
+class Latency
+{
+private:
+    std::atomic<bool> _Enabled;                                 // 是否正在记录
+    std::array<std::array<std::atomic<std::uint64_t>, LATENCY_BUCKET_NUM>,
+        static_cast<size_type>(LatencyTier::COUNT)> _Buckets;   // 每种调用每个桶的次数
+    std::array<std::atomic<std::uint64_t>,
+        static_cast<size_type>(LatencyTier::COUNT)> _Totals;    // 每种调用的总周期数
+    std::array<std::atomic<std::uint64_t>,
+        static_cast<size_type>(LatencyTier::COUNT)> _Maxes;     // 每种调用的最大周期数
+
+private:
+    Latency();
+
+    Latency(const Latency &) = delete;
+
+    Latency & operator=(const Latency &) = delete;
+
+public:
+    ~Latency() = default;
+
+public:
+    /**
+     * @brief 获取延迟统计单例
+     */
+    static Latency & get_latency();
+
+    /**
+     * @brief 是否正在记录
+     */
+    bool enabled() const noexcept;
+
+    /**
+     * @brief 开启或关闭记录
+     */
+    void set_enabled(bool _Enabled) noexcept;
+
+    /**
+     * @brief 记录一次调用
+     * @param _Tier 调用
+     * @param _Cycles 耗时的周期数
+     */
+    void record(LatencyTier _Tier, std::uint64_t _Cycles) noexcept;
+
+    /**
+     * @brief 读取所有直方图
+     * @param _Snapshot 保存结果
+     * @details 各个桶依次读取，和正在进行的记录之间不保证一致
+     */
+    void snapshot(LatencySnapshot & _Snapshot) const noexcept;
+
+    /**
+     * @brief 清空所有直方图
+     */
+    void reset() noexcept;
+
+    /**
+     * @brief 读取周期计数器
+     */
+    static std::uint64_t now() noexcept;
+
+    /**
+     * @brief 获取每纳秒的周期数
+     * @details 第一次调用时对照单调时钟校准，耗时约10毫秒
+     */
+    static double cycles_per_ns() noexcept;
+
+    /**
+     * @brief 获取调用的名字
+     */
+    static const char * tier_name(LatencyTier _Tier) noexcept;
+};
+
+/**
+ * @brief 作用域计时
+ * @details 构造时开始计时，析构时记录，构造时未开启则不记录
+ */
+class LatencyTimer
+{
+private:
+    LatencyTier _Tier;                      // 记录的调用
+    std::uint64_t _Start;                   // 开始的周期数，未开启时为0
+
+public:
+    explicit LatencyTimer(LatencyTier _Tier) noexcept;
+
+    LatencyTimer(const LatencyTimer &) = delete;
+
+    LatencyTimer & operator=(const LatencyTimer &) = delete;
+
+    ~LatencyTimer();
+};
+
+/**
+ * @brief 获取所有层间调用的延迟
+ */
+LatencySnapshot get_latency_snapshot();
+
+/**
+ * @brief 将延迟格式化为便于阅读的文本
+ * @details 每种调用一行，包括次数、平均值和分位数，单位为纳秒
+ */
+std::string format_latency(const LatencySnapshot & _Snapshot);
+
+/**
+ * @brief 将延迟输出到标准错误
+ */
+void print_latency();
+
+} // namespace WW
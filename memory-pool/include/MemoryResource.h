@@ -0,0 +1,68 @@
+#pragma once
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#define WW_MEMORY_RESOURCE_SUPPORTED
+#endif
+#endif
+
+#ifdef WW_MEMORY_RESOURCE_SUPPORTED
+
+#include <memory_resource>
+
+#include <Common.h>
+
+namespace WW
+{
+
+/**
+ * @brief 内存池的`std::pmr::memory_resource`
+ * @details 需要使用C++17构建，申请和释放都交给当前线程的线程缓存，按照对齐选择内存块。
+ * 所有实例共用同一个内存池，一个实例申请的内存可以由其他实例在任意线程释放
+ */
+class MemoryResource : public std::pmr::memory_resource
+{
+public:
+    MemoryResource() = default;
+
+    MemoryResource(const MemoryResource &) = default;
+
+    MemoryResource & operator=(const MemoryResource &) = default;
+
+    ~MemoryResource() override = default;
+
+public:
+    /**
+     * @brief 获取内存池的内存资源单例
+     * @details 可以传给`std::pmr::set_default_resource`或pmr容器
+     */
+    static MemoryResource * get_memory_resource() noexcept;
+
+protected:
+    /**
+     * @brief 申请内存
+     * @param _Bytes 内存大小
+     * @param _Alignment 对齐大小
+     * @exception std::bad_alloc 内存不足或对齐大小无效
+     */
+    void * do_allocate(std::size_t _Bytes, std::size_t _Alignment) override;
+
+    /**
+     * @brief 释放内存
+     * @param _Ptr 内存指针
+     * @param _Bytes 申请时的内存大小
+     * @param _Alignment 申请时的对齐大小
+     * @details 根据大小和对齐直接找到内存块，不需要查找页段
+     */
+    void do_deallocate(void * _Ptr, std::size_t _Bytes, std::size_t _Alignment) override;
+
+    /**
+     * @brief 判断能否互相释放内存
+     * @details 所有`MemoryResource`都共用同一个内存池
+     */
+    bool do_is_equal(const std::pmr::memory_resource & _Other) const noexcept override;
+};
+
+} // namespace WW
+
+#endif // WW_MEMORY_RESOURCE_SUPPORTED
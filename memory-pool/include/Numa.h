@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+
+#include <Common.h>
+
+namespace WW
+{
+
+/**
+ * @brief NUMA节点
+ * @details 启用后每个节点使用各自的页缓存和中心缓存，页缓存向系统获取的内存绑定到对应节点，
+ * 线程缓存在创建时连接到所在节点。默认关闭，可以通过环境变量`WW_NUMA=1`按照系统的节点数启用，
+ * 或者通过`WW_NUMA_NODES`和`set_node_count`模拟指定数量的节点，模拟时按照CPU编号分配节点
+ */
+class Numa
+{
+private:
+    size_type _System_node_count;               // 系统的节点数
+    std::atomic<size_type> _Node_count;         // 使用的节点数，为1时不启用
+    std::atomic<size_type> _Max_node_count;     // 使用过的最大节点数
+
+private:
+    Numa();
+
+    Numa(const Numa &) = delete;
+
+    Numa & operator=(const Numa &) = delete;
+
+public:
+    ~Numa() = default;
+
+public:
+    /**
+     * @brief 获取NUMA单例
+     */
+    static Numa & get_numa();
+
+    /**
+     * @brief 是否已经启用
+     */
+    bool enabled() const noexcept;
+
+    /**
+     * @brief 获取系统的节点数
+     */
+    size_type system_node_count() const noexcept;
+
+    /**
+     * @brief 获取使用的节点数
+     */
+    size_type node_count() const noexcept;
+
+    /**
+     * @brief 获取使用过的最大节点数
+     * @details 统计信息时需要遍历所有已经创建的页缓存和中心缓存
+     */
+    size_type max_node_count() const noexcept;
+
+    /**
+     * @brief 设置使用的节点数
+     * @param _Count 节点数，限制在1到`MAX_NUMA_NODE_NUM`之间，和系统节点数不同时为模拟节点
+     * @details 只影响之后创建的线程缓存
+     */
+    void set_node_count(size_type _Count) noexcept;
+
+    /**
+     * @brief 获取当前线程所在的节点
+     * @details 优先使用`bind_thread`指定的节点，否则根据当前CPU计算
+     */
+    size_type current_node() const noexcept;
+
+    /**
+     * @brief 指定当前线程所在的节点
+     * @param _Node 节点，`NO_NUMA_NODE`表示取消指定
+     * @details 用于已经绑定CPU的线程或者测试，需要在线程第一次申请内存之前调用
+     */
+    static void bind_thread(size_type _Node) noexcept;
+
+    /**
+     * @brief 获取节点对应的系统节点
+     * @param _Node 节点
+     * @return 系统节点，未启用时返回`NO_NUMA_NODE`
+     * @details 模拟的节点多于系统节点时，多个节点共用同一个系统节点
+     */
+    size_type system_node(size_type _Node) const noexcept;
+};
+
+} // namespace WW
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <new>
+#include <utility>
+
+#include <FreeList.h>
+#include <Platform.h>
+
+namespace WW
+{
+
+/**
+ * @brief 定长对象池
+ * @details 从系统中整块获取内存，依次切出对象，释放的对象挂在自由链表上供下次使用，
+ * 不经过`malloc`，内存不会交还给系统。不加锁，由调用者保证同一时间只有一个线程使用
+ */
+template <typename _Ty>
+class ObjectPool
+{
+private:
+    /**
+     * @brief 每个对象占用的大小，至少可以放下一个指针，并满足对象的对齐要求
+     */
+    static constexpr size_type OBJECT_SIZE =
+        ((sizeof(_Ty) < sizeof(FreeObject) ? sizeof(FreeObject) : sizeof(_Ty)) + alignof(_Ty) - 1) & ~(alignof(_Ty) - 1);
+
+    static_assert(OBJECT_SIZE <= OBJECT_POOL_CHUNK_SIZE, "object is too large for the pool");
+
+private:
+    FreeObject * _Free_list;        // 已释放的对象
+    char * _Cursor;                 // 当前内存块中下一个可用位置
+    size_type _Remaining;           // 当前内存块剩余大小
+    size_type _Count;               // 正在使用的对象数
+
+public:
+    ObjectPool() noexcept
+        : _Free_list(nullptr)
+        , _Cursor(nullptr)
+        , _Remaining(0)
+        , _Count(0)
+    {
+    }
+
+    ObjectPool(const ObjectPool &) = delete;
+
+    ObjectPool & operator=(const ObjectPool &) = delete;
+
+    ~ObjectPool() = default;
+
+public:
+    /**
+     * @brief 创建一个对象
+     * @param _Arguments 构造参数
+     * @return 成功时返回对象指针，内存不足时返回`nullptr`
+     */
+    template <typename... _Args>
+    _Ty * create(_Args &&... _Arguments)
+    {
+        void * _Ptr = nullptr;
+
+        if (_Free_list != nullptr) {
+            // 优先复用已释放的对象
+            _Ptr = _Free_list;
+            _Free_list = _Free_list->next();
+        } else {
+            if (_Remaining < OBJECT_SIZE) {
+                // 当前内存块用完，剩余部分不足一个对象，直接丢弃
+                _Cursor = static_cast<char *>(Platform::system_malloc(OBJECT_POOL_CHUNK_SIZE));
+                if (_Cursor == nullptr) {
+                    _Remaining = 0;
+                    return nullptr;
+                }
+                _Remaining = OBJECT_POOL_CHUNK_SIZE;
+            }
+
+            _Ptr = _Cursor;
+            _Cursor += OBJECT_SIZE;
+            _Remaining -= OBJECT_SIZE;
+        }
+
+        ++_Count;
+        return new(_Ptr) _Ty(std::forward<_Args>(_Arguments)...);
+    }
+
+    /**
+     * @brief 销毁一个对象
+     * @param _Obj 由`create`创建的对象
+     */
+    void destroy(_Ty * _Obj) noexcept
+    {
+        if (_Obj == nullptr) {
+            return;
+        }
+
+        _Obj->~_Ty();
+
+        FreeObject * _Free_obj = reinterpret_cast<FreeObject *>(_Obj);
+        _Free_obj->set_next(_Free_list);
+        _Free_list = _Free_obj;
+        --_Count;
+    }
+
+    /**
+     * @brief 获取正在使用的对象数
+     */
+    size_type size() const noexcept
+    {
+        return _Count;
+    }
+};
+
+} // namespace WW
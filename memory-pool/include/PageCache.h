@@ -1,29 +1,47 @@
 #pragma once
 
 #include <array>
-#include <vector>
-#include <unordered_map>
-#include <map>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 #include <SpanList.h>
+#include <PageMap.h>
+#include <ObjectPool.h>
 
 namespace WW
 {
 
+class MemoryStats;
+
 /**
  * @brief 页缓存
+ * @details 每种页数有一个独立加锁的页段缓存，保存最近归还的页段，
+ * 申请和归还优先经过页段缓存，只有未命中时才需要获取负责切分和合并的全局锁。
+ * 超过最大页数的空闲页段保存在超大页段链表中，合并页段没有页数上限，达到`DIRECT_MMAP_SIZE`的页段直接向系统映射。
+ * 每个页段链表中，物理内存仍然保留的页段在前，已经归还给系统的页段在后，
+ * 申请时优先使用前者。启用NUMA时每个节点一个页缓存，向系统获取的内存绑定到该节点，只和同一节点的页段合并
  */
 class PageCache
 {
 private:
     std::array<SpanList, MAX_PAGE_NUM> _Spans;              // 页段链表数组
-    std::unordered_map<size_type, Span *> _Free_span_map;   // 页号到空闲页段指针的映射
-    std::map<size_type, Span *> _Busy_span_map;             // 页号到繁忙页段指针的映射
-    std::vector<void *> _Align_pointers;                    // 对齐指针数组
+    std::array<SpanList, MAX_PAGE_NUM> _Span_caches;        // 每种页数的页段缓存，使用各自的锁
+    std::array<size_type, MAX_PAGE_NUM> _Span_cache_counts; // 页段缓存中的页段数
+    SpanList _Large_spans;                                  // 超过最大页数的空闲页段
+    size_type _Direct_pages;                                // 直接映射的页数
+    size_type _Node;                                        // 所属的NUMA节点
+    PageMap & _Page_map;                                    // 页号到页段指针的映射，所有节点共用
+    ObjectPool<Span> _Span_pool;                            // 页段对象池，由页缓存锁保护
     std::mutex _Mutex;                                      // 页缓存锁
+    std::atomic<size_type> _Release_rate;                   // 后台回收线程每秒归还的页数
+    std::thread _Scavenger;                                 // 后台回收线程
+    std::mutex _Scavenger_mutex;                            // 后台回收线程锁
+    std::condition_variable _Scavenger_cond;                // 用于唤醒后台回收线程
+    bool _Scavenger_stop;                                   // 后台回收线程是否需要退出
 
 private:
-    PageCache();
+    explicit PageCache(size_type _Node);
 
     PageCache(const PageCache &) = delete;
 
@@ -35,29 +53,121 @@ public:
 public:
     /**
      * @brief 获取页缓存单例
+     * @details 即第0个NUMA节点的页缓存，未启用NUMA时只有这一个
      */
     static PageCache & get_page_cache();
 
+    /**
+     * @brief 获取指定NUMA节点的页缓存
+     * @param _Node 节点
+     * @details 按需创建，除第0个节点外不会析构
+     */
+    static PageCache & get_page_cache(size_type _Node);
+
+    /**
+     * @brief 获取所属的NUMA节点
+     */
+    size_type node() const noexcept;
+
     /**
      * @brief 获取指定大小的页段
-     * @param _Pages 页数
+     * @param _Pages 页数，可以超过`MAX_PAGE_NUM`
      * @return 成功时返回`Span *`，失败时返回`nullptr`
      */
     Span * fetch_span(size_type _Pages);
 
+    /**
+     * @brief 获取首页按指定页数对齐的页段
+     * @param _Pages 页数，可以超过`MAX_PAGE_NUM`
+     * @param _Align_pages 对齐的页数，必须是2的幂
+     * @return 成功时返回`Span *`，失败时返回`nullptr`
+     * @details 先切出多`_Align_pages - 1`页的页段，再把首尾多出的部分作为空闲页段归还，不经过页段缓存
+     */
+    Span * fetch_aligned_span(size_type _Pages, size_type _Align_pages);
+
     /**
      * @brief 将页段归还到页缓存
      * @param _Span 页段
      */
     void return_span(Span * _Span);
 
+    /**
+     * @brief 原地调整繁忙页段的页数
+     * @param _Span 繁忙页段，不能是直接映射的页段
+     * @param _Pages 新的页数，不能达到`DIRECT_MMAP_SIZE`
+     * @return 成功时返回`true`，后面没有足够的空闲页时返回`false`
+     * @details 增大时从紧随其后的同一节点的空闲页段中切出需要的页，缩小时把多出的页作为空闲页段归还
+     */
+    bool resize_span(Span * _Span, size_type _Pages);
+
     /**
      * @brief 通过内存块指针找到对应页段
      * @param _Ptr 内存块指针
      * @return 成功时返回`Span *`，失败时返回`nullptr`
+     * @details 通过页号映射无锁查找
      */
     Span * object_to_span(void * _Ptr) noexcept;
 
+    /**
+     * @brief 将页段缓存中的页段全部归还页缓存并合并
+     */
+    void flush_span_caches();
+
+    /**
+     * @brief 将空闲页段的物理内存归还给系统
+     * @return 归还的页数
+     * @details 先清空同一节点中心缓存的传输缓存和完全空闲的页段以及页段缓存，虚拟地址仍然由页缓存管理，再次使用时不需要额外操作
+     */
+    size_type release_free_memory();
+
+    /**
+     * @brief 将空闲页段的物理内存归还给系统，至少归还指定页数
+     * @param _Pages 页数
+     * @return 归还的页数
+     * @details 优先归还大页段，空闲内存不足时归还全部空闲页段。页缓存中未归还的空闲页不足指定页数时，才先清空下层缓存。使用显式大页时不归还
+     */
+    size_type release_free_memory(size_type _Pages);
+
+    /**
+     * @brief 设置后台回收线程每秒归还的页数
+     * @param _Pages 页数，为0时后台回收线程不归还内存
+     */
+    void set_release_rate(size_type _Pages) noexcept;
+
+    /**
+     * @brief 获取后台回收线程每秒归还的页数
+     */
+    size_type release_rate() const noexcept;
+
+    /**
+     * @brief 启动后台回收线程
+     * @details 已经启动时什么都不做
+     */
+    void start_scavenger();
+
+    /**
+     * @brief 停止后台回收线程
+     * @details 不能和`start_scavenger`并发调用
+     */
+    void stop_scavenger();
+
+    /**
+     * @brief 统计空闲页段
+     * @param _Stats 统计信息，累加到页缓存相关的字段
+     */
+    void collect_stats(MemoryStats & _Stats);
+
+    /**
+     * @brief 给页缓存加锁
+     * @details 用于`fork`前保持页缓存状态一致
+     */
+    void lock() noexcept;
+
+    /**
+     * @brief 给页缓存解锁
+     */
+    void unlock() noexcept;
+
 private:
     /**
      * @brief 从系统内存中获取指定大小的内存
@@ -65,6 +175,69 @@ private:
      * @return 成功时返回`void *`，失败时返回`nullptr`
      */
     void * _Fetch_from_system(size_type _Pages) const noexcept;
+
+    /**
+     * @brief 在全局锁下获取指定大小的页段，必要时切分更大的页段
+     * @param _Pages 页数
+     * @return 成功时返回`Span *`，失败时返回`nullptr`
+     */
+    Span * _Fetch_from_spans(size_type _Pages);
+
+    /**
+     * @brief 从空闲页段中切出指定大小的繁忙页段
+     * @param _Span 已经从链表中取出的空闲页段
+     * @param _Pages 页数
+     * @return 成功时返回`Span *`，失败时将空闲页段放回链表并返回`nullptr`
+     */
+    Span * _Carve_span(Span * _Span, size_type _Pages);
+
+    /**
+     * @brief 直接向系统映射页段
+     * @param _Pages 页数
+     * @param _Align_pages 首页对齐的页数
+     * @return 成功时返回`Span *`，失败时返回`nullptr`
+     */
+    Span * _Fetch_direct(size_type _Pages, size_type _Align_pages = 1);
+
+    /**
+     * @brief 将直接映射的页段交还给系统
+     * @param _Span 页段
+     */
+    void _Return_direct(Span * _Span);
+
+    /**
+     * @brief 在全局锁下归还页段，并与相邻的空闲页段合并
+     * @param _Span 页段
+     */
+    void _Return_to_spans(Span * _Span);
+
+    /**
+     * @brief 在全局锁下判断未归还的空闲页是否达到指定页数
+     */
+    bool _Has_committed_pages(size_type _Pages) noexcept;
+
+    /**
+     * @brief 判断相邻页段能否与页段合并
+     * @details 相邻页段必须属于同一节点、空闲且物理内存归还状态相同
+     */
+    bool _Can_merge(const Span * _Span, const Span * _Neighbor) const noexcept;
+
+    /**
+     * @brief 获取指定页数的空闲页段所在的链表
+     * @details 超过最大页数时返回超大页段链表
+     */
+    SpanList & _Free_span_list(size_type _Pages) noexcept;
+
+    /**
+     * @brief 将空闲页段插入对应链表
+     * @details 已归还的页段插入尾部，其他页段插入头部
+     */
+    void _Insert_free_span(Span * _Span) noexcept;
+
+    /**
+     * @brief 后台回收线程入口
+     */
+    void _Scavenge();
 };
 
 } // namespace WW
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+
+#include <Common.h>
+
+namespace WW
+{
+
+class Span;
+
+/**
+ * @brief 页号到页段的映射
+ * @details 三层基数树，覆盖48位地址空间，节点按需创建，未使用的地址区间不占用内存。
+ * 读取和节点创建不需要加锁，所有页缓存共用同一个映射，写入由页段所属的页缓存加锁保护
+ */
+class PageMap
+{
+private:
+    static constexpr size_type ADDRESS_BITS = 48;                                   // 地址位数
+    static constexpr size_type PAGE_ID_BITS = ADDRESS_BITS - PAGE_SHIFT;            // 页号位数
+    static constexpr size_type ROOT_BITS = PAGE_ID_BITS / 3;                        // 根节点位数
+    static constexpr size_type INTERIOR_BITS = PAGE_ID_BITS / 3;                    // 中间节点位数
+    static constexpr size_type LEAF_BITS = PAGE_ID_BITS - ROOT_BITS - INTERIOR_BITS;// 叶子节点位数
+    static constexpr size_type ROOT_LENGTH = static_cast<size_type>(1) << ROOT_BITS;
+    static constexpr size_type INTERIOR_LENGTH = static_cast<size_type>(1) << INTERIOR_BITS;
+    static constexpr size_type LEAF_LENGTH = static_cast<size_type>(1) << LEAF_BITS;
+
+    /**
+     * @brief 叶子节点
+     */
+    class Leaf
+    {
+    public:
+        std::atomic<Span *> values[LEAF_LENGTH];
+    };
+
+    /**
+     * @brief 中间节点
+     */
+    class Interior
+    {
+    public:
+        std::atomic<Leaf *> leaves[INTERIOR_LENGTH];
+    };
+
+private:
+    std::atomic<Interior *> _Root[ROOT_LENGTH];             // 根节点
+
+public:
+    PageMap();
+
+    PageMap(const PageMap &) = delete;
+
+    PageMap & operator=(const PageMap &) = delete;
+
+    ~PageMap();
+
+public:
+    /**
+     * @brief 获取页号映射单例
+     */
+    static PageMap & get_page_map();
+
+    /**
+     * @brief 获取页号对应的页段
+     * @param _Page_id 页号
+     * @return 成功时返回`Span *`，未映射时返回`nullptr`
+     * @details 无锁读取
+     */
+    Span * get(size_type _Page_id) const noexcept;
+
+    /**
+     * @brief 设置页号对应的页段
+     * @param _Page_id 页号
+     * @param _Span 页段
+     * @details 需要先调用`ensure`保证节点存在
+     */
+    void set(size_type _Page_id, Span * _Span) noexcept;
+
+    /**
+     * @brief 将连续的页号都映射到同一个页段
+     * @param _Page_id 起始页号
+     * @param _Count 页数
+     * @param _Span 页段
+     */
+    void set_range(size_type _Page_id, size_type _Count, Span * _Span) noexcept;
+
+    /**
+     * @brief 保证覆盖指定页号区间的节点都已经创建
+     * @param _Page_id 起始页号
+     * @param _Count 页数
+     * @return 成功时返回`true`，内存不足或超出地址范围时返回`false`
+     */
+    bool ensure(size_type _Page_id, size_type _Count) noexcept;
+
+private:
+    /**
+     * @brief 创建一个节点
+     * @return 成功时返回节点指针，失败时返回`nullptr`
+     */
+    template <typename _Node>
+    static _Node * _New_node() noexcept;
+
+    /**
+     * @brief 销毁一个节点
+     */
+    template <typename _Node>
+    static void _Delete_node(_Node * _Ptr) noexcept;
+};
+
+} // namespace WW
@@ -10,6 +10,17 @@ namespace WW
 */
 class Platform
 {
+public:
+    /**
+     * @brief 系统内存的页类型
+     */
+    enum class PageMode
+    {
+        NORMAL,                 // 普通页
+        TRANSPARENT_HUGE,       // 透明大页，由内核在后台合并
+        EXPLICIT_HUGE           // 显式大页，需要系统预留大页，预留不足时缩小区域直至退回普通页，不支持归还物理内存
+    };
+
 public:
     /**
      * @brief 从堆中以对齐方法获取内存
@@ -23,6 +34,85 @@ public:
      * @param _Ptr 释放内存的指针
     */
     static void aligned_free(void * _Ptr);
+
+    /**
+     * @brief 从系统中获取整页内存
+     * @param _Size 获取内存大小，页大小的整数倍
+     * @return 成功时返回按页对齐的指针，失败时返回`nullptr`
+     * @param _Node 内存绑定的NUMA节点，`NO_NUMA_NODE`表示不绑定
+     * @details 每次向系统预留一大段虚拟内存，之后通过移动指针分配，获取的内存不会再交还给系统。
+     * 每个节点使用各自的预留区域，区域在预留时绑定到节点
+    */
+    static void * system_malloc(size_type _Size, size_type _Node = NO_NUMA_NODE);
+
+    /**
+     * @brief 直接向系统映射一段内存
+     * @param _Size 内存大小，页大小的整数倍
+     * @param _Alignment 对齐大小，页大小的整数倍并且是2的幂
+     * @return 成功时返回按`_Alignment`对齐的指针，失败时返回`nullptr`
+     * @details 用于超大内存，可以通过`system_unmap`立即交还给系统。
+     * 超过页大小的对齐先多映射一段，再把首尾多出的部分交还
+    */
+    static void * system_map(size_type _Size, size_type _Alignment = PAGE_SIZE);
+
+    /**
+     * @brief 将内存绑定到NUMA节点
+     * @param _Ptr 内存指针，按页对齐
+     * @param _Size 内存大小，页大小的整数倍
+     * @param _Node NUMA节点
+     * @return 成功时返回`true`，不支持或失败时返回`false`
+     * @details 使用`mbind`设置优先节点，之后首次访问时从该节点分配物理页，节点内存不足时可以使用其他节点
+    */
+    static bool bind_node(void * _Ptr, size_type _Size, size_type _Node);
+
+    /**
+     * @brief 将`system_map`映射的内存交还给系统
+     * @param _Ptr 内存指针
+     * @param _Size 内存大小
+    */
+    static void system_unmap(void * _Ptr, size_type _Size);
+
+    /**
+     * @brief 设置向系统预留内存时使用的页类型
+     * @details 之后获取的内存都来自新预留的区域。默认值由环境变量`WW_HUGE_PAGES`决定，取值为`thp`或`hugetlb`，未设置时使用普通页
+    */
+    static void set_page_mode(PageMode _Mode);
+
+    /**
+     * @brief 获取向系统预留内存时使用的页类型
+    */
+    static PageMode page_mode();
+
+    /**
+     * @brief 获取通过`system_malloc`分配出去的内存总量
+    */
+    static size_type system_allocated_size();
+
+    /**
+     * @brief 获取向系统预留的虚拟内存总量
+    */
+    static size_type system_reserved_size();
+
+    /**
+     * @brief 将内存对应的物理页归还给系统
+     * @param _Ptr 内存指针，按页对齐
+     * @param _Size 内存大小，页大小的整数倍
+     * @return 成功时返回`true`，失败时返回`false`
+     * @details 虚拟地址仍然有效，再次访问时由系统重新分配清零的物理页。使用显式大页时不支持归还，总是返回`false`；
+     * 切换页类型前预留的显式大页区域同样无法按页归还
+    */
+    static bool release(void * _Ptr, size_type _Size);
+
+    /**
+     * @brief 给系统内存加锁
+     * @details 用于`fork`前保持预留区域状态一致，需要在所有缓存之后加锁
+    */
+    static void lock() noexcept;
+
+    /**
+     * @brief 给系统内存解锁
+    */
+    static void unlock() noexcept;
 };
 
 } // namespace WW
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+#include <Common.h>
+
+namespace WW
+{
+
+/**
+ * @brief 一次采样的申请
+ */
+class ProfileSample
+{
+public:
+    void * ptr;                             // 申请得到的内存
+    size_type size;                         // 申请的大小
+    size_type rate;                         // 采样时的平均采样间隔
+    size_type depth;                        // 调用栈深度
+    void * stack[PROFILER_MAX_DEPTH];       // 调用栈，从申请处向外
+    ProfileSample * next;                   // 同一个桶中的下一个采样
+};
+
+/**
+ * @brief 堆采样分析
+ * @details 每个线程缓存维护一个倒计时，每次申请减去申请的大小，不够减时采样这次申请并按几何分布重新计时，
+ * 平均每申请采样间隔字节采样一次。采样的调用栈按指针保存在哈希表中，释放时删除。开启时打开每个线程缓存的钩子，
+ * 关闭后最后一个采样被释放时再关闭，没有采样时释放只检查线程缓存中的标志。
+ * 默认关闭，可以通过环境变量`WW_PROFILE_SAMPLE_RATE=字节数`或者`set_sample_rate`开启，调用栈只支持`Linux`
+ */
+class Profiler
+{
+private:
+    std::atomic<size_type> _Sample_rate;                                    // 平均采样间隔，0表示关闭
+    std::atomic<size_type> _Sample_count;                                   // 仍然存活的采样数，在内存池锁下修改
+    std::array<std::atomic<ProfileSample *>, PROFILER_BUCKET_NUM> _Buckets; // 按指针哈希的采样
+    std::array<std::mutex, PROFILER_LOCK_NUM> _Bucket_mutexes;              // 桶锁
+    std::mutex _Pool_mutex;                                                 // 采样记录内存池锁
+
+private:
+    Profiler();
+
+    Profiler(const Profiler &) = delete;
+
+    Profiler & operator=(const Profiler &) = delete;
+
+public:
+    ~Profiler() = default;
+
+public:
+    /**
+     * @brief 获取堆采样单例
+     */
+    static Profiler & get_profiler();
+
+    /**
+     * @brief 是否正在采样
+     */
+    bool enabled() const noexcept;
+
+    /**
+     * @brief 获取平均采样间隔
+     * @return 字节数，关闭时为0
+     */
+    size_type sample_rate() const noexcept;
+
+    /**
+     * @brief 设置平均采样间隔
+     * @param _Rate 字节数，为0时关闭，已有的采样保留到释放
+     * @details 已有线程最多在申请`PROFILER_RECHECK_SIZE`后使用新的间隔
+     */
+    void set_sample_rate(size_type _Rate) noexcept;
+
+    /**
+     * @brief 获取仍然存活的采样数
+     */
+    size_type sample_count() const noexcept;
+
+    /**
+     * @brief 计算下一次采样前的申请字节数
+     * @return 按几何分布随机，关闭时为`PROFILER_RECHECK_SIZE`
+     */
+    size_type next_sample_interval() noexcept;
+
+    /**
+     * @brief 记录一次采样的申请
+     * @param _Ptr 申请得到的内存
+     * @param _Size 申请的大小
+     * @details 记录调用者的调用栈，采样过程中再次申请的内存不会被采样
+     */
+    void record_allocate(void * _Ptr, size_type _Size) noexcept;
+
+    /**
+     * @brief 删除释放的内存的采样
+     * @param _Ptr 释放的内存，没有被采样时直接返回
+     */
+    void record_deallocate(void * _Ptr) noexcept;
+
+    /**
+     * @brief 复制当前所有存活的采样
+     * @param _Samples 保存采样，之前的内容会被清空
+     */
+    void snapshot(std::vector<ProfileSample> & _Samples);
+
+    /**
+     * @brief 以`pprof`的堆格式写入存活的采样
+     * @param _Path 文件路径，已存在时覆盖
+     * @return 成功返回`true`
+     * @details 相同调用栈合并，写入采样的原始次数和大小，由`pprof`按采样间隔估计实际值
+     */
+    bool dump_pprof(const char * _Path);
+
+    /**
+     * @brief 以折叠调用栈格式写入存活的采样
+     * @param _Path 文件路径，已存在时覆盖
+     * @return 成功返回`true`
+     * @details 每行为从外到内以`;`分隔的函数名和估计的存活字节数，可以直接交给`flamegraph.pl`，
+     * 可执行文件中的函数需要以`-rdynamic`链接才能解析出名字
+     */
+    bool dump_folded(const char * _Path);
+
+    /**
+     * @brief 给所有桶和内存池加锁
+     * @details 用于`fork`前保持状态一致
+     */
+    void lock() noexcept;
+
+    /**
+     * @brief 给所有桶和内存池解锁
+     */
+    void unlock() noexcept;
+
+private:
+    /**
+     * @brief 计算指针所在的桶
+     */
+    static size_type _Bucket_index(void * _Ptr) noexcept;
+
+    /**
+     * @brief 关闭采样并且没有存活的采样时关闭线程缓存的钩子
+     * @details 需要持有内存池锁
+     */
+    void _Update_hook() noexcept;
+};
+
+} // namespace WW
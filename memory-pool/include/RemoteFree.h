@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <atomic>
+
+#include <FreeList.h>
+#include <ObjectPool.h>
+
+namespace WW
+{
+
+/**
+ * @brief 远程释放队列
+ * @details 每种大小一个无锁的多生产者单消费者链表，其他线程压入，
+ * 所属线程一次取走整个链表，关闭后或者超出`MAX_REMOTE_QUEUE_BYTES`时压入失败，由释放线程自行处理
+ */
+class RemoteQueue
+{
+private:
+    std::array<std::atomic<FreeObject *>, MAX_ARRAY_SIZE> _Heads;  // 每种大小的链表头
+    std::array<std::atomic<size_type>, MAX_ARRAY_SIZE> _Counts;     // 每种大小的内存块数量
+
+public:
+    RemoteQueue();
+
+    RemoteQueue(const RemoteQueue &) = delete;
+
+    RemoteQueue & operator=(const RemoteQueue &) = delete;
+
+    ~RemoteQueue() = default;
+
+public:
+    /**
+     * @brief 压入一个内存块
+     * @param _Index 内存块所在的索引
+     * @param _Obj 内存块
+     * @return 成功返回`true`，队列已关闭或已满时返回`false`
+     */
+    bool push(size_type _Index, FreeObject * _Obj) noexcept;
+
+    /**
+     * @brief 取走一种大小的所有内存块
+     * @param _Index 内存块所在的索引
+     * @param _Begin 首个内存块
+     * @param _End 最后一个内存块
+     * @return 取走的数量
+     * @details 只能由所属线程调用
+     */
+    size_type pop_all(size_type _Index, FreeObject *& _Begin, FreeObject *& _End) noexcept;
+
+    /**
+     * @brief 打开队列，开始接收内存块
+     */
+    void open() noexcept;
+
+    /**
+     * @brief 关闭队列，剩余的内存块逐个归还所属节点的中心缓存
+     */
+    void close() noexcept;
+};
+
+/**
+ * @brief 远程释放
+ * @details 线程释放其他线程申请的内存块时，放入申请线程的远程释放队列，
+ * 申请线程自由表为空时优先取回，减少对中心缓存的访问。默认关闭，可以通过环境变量`WW_REMOTE_FREE=1`或者`set_enabled`启用
+ */
+class RemoteFree
+{
+private:
+    std::array<std::atomic<RemoteQueue *>, MAX_REMOTE_QUEUE_NUM> _Queues;  // 远程释放队列，按需创建，不会销毁
+    std::array<std::atomic<bool>, MAX_REMOTE_QUEUE_NUM> _Used;             // 队列是否已经被线程占用
+    std::atomic<bool> _Enabled;                                             // 是否启用
+    ObjectPool<RemoteQueue> _Queue_pool;                                    // 队列的内存池
+    std::mutex _Mutex;                                                      // 队列内存池锁
+
+private:
+    RemoteFree();
+
+    RemoteFree(const RemoteFree &) = delete;
+
+    RemoteFree & operator=(const RemoteFree &) = delete;
+
+public:
+    ~RemoteFree() = default;
+
+public:
+    /**
+     * @brief 获取远程释放单例
+     */
+    static RemoteFree & get_remote_free();
+
+    /**
+     * @brief 是否已经启用
+     */
+    bool enabled() const noexcept;
+
+    /**
+     * @brief 启用或关闭远程释放
+     * @details 只有启用之后创建的线程缓存才会占用队列，关闭后已经占用的队列仍会被取回
+     */
+    void set_enabled(bool _Enabled) noexcept;
+
+    /**
+     * @brief 占用一个队列
+     * @return 队列编号，从1开始，没有空闲队列或内存不足时返回0
+     */
+    size_type acquire() noexcept;
+
+    /**
+     * @brief 释放占用的队列
+     * @param _Id 队列编号
+     * @details 关闭队列并将剩余的内存块归还中心缓存
+     */
+    void release(size_type _Id) noexcept;
+
+    /**
+     * @brief 获取队列
+     * @param _Id 队列编号
+     * @return 成功返回`RemoteQueue *`，编号无效时返回`nullptr`
+     */
+    RemoteQueue * queue(size_type _Id) noexcept;
+
+    /**
+     * @brief 给队列内存池加锁
+     * @details 用于`fork`前保持队列内存池状态一致
+     */
+    void lock() noexcept;
+
+    /**
+     * @brief 给队列内存池解锁
+     */
+    void unlock() noexcept;
+};
+
+} // namespace WW
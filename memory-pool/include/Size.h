@@ -5,9 +5,20 @@
 namespace WW
 {
 
+/**
+ * @brief 大小类别
+ * @details 一次查表同时得到数组索引和对齐后的大小
+ */
+class SizeClass
+{
+public:
+    size_type index;        // 数组索引
+    size_type size;         // 对齐后的内存块大小
+};
+
 /**
  * @brief 大小
- * @details 用于提供索引和大小相互转换的规则
+ * @details 用于提供索引和大小相互转换的规则，通过编译期生成的表查找
  */
 class Size
 {
@@ -23,16 +34,31 @@ public:
      * @brief 根据内存块大小获取数组索引
      * @param _Size 内存块大小
      * @return 数组索引
-     * @details `_Size`是对齐之后的大小
+     * @details `_Size`可以是对齐之前的大小
      */
     static size_type size_to_index(size_type _Size) noexcept;
 
+    /**
+     * @brief 根据数组索引获取线程缓存每批内存块的数量
+     * @param _Index 数组索引
+     * @return 每批的数量
+     * @details 小内存块每批更多，大内存块每批更少，使每批的总大小大致相同
+     */
+    static size_type batch_size(size_type _Index) noexcept;
+
     /**
      * @brief 对齐内存块大小
      * @param _Size 内存块大小
      * @return 对齐后的内存块大小
      */
     static size_type round_up(size_type _Size) noexcept;
+
+    /**
+     * @brief 根据内存块大小获取大小类别
+     * @param _Size 内存块大小，不能超过`MAX_MEMORY_SIZE`
+     * @return 数组索引和对齐后的大小
+     */
+    static SizeClass size_to_class(size_type _Size) noexcept;
 };
 
-} // namespace WW
\ No newline at end of file
+} // namespace WW
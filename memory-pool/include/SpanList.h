@@ -1,6 +1,7 @@
 #pragma once
 
 #include <mutex>
+#include <atomic>
 
 #include <FreeList.h>
 
@@ -20,10 +21,21 @@ private:
     Span * _Next;                   // 后一个页段
     size_type _Page_count;          // 页数
     size_type _Used;                // 已使用的内存块数
+    bool _Is_use;                   // 是否被中心缓存使用
+    size_type _Object_size;         // 切分的内存块大小
+    bool _Is_released;              // 物理内存是否已经归还给系统
+    bool _Is_large;                 // 是否作为一个大内存整体分配出去
+    std::atomic<size_type> _Owner;  // 最近从该页段获取内存块的线程缓存的远程队列编号，0表示没有
+    size_type _Node;                // 所属的NUMA节点，创建后不变
 
 public:
     Span();
 
+    /**
+     * @param _Node 所属的NUMA节点
+     */
+    explicit Span(size_type _Node);
+
     ~Span() = default;
 
 public:
@@ -77,6 +89,66 @@ public:
      */
     void set_used(size_type _Used) noexcept;
 
+    /**
+     * @brief 是否被中心缓存使用
+     */
+    bool is_use() const noexcept;
+
+    /**
+     * @brief 设置是否被中心缓存使用
+     */
+    void set_use(bool _Is_use) noexcept;
+
+    /**
+     * @brief 获取切分的内存块大小
+     * @details 未切分时为0
+     */
+    size_type object_size() const noexcept;
+
+    /**
+     * @brief 设置切分的内存块大小
+     */
+    void set_object_size(size_type _Object_size) noexcept;
+
+    /**
+     * @brief 是否作为一个大内存整体分配出去
+     * @details 对齐的大内存可能只有一页，不能通过内存块大小区分
+     */
+    bool is_large() const noexcept;
+
+    /**
+     * @brief 设置是否作为一个大内存整体分配出去
+     */
+    void set_large(bool _Is_large) noexcept;
+
+    /**
+     * @brief 物理内存是否已经归还给系统
+     * @details 已归还的页段再次使用时由系统按需重新分配物理页，不需要额外操作
+     */
+    bool is_released() const noexcept;
+
+    /**
+     * @brief 设置物理内存是否已经归还给系统
+     */
+    void set_released(bool _Is_released) noexcept;
+
+    /**
+     * @brief 获取所属线程缓存的远程队列编号
+     * @details 其他线程可以随时读取，只作为远程释放的目标，不保证准确
+     */
+    size_type owner() const noexcept;
+
+    /**
+     * @brief 设置所属线程缓存的远程队列编号
+     */
+    void set_owner(size_type _Owner) noexcept;
+
+    /**
+     * @brief 获取所属的NUMA节点
+     * @details 同一个页缓存的页段对象只在该页缓存的对象池中复用，其他页缓存可以不加锁读取
+     */
+    size_type node() const noexcept;
+
     /**
      * @brief 获取空闲内存块链表
      */
@@ -197,6 +269,11 @@ public:
      */
     void push_front(Span * _Span) noexcept;
 
+    /**
+     * @brief 将页段插入到尾部
+     */
+    void push_back(Span * _Span) noexcept;
+
     /**
      * @brief 从头部删除页段
      */
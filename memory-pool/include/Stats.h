@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <string>
+
+#include <Common.h>
+
+namespace WW
+{
+
+/**
+ * @brief 单个大小的统计信息
+ * @details 除`size`外，数量的单位都是内存块
+ */
+class SizeClassStats
+{
+public:
+    size_type size;                         // 内存块大小
+    size_type in_use;                       // 应用程序正在使用的数量
+    size_type thread_cached;                // 线程缓存中的数量
+    size_type cpu_cached;                   // CPU缓存中的数量
+    size_type transfer_cached;              // 传输缓存中的数量
+    size_type central_cached;               // 中心缓存页段中的数量
+    size_type spans;                        // 中心缓存持有的页段数
+    size_type pages;                        // 中心缓存持有的页数
+    size_type allocate_count;               // 申请次数
+    size_type deallocate_count;             // 释放次数
+    size_type fetch_count;                  // 从中心缓存获取的次数
+    size_type return_count;                 // 归还中心缓存的次数
+    size_type underflow_count;              // 线程缓存自由表为空的次数
+    size_type overflow_count;               // 线程缓存自由表超长的次数
+    size_type remote_free_count;            // 放入申请线程远程释放队列的次数
+};
+
+/**
+ * @brief 内存池的统计信息
+ * @details 除计数外，单位都是字节
+ */
+class MemoryStats
+{
+public:
+    size_type in_use_bytes;                                 // 应用程序正在使用的内存
+    size_type thread_cache_bytes;                           // 线程缓存中的内存
+    size_type thread_cache_limit_bytes;                     // 所有线程缓存最多保存的内存
+    size_type cpu_cache_bytes;                              // CPU缓存中的内存
+    size_type transfer_cache_bytes;                         // 传输缓存中的内存
+    size_type central_cache_bytes;                          // 中心缓存页段中的空闲内存
+    size_type fragmented_bytes;                             // 页段切分后剩余的不足一个内存块的内存
+    size_type span_cache_bytes;                             // 页缓存的页段缓存中的内存
+    size_type page_cache_bytes;                             // 页缓存中未归还给系统的空闲内存
+    size_type page_cache_released_bytes;                    // 页缓存中已经归还给系统的空闲内存
+    size_type direct_mapped_bytes;                          // 直接向系统映射的超大内存
+    size_type system_allocated_bytes;                       // 页缓存从系统获取的内存
+    size_type system_reserved_bytes;                        // 向系统预留的虚拟内存
+    size_type large_allocate_count;                         // 超出管理范围的申请次数
+    size_type large_deallocate_count;                       // 超出管理范围的释放次数
+    std::array<SizeClassStats, MAX_ARRAY_SIZE> size_classes;// 每种大小的统计信息
+    std::array<size_type, MAX_PAGE_NUM> free_spans;         // 页缓存中每种页数的空闲页段数
+    std::array<size_type, MAX_PAGE_NUM> released_spans;     // 其中已经归还给系统的页段数
+    size_type large_free_spans;                             // 页缓存中超过最大页数的空闲页段数
+};
+
+/**
+ * @brief 统计计数器
+ * @details 同一时间只有一个线程写入，其他线程可以随时读取，写入不需要原子的读改写指令
+ */
+class StatsCounter
+{
+private:
+    std::atomic<size_type> _Value;          // 计数值
+
+public:
+    StatsCounter() noexcept;
+
+    ~StatsCounter() = default;
+
+public:
+    /**
+     * @brief 增加计数
+     */
+    void add(size_type _Value) noexcept
+    {
+        this->_Value.store(this->_Value.load(std::memory_order_relaxed) + _Value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 减少计数
+     */
+    void sub(size_type _Value) noexcept
+    {
+        this->_Value.store(this->_Value.load(std::memory_order_relaxed) - _Value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 读取计数
+     */
+    size_type load() const noexcept
+    {
+        return _Value.load(std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief 线程统计
+ * @details 每个线程一份，只由所属线程修改，读取统计信息时合并所有线程的计数，
+ * 线程退出时计数合并到全局
+ */
+class ThreadStats
+{
+public:
+    std::array<StatsCounter, MAX_ARRAY_SIZE> allocate_count;    // 申请次数
+    std::array<StatsCounter, MAX_ARRAY_SIZE> deallocate_count;  // 释放次数
+    std::array<StatsCounter, MAX_ARRAY_SIZE> thread_cached;     // 线程缓存中的内存块数
+    std::array<StatsCounter, MAX_ARRAY_SIZE> fetch_count;       // 从中心缓存获取的次数
+    std::array<StatsCounter, MAX_ARRAY_SIZE> return_count;      // 归还中心缓存的次数
+    std::array<StatsCounter, MAX_ARRAY_SIZE> underflow_count;   // 线程缓存自由表为空的次数
+    std::array<StatsCounter, MAX_ARRAY_SIZE> overflow_count;    // 线程缓存自由表超长的次数
+    std::array<StatsCounter, MAX_ARRAY_SIZE> remote_free_count; // 放入申请线程远程释放队列的次数
+    StatsCounter large_allocate_count;                          // 超出管理范围的申请次数
+    StatsCounter large_deallocate_count;                        // 超出管理范围的释放次数
+
+private:
+    ThreadStats * _Prev;                    // 上一个线程的统计
+    ThreadStats * _Next;                    // 下一个线程的统计
+
+    friend class StatsRegistry;
+
+public:
+    ThreadStats();
+
+    ThreadStats(const ThreadStats &) = delete;
+
+    ThreadStats & operator=(const ThreadStats &) = delete;
+
+    ~ThreadStats() = default;
+
+public:
+    /**
+     * @brief 获取当前线程的统计
+     * @details 首次获取时登记到登记表，线程退出时删除
+     */
+    static ThreadStats & get_thread_stats();
+
+    /**
+     * @brief 将另一份统计的计数加到当前统计上
+     */
+    void merge(const ThreadStats & _Other) noexcept;
+};
+
+/**
+ * @brief 线程统计登记表
+ * @details 记录所有存活线程的统计，以及已退出线程合并后的统计
+ */
+class StatsRegistry
+{
+private:
+    ThreadStats _Head;                      // 虚拟头节点
+    ThreadStats _Retired;                   // 已退出线程的统计
+    std::mutex _Mutex;                      // 登记表锁
+
+private:
+    StatsRegistry();
+
+    StatsRegistry(const StatsRegistry &) = delete;
+
+    StatsRegistry & operator=(const StatsRegistry &) = delete;
+
+public:
+    ~StatsRegistry() = default;
+
+public:
+    /**
+     * @brief 获取登记表单例
+     */
+    static StatsRegistry & get_stats_registry();
+
+    /**
+     * @brief 登记线程统计
+     */
+    void add(ThreadStats * _Stats) noexcept;
+
+    /**
+     * @brief 删除线程统计，计数合并到已退出线程的统计中
+     */
+    void remove(ThreadStats * _Stats) noexcept;
+
+    /**
+     * @brief 合并所有线程的统计
+     * @param _Total 合并结果，计数累加到其中
+     */
+    void collect(ThreadStats & _Total) noexcept;
+
+    /**
+     * @brief 给登记表加锁
+     * @details 用于`fork`前保持登记表状态一致
+     */
+    void lock() noexcept;
+
+    /**
+     * @brief 给登记表解锁
+     */
+    void unlock() noexcept;
+};
+
+/**
+ * @brief 获取内存池的统计信息
+ * @details 合并所有线程的计数，并依次读取各层缓存，各层之间不保证是同一时刻的快照
+ */
+MemoryStats get_stats();
+
+/**
+ * @brief 将统计信息格式化为便于阅读的文本
+ */
+std::string format_stats(const MemoryStats & _Stats);
+
+/**
+ * @brief 将统计信息输出到标准错误，类似`malloc_stats`
+ */
+void print_stats();
+
+} // namespace WW
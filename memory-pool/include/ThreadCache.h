@@ -1,10 +1,25 @@
 #pragma once
 
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+
 #include <CentralCache.h>
+#include <Stats.h>
 
 namespace WW
 {
 
+/**
+ * @brief 线程缓存的钩子
+ * @details 按位保存在每个线程缓存中，申请和释放时只检查一次，没有打开的钩子时不访问其他单例
+ */
+enum class ThreadCacheHook : unsigned
+{
+    TRACE = 1,          // 记录分配轨迹
+    PROFILE = 2,        // 释放时删除堆采样
+};
+
 /**
  * @brief 线程缓存
  */
@@ -12,6 +27,18 @@ class ThreadCache
 {
 private:
     std::array<FreeList, MAX_ARRAY_SIZE> _Free_lists;       // 自由表数组
+    std::array<size_type, MAX_ARRAY_SIZE> _Overages;        // 每个自由表连续超长的次数
+    size_type _Cached_size;                                 // 自由表中的内存
+    std::atomic<size_type> _Max_cached_size;                // 自由表中最多保存的内存，其他线程可以减小
+    size_type _Remote_id;                                   // 占用的远程释放队列编号，0表示没有
+    size_type _Node;                                        // 创建时所在的NUMA节点
+    size_type _Bytes_until_sample;                          // 距离下一次堆采样的申请字节数
+    std::atomic<unsigned> _Hooks;                           // 打开的钩子，由登记表修改
+    ThreadStats & _Stats;                                   // 当前线程的统计
+    ThreadCache * _Prev;                                    // 登记表中的上一个线程缓存
+    ThreadCache * _Next;                                    // 登记表中的下一个线程缓存
+
+    friend class ThreadCacheRegistry;
 
 private:
     ThreadCache();
@@ -40,21 +67,151 @@ public:
      * @brief 回收内存
      * @param _Ptr 内存指针
      * @param _Size 内存大小
+     * @details 直接根据大小计算索引，不需要查找页段，调试模式下会检查大小是否与页段一致
      */
     void deallocate(void * _Ptr, size_type _Size) noexcept;
 
+    /**
+     * @brief 回收内存
+     * @param _Ptr 内存指针
+     * @details 通过页段记录的内存块大小找到索引，不需要调用者提供大小
+     */
+    void deallocate(void * _Ptr) noexcept;
+
+    /**
+     * @brief 申请对齐的内存
+     * @param _Size 内存大小
+     * @param _Alignment 对齐大小，必须是2的幂
+     * @return 成功返回`void *`，失败或对齐大小无效时返回`nullptr`
+     * @details 不超过页大小的对齐使用大小是对齐倍数的内存块，页段按页对齐，切分出的内存块自然对齐；
+     * 超过页大小的对齐使用首页对齐的大内存页段，至少占用大内存的最小页数
+     */
+    void * allocate_aligned(size_type _Size, size_type _Alignment) noexcept;
+
+    /**
+     * @brief 回收对齐的内存
+     * @param _Ptr 内存指针
+     * @param _Size 申请时的内存大小
+     * @param _Alignment 申请时的对齐大小
+     * @details 也可以直接调用`deallocate(void *)`
+     */
+    void deallocate_aligned(void * _Ptr, size_type _Size, size_type _Alignment) noexcept;
+
+    /**
+     * @brief 调整内存大小
+     * @param _Ptr 内存指针，为`nullptr`时等同于`allocate`
+     * @param _Old_size 原来的内存大小
+     * @param _New_size 新的内存大小，为0时释放内存并返回`nullptr`
+     * @return 成功返回`void *`，失败返回`nullptr`，此时原来的内存不变
+     * @details 新大小对应的内存块大小不变时返回原指针；大内存优先原地扩展到后面的空闲页，
+     * 或者把多出的页还给页缓存；否则重新申请并复制原来的内容
+     */
+    void * reallocate(void * _Ptr, size_type _Old_size, size_type _New_size) noexcept;
+
+    /**
+     * @brief 获取内存实际可用的大小
+     * @param _Ptr 内存指针
+     * @return 所在内存块或大内存页段的大小，不小于申请的大小
+     */
+    size_type usable_size(void * _Ptr) const noexcept;
+
+    /**
+     * @brief 获取自由表中的内存
+     */
+    size_type cached_size() const noexcept;
+
+    /**
+     * @brief 获取自由表中最多保存的内存
+     */
+    size_type max_cached_size() const noexcept;
+
 private:
+    /**
+     * @brief 申请内存，不记录分配轨迹
+     * @param _Size 内存大小
+     * @return 成功返回`void *`，失败返回`nullptr`
+     */
+    void * _Allocate(size_type _Size) noexcept;
+
+    /**
+     * @brief 倒计时结束时采样这次申请
+     * @param _Ptr 申请得到的内存，为`nullptr`时只重新计时
+     * @param _Size 申请的大小
+     */
+    void _Sample(void * _Ptr, size_type _Size) noexcept;
+
+    /**
+     * @brief 钩子是否打开
+     * @details 只读取当前线程缓存中的标志，不访问对应的单例
+     */
+    bool _Hook_enabled(ThreadCacheHook _Hook) const noexcept;
+
+    /**
+     * @brief 申请超出管理范围的大内存
+     * @param _Size 内存大小
+     * @return 成功返回`void *`，失败返回`nullptr`
+     * @details 直接从页缓存获取整页的页段，页段记录的内存块大小为页段的总大小
+     */
+    void * _Allocate_large(size_type _Size) noexcept;
+
+    /**
+     * @brief 计算满足对齐要求的内存块大小
+     * @param _Size 内存大小
+     * @param _Alignment 对齐大小，2的幂
+     * @return 大小是对齐倍数的内存块大小，没有合适的内存块时返回0
+     */
+    static size_type _Aligned_class_size(size_type _Size, size_type _Alignment) noexcept;
+
+    /**
+     * @brief 释放大内存
+     * @param _Span 大内存所在的页段
+     */
+    void _Deallocate_large(Span * _Span) noexcept;
+
     /**
      * @brief 判断是否需要归还给中心缓存
      * @param _Index 索引
      */
     bool _Should_return(size_type _Index)  const noexcept;
 
+    /**
+     * @brief 从自己的远程释放队列取回内存块
+     * @param _Index 内存块所在的索引
+     * @return 取回内存块时返回`true`
+     */
+    bool _Fetch_from_remote_queue(size_type _Index) noexcept;
+
+    /**
+     * @brief 将内存块放入申请线程的远程释放队列
+     * @param _Ptr 内存块指针
+     * @param _Index 内存块所在的索引
+     * @param _Span 内存块所在的页段，为`nullptr`时查找
+     * @return 放入时返回`true`，属于当前线程、没有所属线程或者队列已关闭时返回`false`
+     */
+    bool _Push_to_remote_queue(void * _Ptr, size_type _Index, Span * _Span) noexcept;
+
+    /**
+     * @brief 自由表中的内存超过上限时归还一部分
+     * @details 每个自由表归还一半，然后向登记表申请扩大上限
+     */
+    void _Scavenge() noexcept;
+
     /**
      * @brief 从中心缓存获取一批内存块
+     * @param _Index 内存块所在的索引
      * @param _Size 申请的内存块大小
+     * @return 获取的内存块数量，系统内存不足时为0
+     * @details 每次获取后自由表最大长度翻倍，直到每批数量的`MAX_LIST_BATCH_NUM`倍
      */
-    void _Fetch_from_central_cache(size_type _Size) noexcept;
+    size_type _Fetch_from_central_cache(size_type _Index, size_type _Size) noexcept;
+
+    /**
+     * @brief 处理超过最大长度的自由表
+     * @param _Index 自由表所在的索引
+     * @details 归还一批内存块，最大长度不足一批时加一，
+     * 超过一批并且连续超长`MAX_LIST_OVERAGES`次以上时缩短一批
+     */
+    void _List_too_long(size_type _Index) noexcept;
 
     /**
      * @brief 将一批内存块还给中心缓存
@@ -63,5 +220,92 @@ private:
      */
     void _Return_to_central_cache(size_type _Index, size_type _Nums) noexcept;
 };
-    
+
+/**
+ * @brief 线程缓存登记表
+ * @details 记录所有线程缓存，在它们之间分配线程缓存的内存总量，
+ * 未分配的内存用完后，线程从其他线程的上限中获取
+ */
+class ThreadCacheRegistry
+{
+private:
+    ThreadCache * _Head;                    // 第一个线程缓存
+    ThreadCache * _Next_steal;              // 下一个被获取上限的线程缓存
+    size_type _Max_size;                    // 所有线程缓存最多保存的内存
+    std::ptrdiff_t _Unclaimed_size;         // 还没有分配给线程缓存的内存，可能为负数
+    unsigned _Hooks;                        // 所有线程缓存打开的钩子
+    std::mutex _Mutex;                      // 登记表锁
+
+private:
+    ThreadCacheRegistry();
+
+    ThreadCacheRegistry(const ThreadCacheRegistry &) = delete;
+
+    ThreadCacheRegistry & operator=(const ThreadCacheRegistry &) = delete;
+
+public:
+    ~ThreadCacheRegistry() = default;
+
+public:
+    /**
+     * @brief 获取登记表单例
+     */
+    static ThreadCacheRegistry & get_thread_cache_registry();
+
+    /**
+     * @brief 登记线程缓存，分配`MIN_THREAD_CACHE_SIZE`的上限
+     */
+    void add(ThreadCache * _Cache) noexcept;
+
+    /**
+     * @brief 删除线程缓存，收回它的上限
+     */
+    void remove(ThreadCache * _Cache) noexcept;
+
+    /**
+     * @brief 扩大线程缓存的上限
+     * @param _Cache 需要扩大的线程缓存
+     * @details 优先使用未分配的内存，否则轮流从其他线程的上限中获取`THREAD_CACHE_STEAL_SIZE`，
+     * 被获取的线程在下次释放内存时发现超过上限，自行归还
+     */
+    void steal(ThreadCache * _Cache) noexcept;
+
+    /**
+     * @brief 获取所有线程缓存最多保存的内存
+     */
+    size_type max_size() noexcept;
+
+    /**
+     * @brief 设置所有线程缓存最多保存的内存
+     * @param _Size 内存总量
+     * @details 已分配的上限按比例缩放，每个线程至少保留`MIN_THREAD_CACHE_SIZE`
+     */
+    void set_max_size(size_type _Size) noexcept;
+
+    /**
+     * @brief 获取还没有分配给线程缓存的内存
+     * @return 已分配的上限超出总量时返回0
+     */
+    size_type unclaimed_size() noexcept;
+
+    /**
+     * @brief 打开或关闭所有线程缓存的钩子
+     * @param _Hook 钩子
+     * @param _Enabled 是否打开
+     * @details 之后创建的线程缓存同样使用新的设置
+     */
+    void set_hook(ThreadCacheHook _Hook, bool _Enabled) noexcept;
+
+    /**
+     * @brief 给登记表加锁
+     * @details 用于`fork`前保持登记表状态一致
+     */
+    void lock() noexcept;
+
+    /**
+     * @brief 给登记表解锁
+     */
+    void unlock() noexcept;
+};
+
 } // namespace WW
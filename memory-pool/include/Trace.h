@@ -0,0 +1,147 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+#include <Common.h>
+
+namespace WW
+{
+
+/**
+ * @brief 分配轨迹事件类型
+ */
+enum class TraceEventType : std::uint16_t
+{
+    ALLOCATE = 0,       // 申请
+    DEALLOCATE = 1,     // 释放
+    TIME = 2,           // 时间间隔超过32位时单独记录，间隔保存在`size`中
+};
+
+/**
+ * @brief 分配轨迹事件
+ * @details 固定24字节，时间为距同一线程上一个事件的纳秒数，线程的第一个事件距开始记录的时间
+ */
+class TraceEvent
+{
+public:
+    std::uint64_t object;       // 内存块编号，即申请得到的指针
+    std::uint64_t size;         // 内存大小，不带大小释放时为0
+    std::uint32_t delta;        // 时间间隔
+    std::uint16_t thread;       // 线程编号
+    std::uint16_t type;         // 事件类型，`TraceEventType`
+};
+
+static_assert(sizeof(TraceEvent) == 24, "trace event must be 24 bytes");
+
+class TraceBuffer;
+
+/**
+ * @brief 分配轨迹记录
+ * @details 记录线程缓存的每次申请和释放，每个线程先写入自己的缓冲区，满时整体写入文件，
+ * 不经过`malloc`。开始和停止时打开或关闭每个线程缓存的钩子，没有记录时申请和释放只检查线程缓存中的标志。
+ * 默认关闭，可以通过环境变量`WW_TRACE=文件`或者`start`开始记录，只支持`Linux`
+ */
+class Trace
+{
+private:
+    std::atomic<bool> _Enabled;                 // 是否正在记录
+    std::atomic<size_type> _Epoch;              // 第几次记录，缓冲区据此判断是否需要重置
+    std::atomic<std::uint16_t> _Thread_count;   // 已分配的线程编号
+    std::uint64_t _Start;                       // 开始记录的时间
+    int _Fd;                                    // 轨迹文件
+    TraceBuffer * _Buffers;                     // 所有线程的缓冲区
+    std::mutex _Mutex;                          // 文件和缓冲区链表锁
+
+private:
+    Trace();
+
+    Trace(const Trace &) = delete;
+
+    Trace & operator=(const Trace &) = delete;
+
+public:
+    ~Trace() = default;
+
+public:
+    /**
+     * @brief 获取分配轨迹单例
+     */
+    static Trace & get_trace();
+
+    /**
+     * @brief 是否正在记录
+     */
+    bool enabled() const noexcept;
+
+    /**
+     * @brief 开始记录到文件
+     * @param _Path 文件路径，已存在时覆盖
+     * @return 成功返回`true`，正在记录、无法打开文件或者不支持时返回`false`
+     */
+    bool start(const char * _Path) noexcept;
+
+    /**
+     * @brief 停止记录
+     * @details 写入所有线程缓冲区中的事件并关闭文件，正在记录的其他线程可能丢失最后几个事件
+     */
+    void stop() noexcept;
+
+    /**
+     * @brief 记录一次申请
+     * @param _Ptr 申请得到的内存
+     * @param _Size 申请的大小
+     */
+    void record_allocate(void * _Ptr, size_type _Size) noexcept;
+
+    /**
+     * @brief 记录一次释放
+     * @param _Ptr 释放的内存
+     * @param _Size 释放的大小，不带大小释放时为0
+     * @details 在释放之前记录，保证其他线程之后得到同一地址时时间更晚
+     */
+    void record_deallocate(void * _Ptr, size_type _Size) noexcept;
+
+    /**
+     * @brief 读取轨迹文件
+     * @param _Path 文件路径
+     * @param _Events 按文件中的顺序保存事件，同一线程的事件保持先后顺序
+     * @return 成功返回`true`，文件无法读取或格式错误时返回`false`
+     */
+    static bool load(const char * _Path, std::vector<TraceEvent> & _Events);
+
+    /**
+     * @brief 给文件和缓冲区链表加锁
+     * @details 用于`fork`前保持状态一致
+     */
+    void lock() noexcept;
+
+    /**
+     * @brief 给文件和缓冲区链表解锁
+     */
+    void unlock() noexcept;
+
+private:
+    /**
+     * @brief 在当前线程的缓冲区中添加事件
+     */
+    void _Record(TraceEventType _Type, void * _Ptr, size_type _Size) noexcept;
+
+    /**
+     * @brief 获取当前线程的缓冲区
+     * @return 线程正在退出或者内存不足时返回`nullptr`
+     */
+    TraceBuffer * _Thread_buffer() noexcept;
+
+    /**
+     * @brief 将缓冲区中尚未写入的事件写入文件
+     * @param _Buffer 缓冲区，调用者持有缓冲区锁
+     */
+    void _Flush(TraceBuffer * _Buffer) noexcept;
+
+    friend class TraceThreadGuard;
+};
+
+} // namespace WW
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+
+#include <FreeList.h>
+
+namespace WW
+{
+
+/**
+ * @brief 传输缓存
+ * @details 保存线程缓存归还的整批内存块，其他线程申请时直接整批取走，
+ * 不需要打散回页段，也不需要查找页段
+ */
+class TransferCache
+{
+private:
+    /**
+     * @brief 一批内存块
+     */
+    class Batch
+    {
+    public:
+        FreeObject * begin;     // 首个内存块
+        FreeObject * end;       // 最后一个内存块
+        size_type count;        // 内存块数量
+    };
+
+private:
+    std::array<Batch, MAX_TRANSFER_NUM> _Batches;           // 批数组，按栈使用
+    size_type _Size;                                        // 批数
+    size_type _Object_count;                                // 内存块总数
+    size_type _Max_object_count;                            // 最多保存的内存块数
+    std::mutex _Mutex;                                      // 传输缓存锁
+
+public:
+    TransferCache();
+
+    TransferCache(const TransferCache &) = delete;
+
+    TransferCache & operator=(const TransferCache &) = delete;
+
+    ~TransferCache() = default;
+
+public:
+    /**
+     * @brief 设置最多保存的内存块数
+     */
+    void set_max_object_count(size_type _Max_object_count) noexcept;
+
+    /**
+     * @brief 放入一批内存块
+     * @param _Begin 首个内存块
+     * @param _End 最后一个内存块
+     * @param _Count 内存块数量
+     * @return 成功时返回`true`，已满时返回`false`
+     */
+    bool insert(FreeObject * _Begin, FreeObject * _End, size_type _Count) noexcept;
+
+    /**
+     * @brief 取出一批内存块
+     * @param _Count 最多取出的数量
+     * @param _Begin 取出的首个内存块
+     * @param _End 取出的最后一个内存块
+     * @return 实际取出的数量，为空时返回0
+     * @details 批中内存块多于`_Count`时，剩余部分留在传输缓存中
+     */
+    size_type remove(size_type _Count, FreeObject *& _Begin, FreeObject *& _End) noexcept;
+
+    /**
+     * @brief 取出所有内存块
+     * @param _Begin 取出的首个内存块
+     * @param _End 取出的最后一个内存块
+     * @return 取出的数量，为空时返回0
+     * @details 所有批首尾相接为一个链表
+     */
+    size_type remove_all(FreeObject *& _Begin, FreeObject *& _End) noexcept;
+
+    /**
+     * @brief 获取保存的内存块总数
+     */
+    size_type object_count() noexcept;
+
+    /**
+     * @brief 给传输缓存加锁
+     */
+    void lock() noexcept;
+
+    /**
+     * @brief 给传输缓存解锁
+     */
+    void unlock() noexcept;
+};
+
+} // namespace WW
@@ -1,26 +1,86 @@
 #include "CentralCache.h"
 
+#include <new>
 #include <algorithm>
 
 #include <Size.h>
+#include <Stats.h>
+#include <Latency.h>
 
 namespace WW
 {
 
-CentralCache::CentralCache()
+CentralCache::CentralCache(size_type _Node)
     : _Spans()
+    , _Partial_spans()
+    , _Empty_spans()
+    , _Empty_pages(0)
+    , _Transfer_caches()
+    , _Mutex()
+    , _Node(_Node)
 {
+    // 按照内存大小限制每个传输缓存保存的内存块数
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        _Transfer_caches[_I].set_max_object_count(MAX_TRANSFER_SIZE / Size::index_to_size(_I));
+    }
 }
 
 CentralCache & CentralCache::get_central_cache()
 {
-    static CentralCache _CentralCache;
+#ifdef WW_MALLOC_OVERRIDE
+    WW_NEVER_DESTROYED(CentralCache, _CentralCache, (0));
+    return *_CentralCache;
+#else
+    static CentralCache _CentralCache(0);
     return _CentralCache;
+#endif
+}
+
+CentralCache & CentralCache::get_central_cache(size_type _Node)
+{
+    _Node %= MAX_NUMA_NODE_NUM;
+    if (_Node == 0) {
+        return get_central_cache();
+    }
+
+    // 其他节点按需创建，不会析构
+    alignas(CentralCache) static unsigned char _Storage[MAX_NUMA_NODE_NUM][sizeof(CentralCache)];
+    static std::atomic<CentralCache *> _Instances[MAX_NUMA_NODE_NUM];
+    static std::mutex _Instances_mutex;
+
+    CentralCache * _Instance = _Instances[_Node].load(std::memory_order_acquire);
+    if (_Instance == nullptr) {
+        std::lock_guard<std::mutex> _Lock(_Instances_mutex);
+        _Instance = _Instances[_Node].load(std::memory_order_relaxed);
+        if (_Instance == nullptr) {
+            _Instance = new(_Storage[_Node]) CentralCache(_Node);
+            _Instances[_Node].store(_Instance, std::memory_order_release);
+        }
+    }
+
+    return *_Instance;
 }
 
 FreeObject * CentralCache::fetch_range(size_type _Size, size_type _Count)
 {
+    FreeObject * _Begin = nullptr;
+    FreeObject * _End = nullptr;
+    fetch_range(_Size, _Count, _Begin, _End);
+    return _Begin;
+}
+
+size_type CentralCache::fetch_range(size_type _Size, size_type _Count, FreeObject *& _Begin, FreeObject *& _End, size_type _Owner)
+{
+    LatencyTimer _Timer(LatencyTier::FETCH_RANGE);
     size_type _Index = Size::size_to_index(_Size);
+    ThreadStats::get_thread_stats().fetch_count[_Index].add(1);
+
+    // 优先从传输缓存中整批获取，不需要锁住页段链表
+    size_type _Transferred = _Transfer_caches[_Index].remove(_Count, _Begin, _End);
+    if (_Transferred != 0) {
+        // 整批内存块可能来自多个页段，不逐个记录所属线程
+        return _Transferred;
+    }
 
     // 锁住index对应链表
     _Spans[_Index].lock();
@@ -29,34 +89,123 @@ FreeObject * CentralCache::fetch_range(size_type _Size, size_type _Count)
     Span * _Span = _Get_free_span(_Size);
     if (_Span == nullptr) {
         _Spans[_Index].unlock();
-        
-        return nullptr;
+
+        _Begin = nullptr;
+        _End = nullptr;
+        return 0;
     }
 
-    FreeObject * _Head = nullptr;
-    for (size_type _I = 0; _I < _Count; ++_I) {
-        // 取出一个内存块，并且插入到新链表的头部
-        FreeObject * _New_object = _Span->get_free_list()->front();
-        _Span->get_free_list()->pop_front();
-        _New_object->set_next(_Head);
-        _Head = _New_object;
-        _Span->set_used(_Span->used() + 1);
+    // 从页段中整段取出内存块，不足时有多少取多少
+    size_type _Old_used = _Span->used();
+    size_type _Old_free = _Span->get_free_list()->size();
+    size_type _Fetched = _Span->get_free_list()->pop_range(_Count, _Begin, _End);
+    _Span->set_used(_Old_used + _Fetched);
+    _Move_span(_Index, _Span, _Old_used, _Old_free);
+    _Span->set_owner(_Owner);
 
-        if (_Span->get_free_list()->empty()) {
-            // 已经空了，直接返回这么多内存块
-            break;
-        }
+    _Spans[_Index].unlock();
+
+    return _Fetched;
+}
+
+void CentralCache::return_range(size_type _Size, FreeObject * _Free_object)
+{
+    LatencyTimer _Timer(LatencyTier::RETURN_RANGE);
+    size_type _Index = Size::size_to_index(_Size);
+    ThreadStats::get_thread_stats().return_count[_Index].add(1);
+
+    _Return_to_spans(_Index, _Free_object);
+}
+
+void CentralCache::return_range(size_type _Size, FreeObject * _Begin, FreeObject * _End, size_type _Count)
+{
+    LatencyTimer _Timer(LatencyTier::RETURN_RANGE);
+    size_type _Index = Size::size_to_index(_Size);
+    ThreadStats::get_thread_stats().return_count[_Index].add(1);
+
+    // 整批放入传输缓存，其他线程可以直接取走
+    if (_Transfer_caches[_Index].insert(_Begin, _End, _Count)) {
+        return;
     }
 
-    _Spans[_Index].unlock();
+    // 传输缓存已满，归还到页段中
+    _Return_to_spans(_Index, _Begin);
+}
 
-    return _Head;
+void CentralCache::collect_stats(MemoryStats & _Stats)
+{
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        SizeClassStats & _Class = _Stats.size_classes[_I];
+        size_type _Size = Size::index_to_size(_I);
+
+        size_type _Transferred = _Transfer_caches[_I].object_count();
+        _Class.transfer_cached += _Transferred;
+        _Stats.transfer_cache_bytes += _Transferred * _Size;
+
+        size_type _Central_cached = 0;
+        auto _Collect = [&](SpanList & _List) {
+            for (Span & _Span : _List) {
+                size_type _Span_size = _Span.page_count() << PAGE_SHIFT;
+                _Class.spans += 1;
+                _Class.pages += _Span.page_count();
+                _Central_cached += _Span.get_free_list()->size();
+                _Class.in_use += _Span.used();
+                // 页段末尾不足一个内存块的部分
+                _Stats.fragmented_bytes += _Span_size % _Size;
+            }
+        };
+
+        _Spans[_I].lock();
+        _Collect(_Spans[_I]);
+        for (SpanList & _Partial : _Partial_spans[_I]) {
+            _Collect(_Partial);
+        }
+        _Collect(_Empty_spans[_I]);
+        _Spans[_I].unlock();
+
+        _Class.central_cached += _Central_cached;
+        _Stats.central_cache_bytes += _Central_cached * _Size;
+    }
+}
+
+void CentralCache::flush_transfer_caches()
+{
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        FreeObject * _Begin = nullptr;
+        FreeObject * _End = nullptr;
+        if (_Transfer_caches[_I].remove_all(_Begin, _End) != 0) {
+            _Return_to_spans(_I, _Begin);
+        }
+    }
 }
 
-void CentralCache::return_range(size_type size, FreeObject * _Free_object)
+void CentralCache::release_empty_spans()
 {
-    size_type _Index = Size::size_to_index(size);
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        // 先整体取出，不在持有页段链表锁时访问页缓存
+        _Spans[_I].lock();
+        Span * _List = nullptr;
+        while (!_Empty_spans[_I].empty()) {
+            Span & _Span = _Empty_spans[_I].front();
+            _Empty_spans[_I].pop_front();
+            _Empty_pages.fetch_sub(_Span.page_count(), std::memory_order_relaxed);
+            _Span.get_free_list()->clear();
+            _Span.set_object_size(0);
+            _Span.set_next(_List);
+            _List = &_Span;
+        }
+        _Spans[_I].unlock();
+
+        while (_List != nullptr) {
+            Span * _Next = _List->next();
+            PageCache::get_page_cache(_Node).return_span(_List);
+            _List = _Next;
+        }
+    }
+}
 
+void CentralCache::_Return_to_spans(size_type _Index, FreeObject * _Free_object)
+{
     // 锁住index对应链表
     _Spans[_Index].lock();
 
@@ -64,12 +213,9 @@ void CentralCache::return_range(size_type size, FreeObject * _Free_object)
     while (_Free_object != nullptr) {
         FreeObject * _Next = _Free_object->next();
 
-        // 查找该内存块属于哪个页段
+        // 查找该内存块属于哪个页段，页号映射无锁，不需要先解锁
         void * _Ptr = reinterpret_cast<void *>(_Free_object);
-
-        _Spans[_Index].unlock();
         Span * _Span = PageCache::get_page_cache().object_to_span(_Ptr);
-        _Spans[_Index].lock();
 
         // 没找到则跳过，这种情况不应该出现
         if (_Span == nullptr) {
@@ -77,19 +223,37 @@ void CentralCache::return_range(size_type size, FreeObject * _Free_object)
             continue;
         }
 
+        if (_Span->node() != _Node) {
+            // 属于其他节点，单独转交
+            _Spans[_Index].unlock();
+            _Free_object->set_next(nullptr);
+            get_central_cache(_Span->node())._Return_to_spans(_Index, _Free_object);
+            _Spans[_Index].lock();
+
+            _Free_object = _Next;
+            continue;
+        }
+
         // 将内存块加入到该页段的空闲链表中
+        size_type _Old_used = _Span->used();
+        size_type _Old_free = _Span->get_free_list()->size();
         _Span->get_free_list()->push_front(_Free_object);
         // 同步页段使用数量
-        _Span->set_used(_Span->used() - 1);
+        _Span->set_used(_Old_used - 1);
 
-        if (_Span->used() == 0) {
+        if (_Span->used() != 0 ||
+            _Empty_pages.load(std::memory_order_relaxed) + _Span->page_count() <= MAX_CENTRAL_EMPTY_PAGES) {
+            // 移动到对应的链表，完全空闲的页段在上限内留在中心缓存
+            _Move_span(_Index, _Span, _Old_used, _Old_free);
+        } else {
             // 已经使用完毕，可以从链表中删除
-            _Spans[_Index].erase(_Span);
+            _Span_list(_Index, _Old_used, _Old_free).erase(_Span);
             _Span->get_free_list()->clear();
+            _Span->set_object_size(0);
 
             // 归还页缓存
             _Spans[_Index].unlock();
-            PageCache::get_page_cache().return_span(_Span);
+            PageCache::get_page_cache(_Node).return_span(_Span);
             _Spans[_Index].lock();
         }
 
@@ -100,17 +264,43 @@ void CentralCache::return_range(size_type size, FreeObject * _Free_object)
     _Spans[_Index].unlock();
 }
 
+void CentralCache::lock() noexcept
+{
+    for (SpanList & _Span_list : _Spans) {
+        _Span_list.lock();
+    }
+
+    for (TransferCache & _Transfer_cache : _Transfer_caches) {
+        _Transfer_cache.lock();
+    }
+}
+
+void CentralCache::unlock() noexcept
+{
+    for (TransferCache & _Transfer_cache : _Transfer_caches) {
+        _Transfer_cache.unlock();
+    }
+
+    for (SpanList & _Span_list : _Spans) {
+        _Span_list.unlock();
+    }
+}
+
 Span * CentralCache::_Get_free_span(size_type _Size)
 {
     size_type _Index = Size::size_to_index(_Size);
 
-    for (auto _It = _Spans[_Index].begin(); _It != _Spans[_Index].end(); ++_It) {
-        // 遍历链表，查看是否有已经切过的页
-        if (!_It->get_free_list()->empty()) {
-            return &*_It;
+    // 优先使用空闲最少的部分使用页段，让内存块集中在少数页段中
+    for (SpanList & _Partial : _Partial_spans[_Index]) {
+        if (!_Partial.empty()) {
+            return &_Partial.front();
         }
     }
 
+    if (!_Empty_spans[_Index].empty()) {
+        return &_Empty_spans[_Index].front();
+    }
+
     _Spans[_Index].unlock();
 
     // 没找到空闲的页段，需要向页缓存申请
@@ -130,7 +320,7 @@ Span * CentralCache::_Get_free_span(size_type _Size)
     }
 
     // 申请页段
-    Span * _Span = PageCache::get_page_cache().fetch_span(_Page_count);
+    Span * _Span = PageCache::get_page_cache(_Node).fetch_span(_Page_count);
     if (_Span == nullptr) {
         return nullptr;
     }
@@ -139,22 +329,67 @@ Span * CentralCache::_Get_free_span(size_type _Size)
     // 计算出内存的起始地址
     void * _Ptr = Span::id_to_ptr(_Span->page_id());
 
-    // 计算每个内存块的大小并将其挂到 freelist 上
+    // 记录内存块大小，释放时可以通过页段找到大小
+    _Span->set_object_size(_Size);
+
+    // 按地址顺序把内存块串成链表，整段挂到 freelist 上
     size_type _Block_num = _Span->page_count() * PAGE_SIZE / _Size;
-    for (size_type _I = 0; _I < _Block_num; ++_I) {
+    FreeObject * _Begin = reinterpret_cast<FreeObject *>(_Ptr);
+    FreeObject * _End = _Begin;
+    for (size_type _I = 1; _I < _Block_num; ++_I) {
         // 偏移每次一个内存块的大小
-        void * _Block_ptr = static_cast<char *>(_Ptr) + _I * _Size;
-        // 创建 FreeObject 来管理内存块
-        FreeObject * _Free_obj = reinterpret_cast<FreeObject *>(_Block_ptr);
-        // 将此内存块挂到 freelist 上
-        _Span->get_free_list()->push_front(_Free_obj);
+        FreeObject * _Free_obj = reinterpret_cast<FreeObject *>(static_cast<char *>(_Ptr) + _I * _Size);
+        _End->set_next(_Free_obj);
+        _End = _Free_obj;
     }
+    _End->set_next(nullptr);
+    _Span->get_free_list()->push_range(_Begin, _End, _Block_num);
 
-    // 将页段挂到链表上
+    // 将页段挂到完全空闲的链表上
     _Spans[_Index].lock();
-    _Spans[_Index].push_front(_Span);
+    _Empty_spans[_Index].push_front(_Span);
+    _Empty_pages.fetch_add(_Span->page_count(), std::memory_order_relaxed);
 
     return _Span;
 }
 
+SpanList & CentralCache::_Span_list(size_type _Index, size_type _Used, size_type _Free) noexcept
+{
+    if (_Free == 0) {
+        return _Spans[_Index];
+    }
+
+    if (_Used == 0) {
+        return _Empty_spans[_Index];
+    }
+
+    // 空闲内存块数的2的幂作为分组
+    size_type _Group = 0;
+    while (_Free > 1 && _Group + 1 < CENTRAL_PARTIAL_LIST_NUM) {
+        _Free >>= 1;
+        ++_Group;
+    }
+    return _Partial_spans[_Index][_Group];
+}
+
+void CentralCache::_Move_span(size_type _Index, Span * _Span, size_type _Old_used, size_type _Old_free) noexcept
+{
+    SpanList & _From = _Span_list(_Index, _Old_used, _Old_free);
+    SpanList & _To = _Span_list(_Index, _Span->used(), _Span->get_free_list()->size());
+    if (&_From == &_To) {
+        // 没有跨过分组边界
+        return;
+    }
+
+    _From.erase(_Span);
+    _To.push_front(_Span);
+
+    if (&_From == &_Empty_spans[_Index]) {
+        _Empty_pages.fetch_sub(_Span->page_count(), std::memory_order_relaxed);
+    }
+    if (&_To == &_Empty_spans[_Index]) {
+        _Empty_pages.fetch_add(_Span->page_count(), std::memory_order_relaxed);
+    }
+}
+
 } // namespace WW
@@ -0,0 +1,531 @@
+#include "CpuCache.h"
+
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <CentralCache.h>
+#include <Platform.h>
+#include <Size.h>
+#include <Stats.h>
+#include <Numa.h>
+
+#if defined(__linux__) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define WW_RSEQ_SUPPORTED 1
+#include <unistd.h>
+
+/**
+ * glibc 2.35之后为每个线程注册rseq，并导出rseq区域相对线程指针的偏移，
+ * 使用弱符号，旧版本glibc中地址为空
+ */
+extern "C"
+{
+extern const std::ptrdiff_t __rseq_offset __attribute__((weak));
+extern const unsigned int __rseq_size __attribute__((weak));
+}
+#endif
+
+namespace WW
+{
+
+namespace
+{
+
+/**
+ * @brief 操作结果
+ */
+enum class RseqResult
+{
+    Success,        // 成功
+    Failed,         // 缓存已满或者为空
+    Aborted         // 被抢占或者迁移到其他CPU，需要重试
+};
+
+#if defined(WW_RSEQ_SUPPORTED)
+
+#define WW_RSEQ_STRING_IMPL(x) #x
+#define WW_RSEQ_STRING(x) WW_RSEQ_STRING_IMPL(x)
+
+/**
+ * @brief glibc在x86-64上注册rseq时使用的签名，中断处理入口前必须是这个值
+ */
+#define WW_RSEQ_SIGNATURE 0x53053053
+
+/**
+ * 定义临界区描述符，标签1为起始地址，标签2为提交之后的地址，标签4为中断处理入口
+ * 然后将描述符地址写入rseq区域，进入临界区
+ */
+#define WW_RSEQ_BEGIN                                                   \
+    ".pushsection __rseq_cs, \"aw\"\n\t"                                \
+    ".balign 32\n\t"                                                    \
+    "3:\n\t"                                                            \
+    ".long 0x0, 0x0\n\t"                                                \
+    ".quad 1f, (2f - 1f), 4f\n\t"                                       \
+    ".popsection\n\t"                                                   \
+    "leaq 3b(%%rip), %%rax\n\t"                                         \
+    "movq %%rax, %[rseq_cs]\n\t"                                        \
+    "1:\n\t"                                                            \
+    "cmpl %[cpu], %[current_cpu]\n\t"                                   \
+    "jnz 4f\n\t"
+
+/**
+ * 结束临界区，定义带签名的中断处理入口
+ */
+#define WW_RSEQ_END                                                     \
+    "2:\n\t"                                                            \
+    ".pushsection __rseq_failure, \"ax\"\n\t"                           \
+    ".byte 0x0f, 0xb9, 0x3d\n\t"                                        \
+    ".long " WW_RSEQ_STRING(WW_RSEQ_SIGNATURE) "\n\t"                   \
+    "4:\n\t"                                                            \
+    "jmp %l[aborted]\n\t"                                               \
+    ".popsection\n\t"
+
+/**
+ * @brief 线程的rseq区域
+ * @details 与内核`struct rseq`的前几个字段布局一致
+ */
+class RseqArea
+{
+public:
+    std::uint32_t cpu_id_start;     // 临界区开始前读取的CPU号
+    std::uint32_t cpu_id;           // 当前CPU号，未注册时为负数
+    std::uint64_t rseq_cs;          // 当前临界区描述符
+};
+
+/**
+ * @brief 获取当前线程的rseq区域
+ */
+inline RseqArea * _Rseq_area() noexcept
+{
+    char * _Thread_pointer = nullptr;
+    __asm__ ("movq %%fs:0, %0" : "=r" (_Thread_pointer));
+    return reinterpret_cast<RseqArea *>(_Thread_pointer + __rseq_offset);
+}
+
+/**
+ * @brief 当前线程是否已经注册rseq
+ */
+inline bool _Rseq_registered(RseqArea * _Rseq) noexcept
+{
+    return static_cast<std::int32_t>(__atomic_load_n(&_Rseq->cpu_id, __ATOMIC_RELAXED)) >= 0;
+}
+
+/**
+ * @brief 在指定CPU上压入一个内存块
+ * @details 只有最后一条写入`count`的指令是提交操作，之前被中断不会产生任何影响
+ */
+RseqResult _Rseq_push(RseqArea * _Rseq, std::uint32_t _Cpu, CpuFreeList * _List, void * _Ptr) noexcept
+{
+    __asm__ __volatile__ goto (
+        WW_RSEQ_BEGIN
+        "movq %[count], %%rax\n\t"
+        "cmpq %[capacity], %%rax\n\t"
+        "jae %l[failed]\n\t"
+        "movq %[ptr], (%[slots], %%rax, 8)\n\t"
+        "addq $1, %%rax\n\t"
+        "movq %%rax, %[count]\n\t"
+        WW_RSEQ_END
+        :
+        : [cpu] "r" (_Cpu),
+          [current_cpu] "m" (_Rseq->cpu_id),
+          [rseq_cs] "m" (_Rseq->rseq_cs),
+          [count] "m" (_List->count),
+          [capacity] "m" (_List->capacity),
+          [slots] "r" (_List->slots),
+          [ptr] "r" (_Ptr)
+        : "memory", "cc", "rax"
+        : failed, aborted
+    );
+    return RseqResult::Success;
+failed:
+    return RseqResult::Failed;
+aborted:
+    return RseqResult::Aborted;
+}
+
+/**
+ * @brief 在指定CPU上弹出一个内存块
+ */
+RseqResult _Rseq_pop(RseqArea * _Rseq, std::uint32_t _Cpu, CpuFreeList * _List, void *& _Ptr) noexcept
+{
+    void * _Result = nullptr;
+
+    __asm__ __volatile__ goto (
+        WW_RSEQ_BEGIN
+        "movq %[count], %%rax\n\t"
+        "testq %%rax, %%rax\n\t"
+        "jz %l[failed]\n\t"
+        "subq $1, %%rax\n\t"
+        "movq (%[slots], %%rax, 8), %%rdx\n\t"
+        "movq %%rdx, %[result]\n\t"
+        "movq %%rax, %[count]\n\t"
+        WW_RSEQ_END
+        :
+        : [cpu] "r" (_Cpu),
+          [current_cpu] "m" (_Rseq->cpu_id),
+          [rseq_cs] "m" (_Rseq->rseq_cs),
+          [count] "m" (_List->count),
+          [slots] "r" (_List->slots),
+          [result] "m" (_Result)
+        : "memory", "cc", "rax", "rdx"
+        : failed, aborted
+    );
+    _Ptr = _Result;
+    return RseqResult::Success;
+failed:
+    return RseqResult::Failed;
+aborted:
+    return RseqResult::Aborted;
+}
+
+#endif
+
+/**
+ * @brief 每种大小在单个CPU上最多缓存的数量
+ */
+size_type _Cpu_capacity(size_type _Size) noexcept
+{
+    size_type _Capacity = MAX_CPU_CACHE_SIZE / _Size;
+    return _Capacity < MAX_CPU_CACHE_NUM ? _Capacity : MAX_CPU_CACHE_NUM;
+}
+
+} // namespace
+
+CpuCache::CpuCache()
+    : _Slabs(nullptr)
+    , _Cpu_count(0)
+    , _Available(false)
+    , _Enabled(false)
+{
+#if defined(WW_RSEQ_SUPPORTED)
+    // glibc没有导出rseq信息或者注册失败时不可用
+    if (&__rseq_offset == nullptr || &__rseq_size == nullptr || __rseq_size == 0) {
+        return;
+    }
+
+    if (!_Rseq_registered(_Rseq_area())) {
+        return;
+    }
+
+    long _Count = sysconf(_SC_NPROCESSORS_CONF);
+    if (_Count <= 0) {
+        return;
+    }
+
+    _Cpu_count = static_cast<size_type>(_Count);
+    void * _Ptr = Platform::aligned_malloc(alignof(std::atomic<CpuSlab *>), _Cpu_count * sizeof(std::atomic<CpuSlab *>));
+    if (_Ptr == nullptr) {
+        return;
+    }
+
+    _Slabs = static_cast<std::atomic<CpuSlab *> *>(_Ptr);
+    for (size_type _I = 0; _I < _Cpu_count; ++_I) {
+        new(&_Slabs[_I]) std::atomic<CpuSlab *>(nullptr);
+    }
+
+    _Available = true;
+
+    // 通过环境变量启用
+    const char * _Env = std::getenv("WW_PER_CPU_CACHE");
+    if (_Env != nullptr && std::strcmp(_Env, "1") == 0) {
+        _Enabled.store(true, std::memory_order_relaxed);
+    }
+#endif
+}
+
+CpuCache & CpuCache::get_cpu_cache()
+{
+#ifdef WW_MALLOC_OVERRIDE
+    WW_NEVER_DESTROYED(CpuCache, _Instance, ());
+    return *_Instance;
+#else
+    static CpuCache _Instance;
+    return _Instance;
+#endif
+}
+
+bool CpuCache::available() const noexcept
+{
+    return _Available;
+}
+
+bool CpuCache::enabled() const noexcept
+{
+    return _Enabled.load(std::memory_order_relaxed);
+}
+
+bool CpuCache::set_enabled(bool _Enabled) noexcept
+{
+    if (!_Available) {
+        return false;
+    }
+
+    this->_Enabled.store(_Enabled, std::memory_order_relaxed);
+    return _Enabled;
+}
+
+void * CpuCache::allocate(size_type _Index, size_type _Size) noexcept
+{
+#if defined(WW_RSEQ_SUPPORTED)
+    if (_Size > MAX_CPU_CACHE_SIZE) {
+        // 大内存块不经过CPU缓存，也不在线程缓存中保存，直接从中心缓存获取
+        return CentralCache::get_central_cache(Numa::get_numa().current_node()).fetch_range(_Size, 1);
+    }
+
+    RseqArea * _Rseq = _Rseq_area();
+    if (!_Rseq_registered(_Rseq)) {
+        return nullptr;
+    }
+
+    for (;;) {
+        std::uint32_t _Cpu = __atomic_load_n(&_Rseq->cpu_id_start, __ATOMIC_RELAXED);
+        CpuSlab * _Slab = _Get_slab(_Cpu);
+        if (_Slab == nullptr) {
+            return nullptr;
+        }
+
+        void * _Ptr = nullptr;
+        switch (_Rseq_pop(_Rseq, _Cpu, &_Slab->lists[_Index], _Ptr)) {
+        case RseqResult::Success:
+            return _Ptr;
+        case RseqResult::Failed:
+            // 当前CPU没有这种内存块，需要申请
+            return _Fetch_from_central_cache(_Index, _Size);
+        case RseqResult::Aborted:
+            // 被抢占或者迁移，重新读取CPU号
+            break;
+        }
+    }
+#else
+    (void)_Index;
+    (void)_Size;
+    return nullptr;
+#endif
+}
+
+bool CpuCache::deallocate(void * _Ptr, size_type _Index, size_type _Size) noexcept
+{
+#if defined(WW_RSEQ_SUPPORTED)
+    if (_Size > MAX_CPU_CACHE_SIZE) {
+        // 大内存块直接归还中心缓存
+        _Return_object(_Ptr, _Size);
+        return true;
+    }
+
+    RseqArea * _Rseq = _Rseq_area();
+    if (!_Rseq_registered(_Rseq)) {
+        return false;
+    }
+
+    bool _Returned = false;
+    for (;;) {
+        std::uint32_t _Cpu = __atomic_load_n(&_Rseq->cpu_id_start, __ATOMIC_RELAXED);
+        CpuSlab * _Slab = _Get_slab(_Cpu);
+        if (_Slab == nullptr) {
+            return false;
+        }
+
+        switch (_Rseq_push(_Rseq, _Cpu, &_Slab->lists[_Index], _Ptr)) {
+        case RseqResult::Success:
+            return true;
+        case RseqResult::Failed:
+            if (_Returned) {
+                // 归还之后其他线程又放满了，直接归还中心缓存
+                _Return_object(_Ptr, _Size);
+                return true;
+            }
+            // 当前CPU已满，归还一半之后重试
+            _Return_to_central_cache(_Index, _Size);
+            _Returned = true;
+            break;
+        case RseqResult::Aborted:
+            break;
+        }
+    }
+#else
+    (void)_Ptr;
+    (void)_Index;
+    (void)_Size;
+    return false;
+#endif
+}
+
+void CpuCache::collect_stats(MemoryStats & _Stats) noexcept
+{
+#if defined(WW_RSEQ_SUPPORTED)
+    for (size_type _Cpu = 0; _Cpu < _Cpu_count; ++_Cpu) {
+        CpuSlab * _Slab = _Slabs[_Cpu].load(std::memory_order_acquire);
+        if (_Slab == nullptr) {
+            continue;
+        }
+
+        for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+            // 只读取数量，其他CPU可能正在修改
+            size_type _Count = __atomic_load_n(&_Slab->lists[_I].count, __ATOMIC_RELAXED);
+            _Stats.size_classes[_I].cpu_cached += _Count;
+            _Stats.cpu_cache_bytes += _Count * Size::index_to_size(_I);
+        }
+    }
+#else
+    (void)_Stats;
+#endif
+}
+
+CpuSlab * CpuCache::_Get_slab(size_type _Cpu) noexcept
+{
+    if (_Cpu >= _Cpu_count) {
+        return nullptr;
+    }
+
+    CpuSlab * _Slab = _Slabs[_Cpu].load(std::memory_order_acquire);
+    if (_Slab != nullptr) {
+        return _Slab;
+    }
+
+    // 第一次在该CPU上使用，创建缓存
+    void * _Ptr = Platform::aligned_malloc(PAGE_SIZE, sizeof(CpuSlab));
+    if (_Ptr == nullptr) {
+        return nullptr;
+    }
+
+    CpuSlab * _New_slab = new(_Ptr) CpuSlab();
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        _New_slab->lists[_I].count = 0;
+        _New_slab->lists[_I].capacity = _Cpu_capacity(Size::index_to_size(_I));
+    }
+
+    if (!_Slabs[_Cpu].compare_exchange_strong(_Slab, _New_slab, std::memory_order_acq_rel)) {
+        // 其他线程已经创建
+        _New_slab->~CpuSlab();
+        Platform::aligned_free(_Ptr);
+        return _Slab;
+    }
+
+    return _New_slab;
+}
+
+void * CpuCache::_Fetch_from_central_cache(size_type _Index, size_type _Size) noexcept
+{
+#if defined(WW_RSEQ_SUPPORTED)
+    // 每次补充一半的容量
+    size_type _Count = _Cpu_capacity(_Size) / 2;
+    if (_Count == 0) {
+        _Count = 1;
+    }
+
+    FreeObject * _Begin = nullptr;
+    FreeObject * _End = nullptr;
+    // 从当前CPU所在节点的中心缓存获取
+    CentralCache & _Central_cache = CentralCache::get_central_cache(Numa::get_numa().current_node());
+    size_type _Fetched = _Central_cache.fetch_range(_Size, _Count, _Begin, _End);
+    if (_Fetched == 0) {
+        return nullptr;
+    }
+
+    // 第一个留给调用者，其余放入当前CPU的缓存
+    void * _Result = _Begin;
+    FreeObject * _Cur = _Begin->next();
+
+    FreeObject * _Left_begin = nullptr;
+    FreeObject * _Left_end = nullptr;
+    size_type _Left_count = 0;
+
+    RseqArea * _Rseq = _Rseq_area();
+    while (_Cur != nullptr) {
+        FreeObject * _Next = _Cur->next();
+
+        RseqResult _Result_code = RseqResult::Aborted;
+        while (_Result_code == RseqResult::Aborted) {
+            std::uint32_t _Cpu = __atomic_load_n(&_Rseq->cpu_id_start, __ATOMIC_RELAXED);
+            CpuSlab * _Slab = _Get_slab(_Cpu);
+            if (_Slab == nullptr) {
+                _Result_code = RseqResult::Failed;
+                break;
+            }
+            _Result_code = _Rseq_push(_Rseq, _Cpu, &_Slab->lists[_Index], _Cur);
+        }
+
+        if (_Result_code == RseqResult::Failed) {
+            // 迁移到了已满的CPU上，剩余的内存块还给中心缓存
+            _Cur->set_next(_Left_begin);
+            _Left_begin = _Cur;
+            if (_Left_end == nullptr) {
+                _Left_end = _Cur;
+            }
+            ++_Left_count;
+        }
+
+        _Cur = _Next;
+    }
+
+    if (_Left_count != 0) {
+        CentralCache::get_central_cache(Numa::get_numa().current_node())
+            .return_range(_Size, _Left_begin, _Left_end, _Left_count);
+    }
+
+    return _Result;
+#else
+    (void)_Index;
+    (void)_Size;
+    return nullptr;
+#endif
+}
+
+void CpuCache::_Return_object(void * _Ptr, size_type _Size) noexcept
+{
+    FreeObject * _Obj = reinterpret_cast<FreeObject *>(_Ptr);
+    _Obj->set_next(nullptr);
+    // 属于其他节点的内存块由中心缓存转交
+    CentralCache::get_central_cache(Numa::get_numa().current_node()).return_range(_Size, _Obj);
+}
+
+void CpuCache::_Return_to_central_cache(size_type _Index, size_type _Size) noexcept
+{
+#if defined(WW_RSEQ_SUPPORTED)
+    size_type _Count = _Cpu_capacity(_Size) / 2;
+    if (_Count == 0) {
+        _Count = 1;
+    }
+
+    FreeObject * _Begin = nullptr;
+    FreeObject * _End = nullptr;
+    size_type _Popped = 0;
+
+    // 从当前CPU的缓存中逐个弹出，组成链表
+    RseqArea * _Rseq = _Rseq_area();
+    while (_Popped < _Count) {
+        std::uint32_t _Cpu = __atomic_load_n(&_Rseq->cpu_id_start, __ATOMIC_RELAXED);
+        CpuSlab * _Slab = _Get_slab(_Cpu);
+        if (_Slab == nullptr) {
+            break;
+        }
+
+        void * _Ptr = nullptr;
+        RseqResult _Result = _Rseq_pop(_Rseq, _Cpu, &_Slab->lists[_Index], _Ptr);
+        if (_Result == RseqResult::Failed) {
+            break;
+        }
+
+        if (_Result == RseqResult::Success) {
+            FreeObject * _Obj = static_cast<FreeObject *>(_Ptr);
+            _Obj->set_next(_Begin);
+            _Begin = _Obj;
+            if (_End == nullptr) {
+                _End = _Obj;
+            }
+            ++_Popped;
+        }
+    }
+
+    if (_Popped != 0) {
+        CentralCache::get_central_cache(Numa::get_numa().current_node())
+            .return_range(_Size, _Begin, _End, _Popped);
+    }
+#else
+    (void)_Index;
+    (void)_Size;
+#endif
+}
+
+} // namespace WW
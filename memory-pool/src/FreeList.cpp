@@ -63,6 +63,7 @@ FreeListIterator FreeListIterator::operator++(int) noexcept
 
 FreeList::FreeList()
     : _Head()
+    , _Tail(nullptr)
     , _Size(0)
     , _Max_size(1)
 {
@@ -75,6 +76,10 @@ FreeObject * FreeList::front() noexcept
 
 void FreeList::push_front(FreeObject * _Free_object)
 {
+    if (_Tail == nullptr) {
+        _Tail = _Free_object;
+    }
+
     _Free_object->set_next(_Head.next());
     _Head.set_next(_Free_object);
     ++_Size;
@@ -85,6 +90,59 @@ void FreeList::pop_front()
     FreeObject * _Next = _Head.next()->next();
     _Head.set_next(_Next);
     --_Size;
+
+    if (_Next == nullptr) {
+        _Tail = nullptr;
+    }
+}
+
+void FreeList::push_range(FreeObject * _Begin, FreeObject * _End, size_type _Count) noexcept
+{
+    if (_Begin == nullptr) {
+        return;
+    }
+
+    if (_Tail == nullptr) {
+        _Tail = _End;
+    }
+
+    _End->set_next(_Head.next());
+    _Head.set_next(_Begin);
+    _Size += _Count;
+}
+
+size_type FreeList::pop_range(size_type _Count, FreeObject *& _Begin, FreeObject *& _End) noexcept
+{
+    if (_Count == 0 || _Tail == nullptr) {
+        _Begin = nullptr;
+        _End = nullptr;
+        return 0;
+    }
+
+    _Begin = _Head.next();
+
+    if (_Count >= _Size) {
+        // 整条链表取走，直接使用尾节点
+        _Count = _Size;
+        _End = _Tail;
+        _Head.set_next(nullptr);
+        _Tail = nullptr;
+        _Size = 0;
+        return _Count;
+    }
+
+    // 找到第_Count个节点，从这里断开
+    FreeObject * _Last = _Begin;
+    for (size_type _I = 1; _I < _Count; ++_I) {
+        _Last = _Last->next();
+    }
+
+    _Head.set_next(_Last->next());
+    _Last->set_next(nullptr);
+    _End = _Last;
+    _Size -= _Count;
+
+    return _Count;
 }
 
 FreeList::iterator FreeList::begin() noexcept
@@ -120,6 +178,7 @@ void FreeList::set_max_size(size_type _Max_size) noexcept
 void FreeList::clear() noexcept
 {
     _Head.set_next(nullptr);
+    _Tail = nullptr;
     _Size = 0;
     _Max_size = 1;
 }
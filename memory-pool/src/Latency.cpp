@@ -0,0 +1,284 @@
+#include "Latency.h"
+
+#include <new>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace WW
+{
+
+namespace
+{
+
+constexpr std::uint64_t SUB_BUCKET_NUM = 1ULL << LATENCY_SUB_BUCKET_BITS;
+constexpr size_type TIER_NUM = static_cast<size_type>(LatencyTier::COUNT);
+
+/**
+ * @brief 最高位的位置
+ * @param _Value 不为0
+ */
+size_type _Highest_bit(std::uint64_t _Value) noexcept
+{
+#if defined(__GNUC__)
+    return 63 - static_cast<size_type>(__builtin_clzll(_Value));
+#else
+    size_type _Bit = 0;
+    while (_Value >>= 1) {
+        ++_Bit;
+    }
+    return _Bit;
+#endif
+}
+
+/**
+ * @brief 读取单调时钟，单位为纳秒
+ */
+std::uint64_t _Monotonic_ns() noexcept
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+std::uint64_t LatencyHistogram::percentile(double _Rank) const noexcept
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    // 第一个累计次数达到目标的桶
+    double _Target = _Rank * static_cast<double>(count);
+    std::uint64_t _Seen = 0;
+    for (size_type _I = 0; _I < LATENCY_BUCKET_NUM; ++_I) {
+        _Seen += buckets[_I];
+        if (_Seen != 0 && static_cast<double>(_Seen) >= _Target) {
+            std::uint64_t _Upper = bucket_upper(_I);
+            return _Upper < max_cycles ? _Upper : max_cycles;
+        }
+    }
+
+    return max_cycles;
+}
+
+double LatencyHistogram::mean() const noexcept
+{
+    return count == 0 ? 0.0 : static_cast<double>(total_cycles) / static_cast<double>(count);
+}
+
+size_type LatencyHistogram::bucket_index(std::uint64_t _Cycles) noexcept
+{
+    if (_Cycles < SUB_BUCKET_NUM) {
+        return static_cast<size_type>(_Cycles);
+    }
+
+    // 区间号加上区间内的子桶号
+    size_type _Bit = _Highest_bit(_Cycles);
+    size_type _Shift = _Bit - LATENCY_SUB_BUCKET_BITS;
+    return ((_Shift + 1) << LATENCY_SUB_BUCKET_BITS) + static_cast<size_type>((_Cycles >> _Shift) & (SUB_BUCKET_NUM - 1));
+}
+
+std::uint64_t LatencyHistogram::bucket_lower(size_type _Index) noexcept
+{
+    if (_Index < SUB_BUCKET_NUM) {
+        return _Index;
+    }
+
+    size_type _Shift = (_Index >> LATENCY_SUB_BUCKET_BITS) - 1;
+    return (SUB_BUCKET_NUM + (_Index & (SUB_BUCKET_NUM - 1))) << _Shift;
+}
+
+std::uint64_t LatencyHistogram::bucket_upper(size_type _Index) noexcept
+{
+    if (_Index < SUB_BUCKET_NUM) {
+        return _Index;
+    }
+
+    size_type _Shift = (_Index >> LATENCY_SUB_BUCKET_BITS) - 1;
+    return bucket_lower(_Index) + ((1ULL << _Shift) - 1);
+}
+
+Latency::Latency()
+    : _Enabled(false)
+    , _Buckets()
+    , _Totals()
+    , _Maxes()
+{
+    reset();
+
+    // 通过环境变量开启
+    const char * _Env = std::getenv("WW_LATENCY");
+    if (_Env != nullptr && _Env[0] == '1') {
+        set_enabled(true);
+    }
+}
+
+Latency & Latency::get_latency()
+{
+    WW_NEVER_DESTROYED(Latency, _Instance, ());
+    return *_Instance;
+}
+
+bool Latency::enabled() const noexcept
+{
+    return _Enabled.load(std::memory_order_relaxed);
+}
+
+void Latency::set_enabled(bool _Enabled) noexcept
+{
+    this->_Enabled.store(_Enabled, std::memory_order_relaxed);
+}
+
+void Latency::record(LatencyTier _Tier, std::uint64_t _Cycles) noexcept
+{
+    size_type _Index = static_cast<size_type>(_Tier);
+    _Buckets[_Index][LatencyHistogram::bucket_index(_Cycles)].fetch_add(1, std::memory_order_relaxed);
+    _Totals[_Index].fetch_add(_Cycles, std::memory_order_relaxed);
+
+    std::uint64_t _Max = _Maxes[_Index].load(std::memory_order_relaxed);
+    while (_Cycles > _Max && !_Maxes[_Index].compare_exchange_weak(_Max, _Cycles, std::memory_order_relaxed)) {
+    }
+}
+
+void Latency::snapshot(LatencySnapshot & _Snapshot) const noexcept
+{
+    for (size_type _Tier = 0; _Tier < TIER_NUM; ++_Tier) {
+        LatencyHistogram & _Histogram = _Snapshot.tiers[_Tier];
+        _Histogram.count = 0;
+        for (size_type _I = 0; _I < LATENCY_BUCKET_NUM; ++_I) {
+            _Histogram.buckets[_I] = _Buckets[_Tier][_I].load(std::memory_order_relaxed);
+            _Histogram.count += _Histogram.buckets[_I];
+        }
+
+        // 次数以桶为准，保证分位数计算一致
+        _Histogram.total_cycles = _Totals[_Tier].load(std::memory_order_relaxed);
+        _Histogram.max_cycles = _Maxes[_Tier].load(std::memory_order_relaxed);
+    }
+
+    _Snapshot.cycles_per_ns = cycles_per_ns();
+}
+
+void Latency::reset() noexcept
+{
+    for (size_type _Tier = 0; _Tier < TIER_NUM; ++_Tier) {
+        for (std::atomic<std::uint64_t> & _Bucket : _Buckets[_Tier]) {
+            _Bucket.store(0, std::memory_order_relaxed);
+        }
+        _Totals[_Tier].store(0, std::memory_order_relaxed);
+        _Maxes[_Tier].store(0, std::memory_order_relaxed);
+    }
+}
+
+std::uint64_t Latency::now() noexcept
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t _Value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(_Value));
+    return _Value;
+#else
+    return _Monotonic_ns();
+#endif
+}
+
+double Latency::cycles_per_ns() noexcept
+{
+    static const double _Cycles_per_ns = []() {
+        // 忙等约10毫秒，对照单调时钟计算频率
+        std::uint64_t _Start_ns = _Monotonic_ns();
+        std::uint64_t _Start_cycles = now();
+        std::uint64_t _End_ns = _Start_ns;
+        while (_End_ns - _Start_ns < 10000000) {
+            _End_ns = _Monotonic_ns();
+        }
+        std::uint64_t _End_cycles = now();
+
+        double _Ratio = static_cast<double>(_End_cycles - _Start_cycles) / static_cast<double>(_End_ns - _Start_ns);
+        return _Ratio > 0 ? _Ratio : 1.0;
+    }();
+    return _Cycles_per_ns;
+}
+
+const char * Latency::tier_name(LatencyTier _Tier) noexcept
+{
+    switch (_Tier) {
+    case LatencyTier::FETCH_RANGE:
+        return "fetch_range";
+    case LatencyTier::RETURN_RANGE:
+        return "return_range";
+    case LatencyTier::FETCH_SPAN:
+        return "fetch_span";
+    case LatencyTier::RETURN_SPAN:
+        return "return_span";
+    case LatencyTier::SYSTEM_FETCH:
+        return "system_fetch";
+    default:
+        return "unknown";
+    }
+}
+
+LatencyTimer::LatencyTimer(LatencyTier _Tier) noexcept
+    : _Tier(_Tier)
+    , _Start(Latency::get_latency().enabled() ? Latency::now() : 0)
+{
+}
+
+LatencyTimer::~LatencyTimer()
+{
+    if (_Start != 0) {
+        std::uint64_t _End = Latency::now();
+        Latency::get_latency().record(_Tier, _End > _Start ? _End - _Start : 0);
+    }
+}
+
+LatencySnapshot get_latency_snapshot()
+{
+    LatencySnapshot _Snapshot;
+    Latency::get_latency().snapshot(_Snapshot);
+    return _Snapshot;
+}
+
+std::string format_latency(const LatencySnapshot & _Snapshot)
+{
+    std::string _Out;
+    char _Buffer[256];
+
+    _Out += "------------------------------------------------\n";
+    _Out += "WW-Memory-Pool latency (ns)\n";
+    _Out += "------------------------------------------------\n";
+    std::snprintf(_Buffer, sizeof(_Buffer), "%-14s %12s %10s %10s %10s %10s %12s\n",
+        "tier", "count", "mean", "p50", "p99", "p999", "max");
+    _Out += _Buffer;
+
+    double _Scale = _Snapshot.cycles_per_ns > 0 ? 1.0 / _Snapshot.cycles_per_ns : 1.0;
+    for (size_type _Tier = 0; _Tier < TIER_NUM; ++_Tier) {
+        const LatencyHistogram & _Histogram = _Snapshot.tiers[_Tier];
+        std::snprintf(_Buffer, sizeof(_Buffer), "%-14s %12llu %10.1f %10.1f %10.1f %10.1f %12.1f\n",
+            Latency::tier_name(static_cast<LatencyTier>(_Tier)),
+            static_cast<unsigned long long>(_Histogram.count),
+            _Histogram.mean() * _Scale,
+            static_cast<double>(_Histogram.percentile(0.5)) * _Scale,
+            static_cast<double>(_Histogram.percentile(0.99)) * _Scale,
+            static_cast<double>(_Histogram.percentile(0.999)) * _Scale,
+            static_cast<double>(_Histogram.max_cycles) * _Scale);
+        _Out += _Buffer;
+    }
+
+    return _Out;
+}
+
+void print_latency()
+{
+    std::string _Text = format_latency(get_latency_snapshot());
+    std::fputs(_Text.c_str(), stderr);
+}
+
+} // namespace WW
@@ -0,0 +1,50 @@
+#include "MemoryResource.h"
+
+#ifdef WW_MEMORY_RESOURCE_SUPPORTED
+
+#include <new>
+
+#include <ThreadCache.h>
+
+namespace WW
+{
+
+MemoryResource * MemoryResource::get_memory_resource() noexcept
+{
+    // 没有状态，不需要析构，进程退出阶段仍然可以使用
+    WW_NEVER_DESTROYED(MemoryResource, _Instance, ());
+    return _Instance;
+}
+
+void * MemoryResource::do_allocate(std::size_t _Bytes, std::size_t _Alignment)
+{
+    // 0字节也需要返回不同的指针
+    if (_Bytes == 0) {
+        _Bytes = 1;
+    }
+
+    void * _Ptr = ThreadCache::get_thread_cache().allocate_aligned(_Bytes, _Alignment);
+    if (_Ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return _Ptr;
+}
+
+void MemoryResource::do_deallocate(void * _Ptr, std::size_t _Bytes, std::size_t _Alignment)
+{
+    if (_Bytes == 0) {
+        _Bytes = 1;
+    }
+
+    ThreadCache::get_thread_cache().deallocate_aligned(_Ptr, _Bytes, _Alignment);
+}
+
+bool MemoryResource::do_is_equal(const std::pmr::memory_resource & _Other) const noexcept
+{
+    return this == &_Other || dynamic_cast<const MemoryResource *>(&_Other) != nullptr;
+}
+
+} // namespace WW
+
+#endif // WW_MEMORY_RESOURCE_SUPPORTED
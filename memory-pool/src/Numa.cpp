@@ -0,0 +1,173 @@
+#include "Numa.h"
+
+#include <new>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace WW
+{
+
+namespace
+{
+
+thread_local size_type _Thread_node = NO_NUMA_NODE;     // 当前线程指定的节点
+
+/**
+ * @brief 读取系统的节点数
+ * @details 解析`/sys/devices/system/node/online`，例如`0-1`，不申请内存
+ */
+size_type _Read_system_node_count() noexcept
+{
+#if defined(__linux__)
+    int _Fd = ::open("/sys/devices/system/node/online", O_RDONLY | O_CLOEXEC);
+    if (_Fd < 0) {
+        return 1;
+    }
+
+    char _Buffer[128];
+    ssize_t _Length = ::read(_Fd, _Buffer, sizeof(_Buffer) - 1);
+    ::close(_Fd);
+    if (_Length <= 0) {
+        return 1;
+    }
+    _Buffer[_Length] = '\0';
+
+    // 取出现过的最大节点号
+    size_type _Max_node = 0;
+    size_type _Value = 0;
+    for (ssize_t _I = 0; _I <= _Length; ++_I) {
+        char _Char = _Buffer[_I];
+        if (_Char >= '0' && _Char <= '9') {
+            _Value = _Value * 10 + static_cast<size_type>(_Char - '0');
+        } else {
+            _Max_node = _Value > _Max_node ? _Value : _Max_node;
+            _Value = 0;
+        }
+    }
+
+    return _Max_node + 1;
+#else
+    return 1;
+#endif
+}
+
+} // namespace
+
+Numa::Numa()
+    : _System_node_count(_Read_system_node_count())
+    , _Node_count(1)
+    , _Max_node_count(1)
+{
+    // 通过环境变量启用
+    size_type _Count = 1;
+    const char * _Env = std::getenv("WW_NUMA");
+    if (_Env != nullptr && std::strcmp(_Env, "1") == 0) {
+        _Count = _System_node_count;
+    }
+
+    _Env = std::getenv("WW_NUMA_NODES");
+    if (_Env != nullptr) {
+        _Count = static_cast<size_type>(std::strtoul(_Env, nullptr, 10));
+    }
+
+    set_node_count(_Count);
+}
+
+Numa & Numa::get_numa()
+{
+#ifdef WW_MALLOC_OVERRIDE
+    WW_NEVER_DESTROYED(Numa, _Instance, ());
+    return *_Instance;
+#else
+    static Numa _Instance;
+    return _Instance;
+#endif
+}
+
+bool Numa::enabled() const noexcept
+{
+    return node_count() > 1;
+}
+
+size_type Numa::system_node_count() const noexcept
+{
+    return _System_node_count;
+}
+
+size_type Numa::node_count() const noexcept
+{
+    return _Node_count.load(std::memory_order_relaxed);
+}
+
+size_type Numa::max_node_count() const noexcept
+{
+    return _Max_node_count.load(std::memory_order_relaxed);
+}
+
+void Numa::set_node_count(size_type _Count) noexcept
+{
+    if (_Count < 1) {
+        _Count = 1;
+    } else if (_Count > MAX_NUMA_NODE_NUM) {
+        _Count = MAX_NUMA_NODE_NUM;
+    }
+
+    _Node_count.store(_Count, std::memory_order_relaxed);
+
+    size_type _Max_count = _Max_node_count.load(std::memory_order_relaxed);
+    while (_Max_count < _Count &&
+        !_Max_node_count.compare_exchange_weak(_Max_count, _Count, std::memory_order_relaxed)) {
+    }
+}
+
+size_type Numa::current_node() const noexcept
+{
+    size_type _Count = node_count();
+    if (_Thread_node != NO_NUMA_NODE) {
+        return _Thread_node % _Count;
+    }
+
+    if (_Count == 1) {
+        return 0;
+    }
+
+#if defined(__linux__)
+    unsigned int _Cpu = 0;
+    unsigned int _Node = 0;
+    if (syscall(SYS_getcpu, &_Cpu, &_Node, nullptr) != 0) {
+        return 0;
+    }
+
+    // 使用系统节点时直接对应，模拟时按照CPU编号轮流分配
+    if (_Count == _System_node_count) {
+        return static_cast<size_type>(_Node) % _Count;
+    }
+
+    return static_cast<size_type>(_Cpu) % _Count;
+#else
+    return 0;
+#endif
+}
+
+void Numa::bind_thread(size_type _Node) noexcept
+{
+    _Thread_node = _Node;
+}
+
+size_type Numa::system_node(size_type _Node) const noexcept
+{
+    if (!enabled()) {
+        return NO_NUMA_NODE;
+    }
+
+    return _Node % _System_node_count;
+}
+
+} // namespace WW
@@ -1,243 +1,735 @@
 #include "PageCache.h"
 
-#include <Platform.h>
+#include <new>
+#include <limits>
 #include <cassert>
 
+#include <Platform.h>
+#include <CentralCache.h>
+#include <Numa.h>
+#include <Stats.h>
+#include <Latency.h>
+
 namespace WW
 {
 
-PageCache::PageCache()
+PageCache::PageCache(size_type _Node)
     : _Spans()
-    , _Free_span_map()
-    , _Busy_span_map()
-    , _Align_pointers()
+    , _Span_caches()
+    , _Span_cache_counts()
+    , _Large_spans()
+    , _Direct_pages(0)
+    , _Node(_Node)
+    , _Page_map(PageMap::get_page_map())
+    , _Span_pool()
     , _Mutex()
+    , _Release_rate(DEFAULT_RELEASE_RATE)
+    , _Scavenger()
+    , _Scavenger_mutex()
+    , _Scavenger_cond()
+    , _Scavenger_stop(false)
 {
 }
 
 PageCache::~PageCache()
 {
+    stop_scavenger();
+
     std::lock_guard<std::mutex> _Lock(_Mutex);
     
     // 释放所有页段
     for (size_type _I = 0; _I < MAX_PAGE_NUM; ++_I) {
+        while (!_Span_caches[_I].empty()) {
+            Span & _Span = _Span_caches[_I].front();
+            _Span_caches[_I].pop_front();
+            _Span_pool.destroy(&_Span);
+        }
+
         while (!_Spans[_I].empty()) {
             Span & _Span = _Spans[_I].front();
             _Spans[_I].pop_front();
             // 销毁页段
-            delete &_Span;
+            _Span_pool.destroy(&_Span);
         }
     }
 
-    // 释放所有对齐指针
-    for (void * _Ptr : _Align_pointers) {
-        Platform::aligned_free(_Ptr);
+    while (!_Large_spans.empty()) {
+        Span & _Span = _Large_spans.front();
+        _Large_spans.pop_front();
+        _Span_pool.destroy(&_Span);
     }
 }
 
 PageCache & PageCache::get_page_cache()
 {
-    static PageCache _Instance;
+#ifdef WW_MALLOC_OVERRIDE
+    WW_NEVER_DESTROYED(PageCache, _Instance, (0));
+    return *_Instance;
+#else
+    static PageCache _Instance(0);
     return _Instance;
+#endif
+}
+
+PageCache & PageCache::get_page_cache(size_type _Node)
+{
+    _Node %= MAX_NUMA_NODE_NUM;
+    if (_Node == 0) {
+        return get_page_cache();
+    }
+
+    // 其他节点按需创建，不会析构
+    alignas(PageCache) static unsigned char _Storage[MAX_NUMA_NODE_NUM][sizeof(PageCache)];
+    static std::atomic<PageCache *> _Instances[MAX_NUMA_NODE_NUM];
+    static std::mutex _Instances_mutex;
+
+    PageCache * _Instance = _Instances[_Node].load(std::memory_order_acquire);
+    if (_Instance == nullptr) {
+        std::lock_guard<std::mutex> _Lock(_Instances_mutex);
+        _Instance = _Instances[_Node].load(std::memory_order_relaxed);
+        if (_Instance == nullptr) {
+            _Instance = new(_Storage[_Node]) PageCache(_Node);
+            _Instances[_Node].store(_Instance, std::memory_order_release);
+        }
+    }
+
+    return *_Instance;
+}
+
+size_type PageCache::node() const noexcept
+{
+    return _Node;
 }
 
 Span * PageCache::fetch_span(size_type _Pages)
 {
+    LatencyTimer _Timer(LatencyTier::FETCH_SPAN);
+
+    if (_Pages >= DIRECT_MMAP_SIZE >> PAGE_SHIFT) {
+        // 超大内存直接向系统映射
+        return _Fetch_direct(_Pages);
+    }
+
+    if (_Pages <= MAX_PAGE_NUM) {
+        // 优先从页段缓存中获取，缓存中的页段仍然是繁忙状态，映射不需要修改
+        SpanList & _Span_cache = _Span_caches[_Pages - 1];
+        _Span_cache.lock();
+        if (!_Span_cache.empty()) {
+            Span & _Span = _Span_cache.front();
+            _Span_cache.pop_front();
+            --_Span_cache_counts[_Pages - 1];
+            _Span_cache.unlock();
+
+            return &_Span;
+        }
+        _Span_cache.unlock();
+    }
+
     std::lock_guard<std::mutex> _Lock(_Mutex);
+    return _Fetch_from_spans(_Pages);
+}
+
+Span * PageCache::fetch_aligned_span(size_type _Pages, size_type _Align_pages)
+{
+    if (_Align_pages <= 1) {
+        return fetch_span(_Pages);
+    }
 
-    // 如果有空闲页段，直接从链表中直接获取页段
-    if (!_Spans[_Pages - 1].empty()) {
-        // 从链表中取出页段
-        Span & _Span = _Spans[_Pages - 1].front();
-        _Spans[_Pages - 1].pop_front();
+    LatencyTimer _Timer(LatencyTier::FETCH_SPAN);
 
-        // 从空闲映射表中移除页段
-        _Free_span_map.erase(_Span.page_id());
-        _Free_span_map.erase(_Span.page_id() + _Span.page_count() - 1);
+    if (_Pages >= DIRECT_MMAP_SIZE >> PAGE_SHIFT) {
+        // 超大内存由系统映射时对齐
+        return _Fetch_direct(_Pages, _Align_pages);
+    }
 
-        // 将页段插入到繁忙映射表中
-        _Busy_span_map[_Span.page_id()] = &_Span;
-        _Busy_span_map[_Span.page_id() + _Span.page_count() - 1] = &_Span;
+    if (_Pages > static_cast<size_type>(-1) - _Align_pages) {
+        return nullptr;
+    }
 
-        return &_Span;
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    // 多切出对齐所需的页，保证其中一定有对齐的位置
+    size_type _Total_pages = _Pages + _Align_pages - 1;
+    Span * _Span = _Fetch_from_spans(_Total_pages);
+    if (_Span == nullptr) {
+        return nullptr;
     }
 
-    // 没有正好这么大的页段，尝试从更大块内存中切出页段
-    for (size_type _I = _Pages; _I < MAX_PAGE_NUM; ++_I) {
-        if (!_Spans[_I].empty()) {
-            // 取出页段，该页段页数为i + 1
-            Span & _Bigger_span = _Spans[_I].front();
-            _Spans[_I].pop_front();
+    size_type _Lead = (_Align_pages - (_Span->page_id() & (_Align_pages - 1))) & (_Align_pages - 1);
+    size_type _Trail = _Total_pages - _Lead - _Pages;
 
-            // 切分i + 1页的页段，切成i = (i + 1 - pages) + pages的两个页段
+    Span * _Lead_span = _Lead != 0 ? _Span_pool.create(_Node) : nullptr;
+    Span * _Trail_span = _Trail != 0 ? _Span_pool.create(_Node) : nullptr;
+    if ((_Lead != 0 && _Lead_span == nullptr) || (_Trail != 0 && _Trail_span == nullptr)) {
+        if (_Lead_span != nullptr) {
+            _Span_pool.destroy(_Lead_span);
+        }
+        if (_Trail_span != nullptr) {
+            _Span_pool.destroy(_Trail_span);
+        }
+        _Return_to_spans(_Span);
+        return nullptr;
+    }
 
-            // 新建一个split_span用于储存后面长pages页的页段
-            Span * _Split_span = new Span();
-            _Split_span->set_page_id(_Bigger_span.page_id() + _I + 1 - _Pages);
-            _Split_span->set_page_count(_Pages);
+    // 中间对齐的部分保持繁忙，首尾多出的部分作为空闲页段归还，中间页段繁忙所以不会被合并回去
+    size_type _Begin = _Span->page_id();
+    _Span->set_page_id(_Begin + _Lead);
+    _Span->set_page_count(_Pages);
 
-            // bigger_span用于储存前面长i + 1 - pages的页段，直接修改页数
-            _Bigger_span.set_page_count(_I + 1 - _Pages);
+    if (_Lead_span != nullptr) {
+        _Lead_span->set_page_id(_Begin);
+        _Lead_span->set_page_count(_Lead);
+        _Return_to_spans(_Lead_span);
+    }
 
-            // 前面的页段插入到对应链表中
-            _Spans[_Bigger_span.page_count() - 1].push_front(&_Bigger_span);
+    if (_Trail_span != nullptr) {
+        _Trail_span->set_page_id(_Begin + _Lead + _Pages);
+        _Trail_span->set_page_count(_Trail);
+        _Return_to_spans(_Trail_span);
+    }
 
-            // 修改映射表
-            // 解除原bigger_span的尾页号映射
-            _Free_span_map.erase(_Bigger_span.page_id() + _Bigger_span.page_count() + _Split_span->page_count() - 1);
-            // 添加新bigger_span的尾页号映射
-            _Free_span_map[_Bigger_span.page_id() + _Bigger_span.page_count() - 1] = &_Bigger_span;
+    return _Span;
+}
+
+void PageCache::return_span(Span * _Span)
+{
+    LatencyTimer _Timer(LatencyTier::RETURN_SPAN);
 
-            // split_span页号插入繁忙映射表
-            _Busy_span_map[_Split_span->page_id()] = _Split_span;
-            _Busy_span_map[_Split_span->page_id() + _Split_span->page_count() - 1] = _Split_span;
+    size_type _Pages = _Span->page_count();
+    if (_Pages >= DIRECT_MMAP_SIZE >> PAGE_SHIFT) {
+        // 直接映射的内存立即交还给系统
+        _Return_direct(_Span);
+        return;
+    }
+
+    if (_Pages <= MAX_PAGE_NUM) {
+        // 页段缓存未满时直接放入，保持繁忙状态，不参与合并
+        size_type _Max_count = MAX_SPAN_CACHE_PAGES / _Pages;
+        if (_Max_count == 0) {
+            _Max_count = 1;
+        }
 
-            return _Split_span;
+        SpanList & _Span_cache = _Span_caches[_Pages - 1];
+        _Span_cache.lock();
+        if (_Span_cache_counts[_Pages - 1] < _Max_count) {
+            _Span_cache.push_front(_Span);
+            ++_Span_cache_counts[_Pages - 1];
+            _Span_cache.unlock();
+            return;
         }
+        _Span_cache.unlock();
+    }
+
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+    _Return_to_spans(_Span);
+}
+
+bool PageCache::resize_span(Span * _Span, size_type _Pages)
+{
+    size_type _Old_pages = _Span->page_count();
+    if (_Pages == 0 || _Old_pages >= DIRECT_MMAP_SIZE >> PAGE_SHIFT || _Pages >= DIRECT_MMAP_SIZE >> PAGE_SHIFT) {
+        // 直接映射的页段归还时整体交还给系统，不能调整
+        return false;
     }
 
-    // 没找到更大的页段，直接申请一个最大的页段，然后按照上面的流程重新获取页段
-    void * _Ptr = _Fetch_from_system(MAX_PAGE_NUM);
+    if (_Pages == _Old_pages) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    if (_Pages < _Old_pages) {
+        // 缩小，后面多出的页作为空闲页段归还，可以与后面的空闲页段合并
+        Span * _Tail_span = _Span_pool.create(_Node);
+        if (_Tail_span == nullptr) {
+            return false;
+        }
+
+        _Span->set_page_count(_Pages);
+        _Tail_span->set_page_id(_Span->page_id() + _Pages);
+        _Tail_span->set_page_count(_Old_pages - _Pages);
+        _Return_to_spans(_Tail_span);
+        return true;
+    }
+
+    // 增大，只能使用紧随其后的空闲页段，页段缓存中的页段是繁忙状态，不会被使用
+    size_type _Extra = _Pages - _Old_pages;
+    Span * _Next_span = _Page_map.get(_Span->page_id() + _Old_pages);
+    if (_Next_span == nullptr || _Next_span->node() != _Node || _Next_span->is_use() ||
+        _Next_span->page_count() < _Extra) {
+        return false;
+    }
+
+    _Free_span_list(_Next_span->page_count()).erase(_Next_span);
+    if (_Next_span->page_count() == _Extra) {
+        _Span_pool.destroy(_Next_span);
+    } else {
+        // 剩余部分仍然是空闲页段，尾页号映射不变，更新首页号映射
+        _Next_span->set_page_id(_Next_span->page_id() + _Extra);
+        _Next_span->set_page_count(_Next_span->page_count() - _Extra);
+        _Page_map.set(_Next_span->page_id(), _Next_span);
+        _Insert_free_span(_Next_span);
+    }
+
+    // 新增的每一页都需要映射
+    _Span->set_page_count(_Pages);
+    _Page_map.set_range(_Span->page_id() + _Old_pages, _Extra, _Span);
+    return true;
+}
+
+void PageCache::flush_span_caches()
+{
+    for (size_type _I = 0; _I < MAX_PAGE_NUM; ++_I) {
+        // 先整体取出，不在持有页段缓存锁时获取全局锁
+        SpanList & _Span_cache = _Span_caches[_I];
+        _Span_cache.lock();
+        Span * _List = nullptr;
+        while (!_Span_cache.empty()) {
+            Span & _Span = _Span_cache.front();
+            _Span_cache.pop_front();
+            _Span.set_next(_List);
+            _List = &_Span;
+        }
+        _Span_cache_counts[_I] = 0;
+        _Span_cache.unlock();
+
+        if (_List == nullptr) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> _Lock(_Mutex);
+        while (_List != nullptr) {
+            Span * _Next = _List->next();
+            _Return_to_spans(_List);
+            _List = _Next;
+        }
+    }
+}
+
+Span * PageCache::_Fetch_from_spans(size_type _Pages)
+{
+    // 先在正好这么大以及更大的链表中查找，链表前部是未归还物理内存的页段
+    if (_Pages <= MAX_PAGE_NUM) {
+        for (size_type _I = _Pages - 1; _I < MAX_PAGE_NUM; ++_I) {
+            if (!_Spans[_I].empty()) {
+                Span & _Span = _Spans[_I].front();
+                _Spans[_I].pop_front();
+                return _Carve_span(&_Span, _Pages);
+            }
+        }
+    }
+
+    // 在超大页段中查找能放下的最小页段，页数相同时优先未归还的
+    Span * _Best_span = nullptr;
+    for (Span & _Span : _Large_spans) {
+        if (_Span.page_count() < _Pages) {
+            continue;
+        }
+
+        if (_Best_span == nullptr || _Span.page_count() < _Best_span->page_count() ||
+            (_Span.page_count() == _Best_span->page_count() && _Best_span->is_released() && !_Span.is_released())) {
+            _Best_span = &_Span;
+        }
+    }
+
+    if (_Best_span != nullptr) {
+        _Large_spans.erase(_Best_span);
+        return _Carve_span(_Best_span, _Pages);
+    }
+
+    // 都没有找到，向系统申请，至少申请最大页数
+    size_type _System_pages = _Pages > MAX_PAGE_NUM ? _Pages : MAX_PAGE_NUM;
+    void * _Ptr = _Fetch_from_system(_System_pages);
     if (_Ptr == nullptr) {
         return nullptr;
     }
 
-    // 记录该对齐指针
-    _Align_pointers.emplace_back(_Ptr);
+    // 为这段内存创建映射节点
+    // 系统内存不会交还，失败时只能放弃这段内存
+    if (!_Page_map.ensure(Span::ptr_to_id(_Ptr), _System_pages)) {
+        return nullptr;
+    }
 
-    Span * _Max_span = new Span();
+    Span * _New_span = _Span_pool.create(_Node);
+    if (_New_span == nullptr) {
+        return nullptr;
+    }
 
-    if (_Pages == MAX_PAGE_NUM) {
-        // 恰好需要最大页数
-        _Max_span->set_page_id(Span::ptr_to_id(_Ptr));
-        _Max_span->set_page_count(MAX_PAGE_NUM);
+    // 新映射的内存还没有占用物理页，先作为空闲页段建立首尾映射，再从中切出需要的页段
+    _New_span->set_page_id(Span::ptr_to_id(_Ptr));
+    _New_span->set_page_count(_System_pages);
+    _New_span->set_released(true);
+    _Page_map.set(_New_span->page_id(), _New_span);
+    _Page_map.set(_New_span->page_id() + _System_pages - 1, _New_span);
 
-        // 建立繁忙表映射
-        _Busy_span_map[_Max_span->page_id()] = _Max_span;
-        _Busy_span_map[_Max_span->page_id() + _Max_span->page_count() - 1] = _Max_span;
+    return _Carve_span(_New_span, _Pages);
+}
 
-        return _Max_span;
-    }
-    
-    // max_span用来储存MAX_PAGE_NUM - pages的页段
-    _Max_span->set_page_id(Span::ptr_to_id(_Ptr));
-    _Max_span->set_page_count(MAX_PAGE_NUM - _Pages);
+Span * PageCache::_Carve_span(Span * _Span, size_type _Pages)
+{
+    if (_Span->page_count() > _Pages) {
+        // 新建一个页段用于储存后面长pages页的部分
+        Span * _Split_span = _Span_pool.create(_Node);
+        if (_Split_span == nullptr) {
+            _Insert_free_span(_Span);
+            return nullptr;
+        }
 
-    // 新建一个页段用于返回
-    Span * _Split_span = new Span();
-    _Split_span->set_page_id(_Max_span->page_id() + MAX_PAGE_NUM - _Pages);
-    _Split_span->set_page_count(_Pages);
+        _Split_span->set_page_id(_Span->page_id() + _Span->page_count() - _Pages);
+        _Split_span->set_page_count(_Pages);
 
-    // 新页段插入页段链表中
-    _Spans[_Max_span->page_count() - 1].push_front(_Max_span);
+        // 原页段保留前面的部分，保持原来的归还状态，首页号不变，更新尾页号映射
+        _Span->set_page_count(_Span->page_count() - _Pages);
+        _Insert_free_span(_Span);
+        _Page_map.set(_Span->page_id() + _Span->page_count() - 1, _Span);
 
-    // max_span页号插入空闲映射表
-    _Free_span_map[_Max_span->page_id()] = _Max_span;
-    _Free_span_map[_Max_span->page_id() + _Max_span->page_count() - 1] = _Max_span;
+        _Span = _Split_span;
+    }
 
-    // split_span页号插入繁忙映射表
-    _Busy_span_map[_Split_span->page_id()] = _Split_span;
-    _Busy_span_map[_Split_span->page_id() + _Split_span->page_count() - 1] = _Split_span;
+    // 繁忙页段的每一页都需要映射，便于通过内存块查找页段
+    // 已归还的物理页在访问时由系统重新分配，直接标记为未归还
+    _Span->set_use(true);
+    _Span->set_released(false);
+    _Page_map.set_range(_Span->page_id(), _Span->page_count(), _Span);
 
-    return _Split_span;
+    return _Span;
 }
 
-void PageCache::return_span(Span * _Span)
+Span * PageCache::_Fetch_direct(size_type _Pages, size_type _Align_pages)
 {
+    // 映射时不持有锁
+    void * _Ptr = nullptr;
+    {
+        LatencyTimer _Timer(LatencyTier::SYSTEM_FETCH);
+        _Ptr = Platform::system_map(_Pages << PAGE_SHIFT, _Align_pages << PAGE_SHIFT);
+    }
+    if (_Ptr == nullptr) {
+        return nullptr;
+    }
+
+    size_type _System_node = Numa::get_numa().system_node(_Node);
+    if (_System_node != NO_NUMA_NODE) {
+        Platform::bind_node(_Ptr, _Pages << PAGE_SHIFT, _System_node);
+    }
+
     std::lock_guard<std::mutex> _Lock(_Mutex);
 
-    // 从繁忙映射表中删除该页段
-    _Busy_span_map.erase(_Span->page_id());
-    _Busy_span_map.erase(_Span->page_id() + _Span->page_count() - 1);
+    if (!_Page_map.ensure(Span::ptr_to_id(_Ptr), _Pages)) {
+        Platform::system_unmap(_Ptr, _Pages << PAGE_SHIFT);
+        return nullptr;
+    }
 
-    // 向前寻找空闲的页
-    auto _Prev_it = _Free_span_map.find(_Span->page_id() - 1);
-    while (_Prev_it != _Free_span_map.end()) {
-        Span * _Prev_span = _Prev_it->second;
+    Span * _Span = _Span_pool.create(_Node);
+    if (_Span == nullptr) {
+        Platform::system_unmap(_Ptr, _Pages << PAGE_SHIFT);
+        return nullptr;
+    }
 
-        // 判断合并后是否超出上限
-        if (_Span->page_count() + _Prev_span->page_count() > MAX_PAGE_NUM) {
-            break;
-        }
+    // 只有首页会被用来查找页段，首尾映射用于阻止相邻页段合并
+    _Span->set_page_id(Span::ptr_to_id(_Ptr));
+    _Span->set_page_count(_Pages);
+    _Span->set_use(true);
+    _Page_map.set(_Span->page_id(), _Span);
+    _Page_map.set(_Span->page_id() + _Pages - 1, _Span);
+    _Direct_pages += _Pages;
 
-        // 从链表中删除该空闲页
-        _Spans[_Prev_span->page_count() - 1].erase(_Prev_span);
+    return _Span;
+}
 
-        // 从哈希表中删除该空闲页
-        _Free_span_map.erase(_Prev_span->page_id());
-        _Free_span_map.erase(_Prev_span->page_id() + _Prev_span->page_count() - 1);
+void PageCache::_Return_direct(Span * _Span)
+{
+    void * _Ptr = Span::id_to_ptr(_Span->page_id());
+    size_type _Pages = _Span->page_count();
+
+    {
+        std::lock_guard<std::mutex> _Lock(_Mutex);
+
+        // 地址范围可能再次被系统分配给页缓存，需要先清除映射
+        _Page_map.set(_Span->page_id(), nullptr);
+        _Page_map.set(_Span->page_id() + _Pages - 1, nullptr);
+        _Direct_pages -= _Pages;
+        _Span_pool.destroy(_Span);
+    }
+
+    Platform::system_unmap(_Ptr, _Pages << PAGE_SHIFT);
+}
+
+void PageCache::_Return_to_spans(Span * _Span)
+{
+    // 标记为空闲
+    _Span->set_use(false);
+
+    // 向前寻找空闲的页
+    // 相邻的页段可能属于其他节点，不能合并；物理内存归还状态不同的页段也不合并，保证统计准确
+    Span * _Prev_span = _Page_map.get(_Span->page_id() - 1);
+    while (_Can_merge(_Span, _Prev_span)) {
+        // 从链表中删除该空闲页，合并后的页段没有页数上限
+        _Free_span_list(_Prev_span->page_count()).erase(_Prev_span);
 
         // 合并页段
         _Span->set_page_id(_Prev_span->page_id());
         _Span->set_page_count(_Prev_span->page_count() + _Span->page_count());
 
         // 删除原空闲页
-        delete _Prev_span;
+        _Span_pool.destroy(_Prev_span);
 
-        _Prev_it = _Free_span_map.find(_Span->page_id() - 1);
+        _Prev_span = _Page_map.get(_Span->page_id() - 1);
     }
 
     // 向后寻找空闲的页
-    auto _Next_it = _Free_span_map.find(_Span->page_id() + _Span->page_count());
-    while (_Next_it != _Free_span_map.end()) {
-        Span * _Next_span = _Next_it->second;
-
-        // 判断合并后是否超出上限
-        if (_Span->page_count() + _Next_span->page_count() > MAX_PAGE_NUM) {
-            break;
-        }
-
+    Span * _Next_span = _Page_map.get(_Span->page_id() + _Span->page_count());
+    while (_Can_merge(_Span, _Next_span)) {
         // 从链表中删除该空闲页
-        _Spans[_Next_span->page_count() - 1].erase(_Next_span);
-
-        // 从哈希表中删除该空闲页
-        _Free_span_map.erase(_Next_span->page_id());
-        _Free_span_map.erase(_Next_span->page_id() + _Next_span->page_count() - 1);
+        _Free_span_list(_Next_span->page_count()).erase(_Next_span);
 
         // 合并页段，首页号不变，只需要调整大小
         _Span->set_page_count(_Next_span->page_count() + _Span->page_count());
 
         // 删除原空闲页
-        delete _Next_span;
+        _Span_pool.destroy(_Next_span);
 
-        _Next_it = _Free_span_map.find(_Span->page_id() + _Span->page_count());
+        _Next_span = _Page_map.get(_Span->page_id() + _Span->page_count());
     }
 
-    // 添加新页段的映射
-    _Free_span_map[_Span->page_id()] = _Span;
-    _Free_span_map[_Span->page_id() + _Span->page_count() - 1] = _Span;
+    // 添加新页段的首尾映射，中间页的映射不会再被访问
+    _Page_map.set(_Span->page_id(), _Span);
+    _Page_map.set(_Span->page_id() + _Span->page_count() - 1, _Span);
 
     // 合并完成，插入新的链表
-    _Spans[_Span->page_count() - 1].push_front(_Span);
+    _Insert_free_span(_Span);
+}
+
+bool PageCache::_Has_committed_pages(size_type _Pages) noexcept
+{
+    size_type _Committed = 0;
+
+    for (size_type _I = MAX_PAGE_NUM + 1; _I > 0; --_I) {
+        // 未归还的页段都在链表前部
+        for (Span & _Span : _Free_span_list(_I)) {
+            if (_Span.is_released()) {
+                break;
+            }
+
+            _Committed += _Span.page_count();
+            if (_Committed >= _Pages) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool PageCache::_Can_merge(const Span * _Span, const Span * _Neighbor) const noexcept
+{
+    return _Neighbor != nullptr && _Neighbor->node() == _Node && !_Neighbor->is_use() &&
+        _Neighbor->is_released() == _Span->is_released();
 }
 
 Span * PageCache::object_to_span(void * _Ptr) noexcept
 {
-    size_type _Page_id = Span::ptr_to_id(_Ptr);
+    // 繁忙页段的每一页都有映射，无需加锁
+    return _Page_map.get(Span::ptr_to_id(_Ptr));
+}
+
+size_type PageCache::release_free_memory()
+{
+    return release_free_memory(std::numeric_limits<size_type>::max());
+}
+
+size_type PageCache::release_free_memory(size_type _Pages)
+{
+    if (Platform::page_mode() == Platform::PageMode::EXPLICIT_HUGE) {
+        // 显式大页不支持按页归还，不需要清空下层缓存
+        return 0;
+    }
+
+    // 页缓存中未归还的空闲页不足时，传输缓存中的内存块先归还页段，中心缓存中完全空闲的页段和页段缓存中的页段合并后才能归还
+    bool _Enough = false;
+    {
+        std::lock_guard<std::mutex> _Lock(_Mutex);
+        _Enough = _Has_committed_pages(_Pages);
+    }
+
+    if (!_Enough) {
+        CentralCache & _Central_cache = CentralCache::get_central_cache(_Node);
+        _Central_cache.flush_transfer_caches();
+        _Central_cache.release_empty_spans();
+        flush_span_caches();
+    }
 
     std::lock_guard<std::mutex> _Lock(_Mutex);
 
-    // 寻找首个大于该页号的迭代器
-    auto _It = _Busy_span_map.upper_bound(_Page_id);
+    size_type _Released = 0;
+    Span * _Failed = nullptr;
+
+    // 从大页段开始归还，小页段更可能马上被再次使用，MAX_PAGE_NUM + 1对应超大页段链表
+    for (size_type _I = MAX_PAGE_NUM + 1; _I > 0 && _Released < _Pages; --_I) {
+        SpanList & _List = _Free_span_list(_I);
+
+        // 未归还的页段都在链表前部，遇到已归还的页段即可停止
+        while (!_List.empty() && !_List.front().is_released() && _Released < _Pages) {
+            Span & _Span = _List.front();
+            _List.pop_front();
+
+            if (Platform::release(Span::id_to_ptr(_Span.page_id()), _Span.page_count() << PAGE_SHIFT)) {
+                // 只统计这次新归还的页，之后和相邻的已归还页段合并
+                _Released += _Span.page_count();
+                _Span.set_released(true);
+                _Return_to_spans(&_Span);
+            } else {
+                // 归还失败的页段先取出，标记为繁忙避免被合并，继续尝试其他页段
+                _Span.set_use(true);
+                _Span.set_next(_Failed);
+                _Failed = &_Span;
+            }
+        }
+    }
 
-    if (_It == _Busy_span_map.begin()) {
-        return nullptr;
+    while (_Failed != nullptr) {
+        Span * _Next = _Failed->next();
+        _Failed->set_use(false);
+        _Insert_free_span(_Failed);
+        _Failed = _Next;
     }
 
-    --_It;
-    Span * _Span = _It->second;
+    return _Released;
+}
 
-    if (_Page_id >= _Span->page_id() + _Span->page_count()) {
-        // 不在该页段范围内
-        return nullptr;
+void PageCache::set_release_rate(size_type _Pages) noexcept
+{
+    _Release_rate.store(_Pages, std::memory_order_relaxed);
+}
+
+size_type PageCache::release_rate() const noexcept
+{
+    return _Release_rate.load(std::memory_order_relaxed);
+}
+
+void PageCache::start_scavenger()
+{
+    std::lock_guard<std::mutex> _Lock(_Scavenger_mutex);
+
+    if (_Scavenger.joinable()) {
+        return;
     }
 
-    return _Span;
+    _Scavenger_stop = false;
+    _Scavenger = std::thread(&PageCache::_Scavenge, this);
+}
+
+void PageCache::stop_scavenger()
+{
+    std::unique_lock<std::mutex> _Lock(_Scavenger_mutex);
+
+    if (!_Scavenger.joinable()) {
+        return;
+    }
+
+    _Scavenger_stop = true;
+    _Scavenger_cond.notify_all();
+
+    // 回收线程退出前需要获取锁
+    _Lock.unlock();
+    _Scavenger.join();
+}
+
+void PageCache::collect_stats(MemoryStats & _Stats)
+{
+    for (size_type _I = 0; _I < MAX_PAGE_NUM; ++_I) {
+        _Span_caches[_I].lock();
+        _Stats.span_cache_bytes += (_Span_cache_counts[_I] * (_I + 1)) << PAGE_SHIFT;
+        _Span_caches[_I].unlock();
+    }
+
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    for (size_type _I = 0; _I < MAX_PAGE_NUM; ++_I) {
+        size_type _Free = 0;
+        size_type _Released = 0;
+        for (Span & _Span : _Spans[_I]) {
+            ++_Free;
+            if (_Span.is_released()) {
+                ++_Released;
+            }
+        }
+
+        _Stats.free_spans[_I] += _Free;
+        _Stats.released_spans[_I] += _Released;
+        _Stats.page_cache_bytes += ((_Free - _Released) * (_I + 1)) << PAGE_SHIFT;
+        _Stats.page_cache_released_bytes += (_Released * (_I + 1)) << PAGE_SHIFT;
+    }
+
+    for (Span & _Span : _Large_spans) {
+        ++_Stats.large_free_spans;
+        if (_Span.is_released()) {
+            _Stats.page_cache_released_bytes += _Span.page_count() << PAGE_SHIFT;
+        } else {
+            _Stats.page_cache_bytes += _Span.page_count() << PAGE_SHIFT;
+        }
+    }
+
+    _Stats.direct_mapped_bytes += _Direct_pages << PAGE_SHIFT;
+}
+
+void PageCache::lock() noexcept
+{
+    for (SpanList & _Span_cache : _Span_caches) {
+        _Span_cache.lock();
+    }
+
+    _Mutex.lock();
+}
+
+void PageCache::unlock() noexcept
+{
+    _Mutex.unlock();
+
+    for (SpanList & _Span_cache : _Span_caches) {
+        _Span_cache.unlock();
+    }
 }
 
 void * PageCache::_Fetch_from_system(size_type _Pages) const noexcept
 {
-    return Platform::aligned_malloc(PAGE_SIZE, _Pages << PAGE_SHIFT);
+    LatencyTimer _Timer(LatencyTier::SYSTEM_FETCH);
+    return Platform::system_malloc(_Pages << PAGE_SHIFT, Numa::get_numa().system_node(_Node));
+}
+
+SpanList & PageCache::_Free_span_list(size_type _Pages) noexcept
+{
+    if (_Pages > MAX_PAGE_NUM) {
+        return _Large_spans;
+    }
+
+    return _Spans[_Pages - 1];
+}
+
+void PageCache::_Insert_free_span(Span * _Span) noexcept
+{
+    SpanList & _List = _Free_span_list(_Span->page_count());
+    if (_Span->is_released()) {
+        _List.push_back(_Span);
+    } else {
+        _List.push_front(_Span);
+    }
+}
+
+void PageCache::_Scavenge()
+{
+    std::unique_lock<std::mutex> _Lock(_Scavenger_mutex);
+
+    // 每秒唤醒一次，按照回收速率归还内存
+    while (!_Scavenger_cond.wait_for(_Lock, std::chrono::seconds(1), [this]() { return _Scavenger_stop; })) {
+        size_type _Rate = _Release_rate.load(std::memory_order_relaxed);
+        if (_Rate == 0) {
+            continue;
+        }
+
+        _Lock.unlock();
+        release_free_memory(_Rate);
+        _Lock.lock();
+    }
 }
 
 } // namespace WW
@@ -0,0 +1,159 @@
+#include "PageMap.h"
+
+#include <new>
+
+#include <Platform.h>
+
+namespace WW
+{
+
+PageMap::PageMap()
+    : _Root()
+{
+    for (size_type _I = 0; _I < ROOT_LENGTH; ++_I) {
+        _Root[_I].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+PageMap::~PageMap()
+{
+    // 释放所有节点
+    for (size_type _I = 0; _I < ROOT_LENGTH; ++_I) {
+        Interior * _Interior = _Root[_I].load(std::memory_order_relaxed);
+        if (_Interior == nullptr) {
+            continue;
+        }
+
+        for (size_type _J = 0; _J < INTERIOR_LENGTH; ++_J) {
+            Leaf * _Leaf = _Interior->leaves[_J].load(std::memory_order_relaxed);
+            if (_Leaf != nullptr) {
+                _Delete_node(_Leaf);
+            }
+        }
+
+        _Delete_node(_Interior);
+    }
+}
+
+PageMap & PageMap::get_page_map()
+{
+#ifdef WW_MALLOC_OVERRIDE
+    WW_NEVER_DESTROYED(PageMap, _Instance, ());
+    return *_Instance;
+#else
+    static PageMap _Instance;
+    return _Instance;
+#endif
+}
+
+Span * PageMap::get(size_type _Page_id) const noexcept
+{
+    if ((_Page_id >> PAGE_ID_BITS) != 0) {
+        // 超出地址范围
+        return nullptr;
+    }
+
+    size_type _Root_index = _Page_id >> (INTERIOR_BITS + LEAF_BITS);
+    size_type _Interior_index = (_Page_id >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
+    size_type _Leaf_index = _Page_id & (LEAF_LENGTH - 1);
+
+    Interior * _Interior = _Root[_Root_index].load(std::memory_order_acquire);
+    if (_Interior == nullptr) {
+        return nullptr;
+    }
+
+    Leaf * _Leaf = _Interior->leaves[_Interior_index].load(std::memory_order_acquire);
+    if (_Leaf == nullptr) {
+        return nullptr;
+    }
+
+    return _Leaf->values[_Leaf_index].load(std::memory_order_acquire);
+}
+
+void PageMap::set(size_type _Page_id, Span * _Span) noexcept
+{
+    size_type _Root_index = _Page_id >> (INTERIOR_BITS + LEAF_BITS);
+    size_type _Interior_index = (_Page_id >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
+    size_type _Leaf_index = _Page_id & (LEAF_LENGTH - 1);
+
+    Interior * _Interior = _Root[_Root_index].load(std::memory_order_relaxed);
+    Leaf * _Leaf = _Interior->leaves[_Interior_index].load(std::memory_order_relaxed);
+    _Leaf->values[_Leaf_index].store(_Span, std::memory_order_release);
+}
+
+void PageMap::set_range(size_type _Page_id, size_type _Count, Span * _Span) noexcept
+{
+    for (size_type _I = 0; _I < _Count; ++_I) {
+        set(_Page_id + _I, _Span);
+    }
+}
+
+bool PageMap::ensure(size_type _Page_id, size_type _Count) noexcept
+{
+    if (_Count == 0) {
+        return true;
+    }
+
+    size_type _Last_id = _Page_id + _Count - 1;
+    if (_Last_id < _Page_id || (_Last_id >> PAGE_ID_BITS) != 0) {
+        // 超出地址范围
+        return false;
+    }
+
+    // 每次前进一个叶子节点覆盖的范围
+    for (size_type _Id = _Page_id; _Id <= _Last_id; ) {
+        size_type _Root_index = _Id >> (INTERIOR_BITS + LEAF_BITS);
+        size_type _Interior_index = (_Id >> LEAF_BITS) & (INTERIOR_LENGTH - 1);
+
+        Interior * _Interior = _Root[_Root_index].load(std::memory_order_acquire);
+        if (_Interior == nullptr) {
+            Interior * _New_interior = _New_node<Interior>();
+            if (_New_interior == nullptr) {
+                return false;
+            }
+            // 节点内容初始化完成后再发布，多个页缓存同时创建时保留先发布的节点
+            if (_Root[_Root_index].compare_exchange_strong(_Interior, _New_interior, std::memory_order_acq_rel)) {
+                _Interior = _New_interior;
+            } else {
+                _Delete_node(_New_interior);
+            }
+        }
+
+        Leaf * _Leaf = _Interior->leaves[_Interior_index].load(std::memory_order_acquire);
+        if (_Leaf == nullptr) {
+            Leaf * _New_leaf = _New_node<Leaf>();
+            if (_New_leaf == nullptr) {
+                return false;
+            }
+            if (!_Interior->leaves[_Interior_index].compare_exchange_strong(_Leaf, _New_leaf, std::memory_order_acq_rel)) {
+                _Delete_node(_New_leaf);
+            }
+        }
+
+        // 跳到下一个叶子节点的起始页号
+        _Id = ((_Id >> LEAF_BITS) + 1) << LEAF_BITS;
+    }
+
+    return true;
+}
+
+template <typename _Node>
+_Node * PageMap::_New_node() noexcept
+{
+    void * _Ptr = Platform::aligned_malloc(PAGE_SIZE, sizeof(_Node));
+    if (_Ptr == nullptr) {
+        return nullptr;
+    }
+
+    // 值初始化，所有指针置空
+    return new(_Ptr) _Node();
+}
+
+template <typename _Node>
+void PageMap::_Delete_node(_Node * _Ptr) noexcept
+{
+    _Ptr->~_Node();
+    Platform::aligned_free(_Ptr);
+}
+
+} // namespace WW
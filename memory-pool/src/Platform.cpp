@@ -1,14 +1,135 @@
 #include "Platform.h"
 
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+
 #if defined(_WIN32) || defined(_WIN64)
 #include <malloc.h>
+#include <windows.h>
 #elif defined(__linux__)
-#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #endif
 
 namespace WW
 {
 
+namespace
+{
+
+std::mutex _System_mutex;                                       // 系统内存锁
+char * _System_cursors[MAX_NUMA_NODE_NUM + 1] = {};             // 不绑定和每个节点当前预留区域中下一块可用内存
+char * _System_ends[MAX_NUMA_NODE_NUM + 1] = {};                // 不绑定和每个节点当前预留区域的末尾
+Platform::PageMode _System_mode = Platform::PageMode::NORMAL;   // 预留内存使用的页类型
+bool _System_mode_initialized = false;                          // 是否已经读取环境变量
+size_type _System_allocated = 0;                                // 已经分配出去的内存总量
+size_type _System_reserved = 0;                                 // 已经预留的虚拟内存总量
+
+/**
+ * @brief 读取环境变量中的页类型
+ * @details 需要持有系统内存锁
+ */
+void _Init_page_mode() noexcept
+{
+    if (_System_mode_initialized) {
+        return;
+    }
+
+    _System_mode_initialized = true;
+
+    const char * _Env = std::getenv("WW_HUGE_PAGES");
+    if (_Env == nullptr) {
+        return;
+    }
+
+    if (std::strcmp(_Env, "thp") == 0) {
+        _System_mode = Platform::PageMode::TRANSPARENT_HUGE;
+    } else if (std::strcmp(_Env, "hugetlb") == 0) {
+        _System_mode = Platform::PageMode::EXPLICIT_HUGE;
+    }
+}
+
+/**
+ * @brief 向系统预留一段虚拟内存
+ * @param _Size 预留大小，大页大小的整数倍，返回实际预留的大小
+ * @param _Min_size 显式大页不足时最少预留的大小，大页大小的整数倍
+ * @param _Mode 页类型
+ * @return 成功时返回按大页对齐的指针，失败时返回`nullptr`
+ */
+char * _Reserve_from_system(size_type & _Size, size_type _Min_size, Platform::PageMode _Mode) noexcept
+{
+#if defined(_WIN32) || defined(_WIN64)
+    // 大页需要额外的权限，统一使用普通页
+    (void)_Min_size;
+    (void)_Mode;
+    return static_cast<char *>(VirtualAlloc(nullptr, _Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#elif defined(__linux__)
+#ifdef MAP_HUGETLB
+    if (_Mode == Platform::PageMode::EXPLICIT_HUGE) {
+        // 显式大页在映射时就要占用，剩余的大页不足时减半重试，直到需要的大小
+        size_type _Huge_size = _Size;
+        while (true) {
+            void * _Ptr = mmap(nullptr, _Huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (_Ptr != MAP_FAILED) {
+                _Size = _Huge_size;
+                return static_cast<char *>(_Ptr);
+            }
+
+            if (_Huge_size == _Min_size) {
+                break;
+            }
+
+            _Huge_size = (_Huge_size / 2) & ~(HUGE_PAGE_SIZE - 1);
+            if (_Huge_size < _Min_size) {
+                _Huge_size = _Min_size;
+            }
+        }
+        // 系统预留的大页不足，退回普通页
+    }
+#else
+    (void)_Min_size;
+#endif
+
+    // 多映射一个大页的大小，便于对齐
+    size_type _Mapped_size = _Size + HUGE_PAGE_SIZE;
+    void * _Ptr = mmap(nullptr, _Mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (_Ptr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    // 去掉首尾多余的部分
+    char * _Begin = static_cast<char *>(_Ptr);
+    char * _Aligned = reinterpret_cast<char *>(
+        (reinterpret_cast<std::uintptr_t>(_Begin) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1)
+    );
+    size_type _Head = static_cast<size_type>(_Aligned - _Begin);
+    if (_Head != 0) {
+        munmap(_Begin, _Head);
+    }
+    if (HUGE_PAGE_SIZE - _Head != 0) {
+        munmap(_Aligned + _Size, HUGE_PAGE_SIZE - _Head);
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (_Mode == Platform::PageMode::TRANSPARENT_HUGE) {
+        // 失败时仍然可以使用普通页
+        madvise(_Aligned, _Size, MADV_HUGEPAGE);
+    }
+#endif
+
+    return _Aligned;
+#else
+    (void)_Min_size;
+    (void)_Mode;
+    return static_cast<char *>(Platform::aligned_malloc(HUGE_PAGE_SIZE, _Size));
+#endif
+}
+
+} // namespace
+
 void * Platform::aligned_malloc(size_type _Alignment, size_type _Size)
 {
     void * _Ptr = nullptr;
@@ -33,4 +154,197 @@ void Platform::aligned_free(void * _Ptr)
 #endif
 }
 
+void * Platform::system_malloc(size_type _Size, size_type _Node)
+{
+    std::lock_guard<std::mutex> _Lock(_System_mutex);
+
+    _Init_page_mode();
+
+    // 第一个区域不绑定节点
+    size_type _Slot = _Node == NO_NUMA_NODE ? 0 : _Node % MAX_NUMA_NODE_NUM + 1;
+    char *& _System_cursor = _System_cursors[_Slot];
+    char *& _System_end = _System_ends[_Slot];
+
+    if (static_cast<size_type>(_System_end - _System_cursor) < _Size) {
+        // 当前区域剩余的虚拟内存不够，预留新的区域，剩余部分不会占用物理内存
+        size_type _Min_size = (_Size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        size_type _Reserve_size = _Min_size < SYSTEM_RESERVE_SIZE ? SYSTEM_RESERVE_SIZE : _Min_size;
+
+        char * _Ptr = _Reserve_from_system(_Reserve_size, _Min_size, _System_mode);
+        if (_Ptr == nullptr) {
+            return nullptr;
+        }
+
+        if (_Node != NO_NUMA_NODE) {
+            // 还没有访问过，绑定后物理页从该节点分配，失败时仍然可以使用
+            bind_node(_Ptr, _Reserve_size, _Node);
+        }
+
+        _System_cursor = _Ptr;
+        _System_end = _Ptr + _Reserve_size;
+        _System_reserved += _Reserve_size;
+    }
+
+    void * _Ptr = _System_cursor;
+    _System_cursor += _Size;
+    _System_allocated += _Size;
+    return _Ptr;
+}
+
+void * Platform::system_map(size_type _Size, size_type _Alignment)
+{
+    if (_Alignment < PAGE_SIZE) {
+        _Alignment = PAGE_SIZE;
+    }
+
+    if (_Size > static_cast<size_type>(-1) - _Alignment) {
+        return nullptr;
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    if (_Alignment == PAGE_SIZE) {
+        return VirtualAlloc(nullptr, _Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    // 不能部分释放，先预留一段找到对齐的地址，释放后在该地址重新映射，可能被其他线程抢先，需要重试
+    for (int _Try = 0; _Try < 8; ++_Try) {
+        void * _Reserved = VirtualAlloc(nullptr, _Size + _Alignment - PAGE_SIZE, MEM_RESERVE, PAGE_NOACCESS);
+        if (_Reserved == nullptr) {
+            return nullptr;
+        }
+
+        std::uintptr_t _Address = reinterpret_cast<std::uintptr_t>(_Reserved);
+        _Address = (_Address + _Alignment - 1) & ~static_cast<std::uintptr_t>(_Alignment - 1);
+        VirtualFree(_Reserved, 0, MEM_RELEASE);
+
+        void * _Ptr = VirtualAlloc(reinterpret_cast<void *>(_Address), _Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (_Ptr != nullptr) {
+            return _Ptr;
+        }
+    }
+
+    return nullptr;
+#elif defined(__linux__)
+    size_type _Map_size = _Size + _Alignment - PAGE_SIZE;
+    char * _Map_ptr = static_cast<char *>(mmap(nullptr, _Map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (_Map_ptr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    // 交还首尾多映射的部分
+    std::uintptr_t _Address = reinterpret_cast<std::uintptr_t>(_Map_ptr);
+    size_type _Lead = ((_Address + _Alignment - 1) & ~static_cast<std::uintptr_t>(_Alignment - 1)) - _Address;
+    if (_Lead != 0) {
+        munmap(_Map_ptr, _Lead);
+    }
+
+    char * _Ptr = _Map_ptr + _Lead;
+    if (_Map_size - _Lead > _Size) {
+        munmap(_Ptr + _Size, _Map_size - _Lead - _Size);
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (page_mode() != PageMode::NORMAL) {
+        // 超大内存使用透明大页
+        madvise(_Ptr, _Size, MADV_HUGEPAGE);
+    }
+#endif
+
+    return _Ptr;
+#else
+    return aligned_malloc(_Alignment, _Size);
+#endif
+}
+
+bool Platform::bind_node(void * _Ptr, size_type _Size, size_type _Node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    // 直接使用系统调用，不依赖libnuma
+    constexpr int _Mpol_preferred = 1;
+    unsigned long _Mask = 1UL << (_Node % (sizeof(unsigned long) * 8));
+    return syscall(SYS_mbind, _Ptr, _Size, _Mpol_preferred, &_Mask, sizeof(_Mask) * 8, 0) == 0;
+#else
+    (void)_Ptr;
+    (void)_Size;
+    (void)_Node;
+    return false;
+#endif
+}
+
+void Platform::system_unmap(void * _Ptr, size_type _Size)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    (void)_Size;
+    VirtualFree(_Ptr, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(_Ptr, _Size);
+#else
+    (void)_Size;
+    aligned_free(_Ptr);
+#endif
+}
+
+void Platform::set_page_mode(PageMode _Mode)
+{
+    std::lock_guard<std::mutex> _Lock(_System_mutex);
+
+    _System_mode_initialized = true;
+    if (_System_mode != _Mode) {
+        // 放弃当前区域，之后的内存都使用新的页类型，未使用的部分不占用物理内存
+        _System_mode = _Mode;
+        for (size_type _I = 0; _I <= MAX_NUMA_NODE_NUM; ++_I) {
+            _System_cursors[_I] = nullptr;
+            _System_ends[_I] = nullptr;
+        }
+    }
+}
+
+Platform::PageMode Platform::page_mode()
+{
+    std::lock_guard<std::mutex> _Lock(_System_mutex);
+
+    _Init_page_mode();
+    return _System_mode;
+}
+
+size_type Platform::system_allocated_size()
+{
+    std::lock_guard<std::mutex> _Lock(_System_mutex);
+    return _System_allocated;
+}
+
+size_type Platform::system_reserved_size()
+{
+    std::lock_guard<std::mutex> _Lock(_System_mutex);
+    return _System_reserved;
+}
+
+bool Platform::release(void * _Ptr, size_type _Size)
+{
+    if (page_mode() == PageMode::EXPLICIT_HUGE) {
+        // 显式大页只能整个大页归还，不支持按页归还
+        return false;
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    // 内容可以丢弃，系统在内存紧张时回收物理页
+    return VirtualAlloc(_Ptr, _Size, MEM_RESET, PAGE_READWRITE) != nullptr;
+#elif defined(__linux__)
+    // 立即释放物理页，再次访问时得到清零的页
+    return madvise(_Ptr, _Size, MADV_DONTNEED) == 0;
+#else
+    return false;
+#endif
+}
+
+void Platform::lock() noexcept
+{
+    _System_mutex.lock();
+}
+
+void Platform::unlock() noexcept
+{
+    _System_mutex.unlock();
+}
+
 } // namespace WW
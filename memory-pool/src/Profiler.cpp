@@ -0,0 +1,417 @@
+#include "Profiler.h"
+
+#include <new>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <ObjectPool.h>
+#include <ThreadCache.h>
+
+#if defined(__linux__)
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <cxxabi.h>
+#include <time.h>
+#endif
+
+namespace WW
+{
+
+namespace
+{
+
+thread_local bool _In_profiler = false;             // 当前线程是否正在采样
+thread_local std::uint64_t _Random_state = 0;       // 当前线程的随机数状态
+
+/**
+ * @brief 采样记录的内存池，由`Profiler`的内存池锁保护
+ */
+ObjectPool<ProfileSample> & _Sample_pool()
+{
+    WW_NEVER_DESTROYED(ObjectPool<ProfileSample>, _Pool, ());
+    return *_Pool;
+}
+
+/**
+ * @brief 生成`(0, 1]`之间均匀分布的随机数
+ */
+double _Random() noexcept
+{
+    if (_Random_state == 0) {
+        // 每个线程使用不同的种子
+        std::uint64_t _Seed = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(&_Random_state));
+#if defined(__linux__)
+        timespec _Time;
+        clock_gettime(CLOCK_MONOTONIC, &_Time);
+        _Seed ^= static_cast<std::uint64_t>(_Time.tv_nsec) << 16;
+#endif
+        _Random_state = _Seed | 1;
+    }
+
+    // xorshift64*
+    _Random_state ^= _Random_state >> 12;
+    _Random_state ^= _Random_state << 25;
+    _Random_state ^= _Random_state >> 27;
+    std::uint64_t _Value = _Random_state * 0x2545F4914F6CDD1DULL;
+    return static_cast<double>((_Value >> 11) + 1) / static_cast<double>(1ULL << 53);
+}
+
+/**
+ * @brief 估计一个采样代表的申请次数
+ * @details 大小为`size`的申请被采样的概率为`1 - exp(-size / rate)`
+ */
+double _Sample_scale(const ProfileSample & _Sample) noexcept
+{
+    double _Probability = 1.0 - std::exp(-static_cast<double>(_Sample.size) / static_cast<double>(_Sample.rate));
+    return _Probability > 0 ? 1.0 / _Probability : 1.0;
+}
+
+/**
+ * @brief 按调用栈排序，相同调用栈相邻
+ */
+bool _Stack_less(const ProfileSample & _Left, const ProfileSample & _Right) noexcept
+{
+    if (_Left.depth != _Right.depth) {
+        return _Left.depth < _Right.depth;
+    }
+    return std::lexicographical_compare(_Left.stack, _Left.stack + _Left.depth, _Right.stack, _Right.stack + _Right.depth);
+}
+
+bool _Stack_equal(const ProfileSample & _Left, const ProfileSample & _Right) noexcept
+{
+    return _Left.depth == _Right.depth && std::equal(_Left.stack, _Left.stack + _Left.depth, _Right.stack);
+}
+
+/**
+ * @brief 写入一个调用栈地址对应的函数名
+ */
+void _Write_symbol(std::FILE * _File, void * _Address)
+{
+#if defined(__linux__)
+    // 调用栈中是返回地址，减一后落在调用指令内
+    void * _Call = static_cast<char *>(_Address) - 1;
+    Dl_info _Info;
+    if (dladdr(_Call, &_Info) != 0) {
+        if (_Info.dli_sname != nullptr) {
+            int _Status = 0;
+            char * _Demangled = abi::__cxa_demangle(_Info.dli_sname, nullptr, nullptr, &_Status);
+            std::fputs(_Status == 0 && _Demangled != nullptr ? _Demangled : _Info.dli_sname, _File);
+            std::free(_Demangled);
+            return;
+        }
+
+        if (_Info.dli_fname != nullptr) {
+            const char * _Name = std::strrchr(_Info.dli_fname, '/');
+            std::fprintf(_File, "%s+0x%zx", _Name != nullptr ? _Name + 1 : _Info.dli_fname,
+                static_cast<size_type>(static_cast<char *>(_Call) - static_cast<char *>(_Info.dli_fbase)));
+            return;
+        }
+    }
+#endif
+    std::fprintf(_File, "%p", _Address);
+}
+
+} // namespace
+
+Profiler::Profiler()
+    : _Sample_rate(0)
+    , _Sample_count(0)
+    , _Buckets()
+    , _Bucket_mutexes()
+    , _Pool_mutex()
+{
+    for (std::atomic<ProfileSample *> & _Bucket : _Buckets) {
+        _Bucket.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // 通过环境变量开启
+    const char * _Env = std::getenv("WW_PROFILE_SAMPLE_RATE");
+    if (_Env != nullptr && _Env[0] != '\0') {
+        set_sample_rate(static_cast<size_type>(std::strtoull(_Env, nullptr, 10)));
+    }
+}
+
+Profiler & Profiler::get_profiler()
+{
+    WW_NEVER_DESTROYED(Profiler, _Instance, ());
+    return *_Instance;
+}
+
+bool Profiler::enabled() const noexcept
+{
+    return _Sample_rate.load(std::memory_order_relaxed) != 0;
+}
+
+size_type Profiler::sample_rate() const noexcept
+{
+    return _Sample_rate.load(std::memory_order_relaxed);
+}
+
+void Profiler::set_sample_rate(size_type _Rate) noexcept
+{
+#if defined(__linux__)
+    if (_Rate != 0) {
+        // 第一次获取调用栈时会加载库并申请内存，提前在采样之外完成
+        void * _Stack[1];
+        backtrace(_Stack, 1);
+    }
+#endif
+
+    // 和新增、删除采样互斥，保证还有存活的采样时钩子不会关闭
+    std::lock_guard<std::mutex> _Lock(_Pool_mutex);
+    if (_Rate != 0) {
+        // 先打开钩子，之后采样的内存释放时一定会检查
+        ThreadCacheRegistry::get_thread_cache_registry().set_hook(ThreadCacheHook::PROFILE, true);
+    }
+    _Sample_rate.store(_Rate, std::memory_order_relaxed);
+    _Update_hook();
+}
+
+size_type Profiler::sample_count() const noexcept
+{
+    return _Sample_count.load(std::memory_order_relaxed);
+}
+
+size_type Profiler::next_sample_interval() noexcept
+{
+    size_type _Rate = _Sample_rate.load(std::memory_order_relaxed);
+    if (_Rate == 0) {
+        return PROFILER_RECHECK_SIZE;
+    }
+
+    // 几何分布的间隔，每个字节被采样的概率都是`1 / rate`
+    double _Interval = -std::log(_Random()) * static_cast<double>(_Rate);
+    double _Max_interval = static_cast<double>(static_cast<size_type>(-1) >> 1);
+    if (_Interval > _Max_interval) {
+        _Interval = _Max_interval;
+    }
+    return static_cast<size_type>(_Interval) + 1;
+}
+
+void Profiler::record_allocate(void * _Ptr, size_type _Size) noexcept
+{
+    size_type _Rate = _Sample_rate.load(std::memory_order_relaxed);
+    if (_Rate == 0 || _In_profiler) {
+        return;
+    }
+    _In_profiler = true;
+
+    // 在加锁之前获取调用栈，跳过当前函数
+    void * _Stack[PROFILER_MAX_DEPTH + 1];
+    int _Depth = 0;
+#if defined(__linux__)
+    _Depth = backtrace(_Stack, static_cast<int>(PROFILER_MAX_DEPTH + 1));
+#endif
+
+    ProfileSample * _Sample = nullptr;
+    {
+        // 在内存池锁下计数，关闭后不再新增采样
+        std::lock_guard<std::mutex> _Lock(_Pool_mutex);
+        if (_Sample_rate.load(std::memory_order_relaxed) != 0) {
+            _Sample = _Sample_pool().create();
+        }
+        if (_Sample != nullptr) {
+            _Sample_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (_Sample != nullptr) {
+        _Sample->ptr = _Ptr;
+        _Sample->size = _Size;
+        _Sample->rate = _Rate;
+        _Sample->depth = _Depth > 1 ? static_cast<size_type>(_Depth - 1) : 0;
+        std::memcpy(_Sample->stack, _Stack + 1, _Sample->depth * sizeof(void *));
+
+        size_type _Index = _Bucket_index(_Ptr);
+        std::lock_guard<std::mutex> _Lock(_Bucket_mutexes[_Index % PROFILER_LOCK_NUM]);
+        _Sample->next = _Buckets[_Index].load(std::memory_order_relaxed);
+        _Buckets[_Index].store(_Sample, std::memory_order_release);
+    }
+
+    _In_profiler = false;
+}
+
+void Profiler::record_deallocate(void * _Ptr) noexcept
+{
+    // 大部分桶是空的，不需要加锁
+    size_type _Index = _Bucket_index(_Ptr);
+    if (_Buckets[_Index].load(std::memory_order_acquire) == nullptr) {
+        return;
+    }
+
+    ProfileSample * _Found = nullptr;
+    {
+        std::lock_guard<std::mutex> _Lock(_Bucket_mutexes[_Index % PROFILER_LOCK_NUM]);
+        ProfileSample * _Prev = nullptr;
+        ProfileSample * _Sample = _Buckets[_Index].load(std::memory_order_relaxed);
+        while (_Sample != nullptr && _Sample->ptr != _Ptr) {
+            _Prev = _Sample;
+            _Sample = _Sample->next;
+        }
+
+        if (_Sample == nullptr) {
+            return;
+        }
+
+        if (_Prev == nullptr) {
+            _Buckets[_Index].store(_Sample->next, std::memory_order_release);
+        } else {
+            _Prev->next = _Sample->next;
+        }
+        _Found = _Sample;
+    }
+
+    std::lock_guard<std::mutex> _Lock(_Pool_mutex);
+    _Sample_pool().destroy(_Found);
+    _Sample_count.fetch_sub(1, std::memory_order_relaxed);
+    _Update_hook();
+}
+
+void Profiler::snapshot(std::vector<ProfileSample> & _Samples)
+{
+    // 在加锁之前预留空间，加锁后复制不会再申请内存，超出预留的新采样忽略
+    _Samples.clear();
+    _Samples.reserve(sample_count() + PROFILER_LOCK_NUM);
+
+    for (size_type _Lock_index = 0; _Lock_index < PROFILER_LOCK_NUM; ++_Lock_index) {
+        std::lock_guard<std::mutex> _Lock(_Bucket_mutexes[_Lock_index]);
+        for (size_type _Index = _Lock_index; _Index < PROFILER_BUCKET_NUM; _Index += PROFILER_LOCK_NUM) {
+            ProfileSample * _Sample = _Buckets[_Index].load(std::memory_order_relaxed);
+            for (; _Sample != nullptr && _Samples.size() < _Samples.capacity(); _Sample = _Sample->next) {
+                _Samples.push_back(*_Sample);
+                _Samples.back().next = nullptr;
+            }
+        }
+    }
+}
+
+bool Profiler::dump_pprof(const char * _Path)
+{
+    std::vector<ProfileSample> _Samples;
+    snapshot(_Samples);
+    std::sort(_Samples.begin(), _Samples.end(), _Stack_less);
+
+    std::FILE * _File = std::fopen(_Path, "w");
+    if (_File == nullptr) {
+        return false;
+    }
+
+    size_type _Total_size = 0;
+    for (const ProfileSample & _Sample : _Samples) {
+        _Total_size += _Sample.size;
+    }
+
+    // 所有采样仍然存活，申请和存活的数值相同
+    size_type _Rate = sample_rate();
+    if (_Rate == 0 && !_Samples.empty()) {
+        _Rate = _Samples.front().rate;
+    }
+    std::fprintf(_File, "heap profile: %6zu: %8zu [%6zu: %8zu] @ heap_v2/%zu\n",
+        _Samples.size(), _Total_size, _Samples.size(), _Total_size, _Rate);
+
+    for (size_type _Begin = 0; _Begin < _Samples.size();) {
+        size_type _End = _Begin;
+        size_type _Size = 0;
+        while (_End < _Samples.size() && _Stack_equal(_Samples[_Begin], _Samples[_End])) {
+            _Size += _Samples[_End].size;
+            ++_End;
+        }
+
+        std::fprintf(_File, "%6zu: %8zu [%6zu: %8zu] @", _End - _Begin, _Size, _End - _Begin, _Size);
+        for (size_type _I = 0; _I < _Samples[_Begin].depth; ++_I) {
+            std::fprintf(_File, " %p", _Samples[_Begin].stack[_I]);
+        }
+        std::fputc('\n', _File);
+        _Begin = _End;
+    }
+
+#if defined(__linux__)
+    // pprof根据映射找到地址所在的文件再解析函数名
+    std::fputs("\nMAPPED_LIBRARIES:\n", _File);
+    std::FILE * _Maps = std::fopen("/proc/self/maps", "r");
+    if (_Maps != nullptr) {
+        char _Buffer[4096];
+        size_type _Length = 0;
+        while ((_Length = std::fread(_Buffer, 1, sizeof(_Buffer), _Maps)) > 0) {
+            std::fwrite(_Buffer, 1, _Length, _File);
+        }
+        std::fclose(_Maps);
+    }
+#endif
+
+    return std::fclose(_File) == 0;
+}
+
+bool Profiler::dump_folded(const char * _Path)
+{
+    std::vector<ProfileSample> _Samples;
+    snapshot(_Samples);
+    std::sort(_Samples.begin(), _Samples.end(), _Stack_less);
+
+    std::FILE * _File = std::fopen(_Path, "w");
+    if (_File == nullptr) {
+        return false;
+    }
+
+    for (size_type _Begin = 0; _Begin < _Samples.size();) {
+        size_type _End = _Begin;
+        double _Bytes = 0;
+        while (_End < _Samples.size() && _Stack_equal(_Samples[_Begin], _Samples[_End])) {
+            _Bytes += _Sample_scale(_Samples[_End]) * static_cast<double>(_Samples[_End].size);
+            ++_End;
+        }
+
+        // 折叠格式从最外层开始
+        const ProfileSample & _Sample = _Samples[_Begin];
+        if (_Sample.depth == 0) {
+            std::fputs("[unknown]", _File);
+        }
+        for (size_type _I = _Sample.depth; _I > 0; --_I) {
+            _Write_symbol(_File, _Sample.stack[_I - 1]);
+            if (_I > 1) {
+                std::fputc(';', _File);
+            }
+        }
+        std::fprintf(_File, " %.0f\n", _Bytes);
+        _Begin = _End;
+    }
+
+    return std::fclose(_File) == 0;
+}
+
+void Profiler::lock() noexcept
+{
+    for (std::mutex & _Mutex : _Bucket_mutexes) {
+        _Mutex.lock();
+    }
+    _Pool_mutex.lock();
+}
+
+void Profiler::unlock() noexcept
+{
+    _Pool_mutex.unlock();
+    for (std::mutex & _Mutex : _Bucket_mutexes) {
+        _Mutex.unlock();
+    }
+}
+
+void Profiler::_Update_hook() noexcept
+{
+    // 关闭后最后一个采样被释放时才关闭钩子
+    if (_Sample_rate.load(std::memory_order_relaxed) == 0 && _Sample_count.load(std::memory_order_relaxed) == 0) {
+        ThreadCacheRegistry::get_thread_cache_registry().set_hook(ThreadCacheHook::PROFILE, false);
+    }
+}
+
+size_type Profiler::_Bucket_index(void * _Ptr) noexcept
+{
+    // 内存块至少8字节对齐，乘法哈希取高位
+    std::uint64_t _Key = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(_Ptr)) >> 3;
+    return static_cast<size_type>((_Key * 0x9E3779B97F4A7C15ULL) >> 32) & (PROFILER_BUCKET_NUM - 1);
+}
+
+} // namespace WW
@@ -0,0 +1,207 @@
+#include "RemoteFree.h"
+
+#include <new>
+#include <cstdlib>
+#include <cstring>
+
+#include <CentralCache.h>
+#include <Size.h>
+
+namespace WW
+{
+
+namespace
+{
+
+/**
+ * @brief 表示队列已关闭的链表头
+ */
+FreeObject * const _Closed = reinterpret_cast<FreeObject *>(1);
+
+} // namespace
+
+RemoteQueue::RemoteQueue()
+    : _Heads()
+    , _Counts()
+{
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        _Heads[_I].store(_Closed, std::memory_order_relaxed);
+        _Counts[_I].store(0, std::memory_order_relaxed);
+    }
+}
+
+bool RemoteQueue::push(size_type _Index, FreeObject * _Obj) noexcept
+{
+    // 先占用数量再压入，取走时数量不会小于链表长度
+    size_type _Max_count = MAX_REMOTE_QUEUE_BYTES / Size::index_to_size(_Index);
+    if (_Counts[_Index].fetch_add(1, std::memory_order_relaxed) >= _Max_count) {
+        _Counts[_Index].fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    FreeObject * _Head = _Heads[_Index].load(std::memory_order_relaxed);
+    do {
+        if (_Head == _Closed) {
+            _Counts[_Index].fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        _Obj->set_next(_Head);
+    } while (!_Heads[_Index].compare_exchange_weak(_Head, _Obj, std::memory_order_release, std::memory_order_relaxed));
+
+    return true;
+}
+
+size_type RemoteQueue::pop_all(size_type _Index, FreeObject *& _Begin, FreeObject *& _End) noexcept
+{
+    FreeObject * _Head = _Heads[_Index].load(std::memory_order_relaxed);
+    if (_Head == nullptr || _Head == _Closed) {
+        // 大多数时候为空，避免不必要的写入，已关闭的队列保持关闭
+        return 0;
+    }
+
+    _Begin = _Heads[_Index].exchange(nullptr, std::memory_order_acquire);
+
+    // 找到链表尾部并计数
+    size_type _Count = 1;
+    _End = _Begin;
+    while (_End->next() != nullptr) {
+        _End = _End->next();
+        ++_Count;
+    }
+
+    _Counts[_Index].fetch_sub(_Count, std::memory_order_relaxed);
+    return _Count;
+}
+
+void RemoteQueue::open() noexcept
+{
+    for (std::atomic<FreeObject *> & _Head : _Heads) {
+        _Head.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+void RemoteQueue::close() noexcept
+{
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        FreeObject * _Begin = _Heads[_I].exchange(_Closed, std::memory_order_acquire);
+        if (_Begin == nullptr || _Begin == _Closed) {
+            continue;
+        }
+
+        // 正在压入的线程看到关闭后会自行减去
+        size_type _Count = 0;
+        for (FreeObject * _Obj = _Begin; _Obj != nullptr; _Obj = _Obj->next()) {
+            ++_Count;
+        }
+        _Counts[_I].fetch_sub(_Count, std::memory_order_relaxed);
+
+        // 逐个归还到所属页段，属于其他节点的内存块由中心缓存转交
+        CentralCache::get_central_cache().return_range(Size::index_to_size(_I), _Begin);
+    }
+}
+
+RemoteFree::RemoteFree()
+    : _Queues()
+    , _Used()
+    , _Enabled(false)
+    , _Queue_pool()
+    , _Mutex()
+{
+    for (size_type _I = 0; _I < MAX_REMOTE_QUEUE_NUM; ++_I) {
+        _Queues[_I].store(nullptr, std::memory_order_relaxed);
+        _Used[_I].store(false, std::memory_order_relaxed);
+    }
+
+    // 通过环境变量启用
+    const char * _Env = std::getenv("WW_REMOTE_FREE");
+    if (_Env != nullptr && std::strcmp(_Env, "1") == 0) {
+        _Enabled.store(true, std::memory_order_relaxed);
+    }
+}
+
+RemoteFree & RemoteFree::get_remote_free()
+{
+#ifdef WW_MALLOC_OVERRIDE
+    WW_NEVER_DESTROYED(RemoteFree, _Instance, ());
+    return *_Instance;
+#else
+    static RemoteFree _Instance;
+    return _Instance;
+#endif
+}
+
+bool RemoteFree::enabled() const noexcept
+{
+    return _Enabled.load(std::memory_order_relaxed);
+}
+
+void RemoteFree::set_enabled(bool _Enabled) noexcept
+{
+    this->_Enabled.store(_Enabled, std::memory_order_relaxed);
+}
+
+size_type RemoteFree::acquire() noexcept
+{
+    for (size_type _I = 0; _I < MAX_REMOTE_QUEUE_NUM; ++_I) {
+        bool _Expected = false;
+        if (_Used[_I].load(std::memory_order_relaxed) ||
+            !_Used[_I].compare_exchange_strong(_Expected, true, std::memory_order_acquire)) {
+            continue;
+        }
+
+        // 每个队列只由占用者创建一次
+        RemoteQueue * _Queue = _Queues[_I].load(std::memory_order_acquire);
+        if (_Queue == nullptr) {
+            {
+                std::lock_guard<std::mutex> _Lock(_Mutex);
+                _Queue = _Queue_pool.create();
+            }
+
+            if (_Queue == nullptr) {
+                _Used[_I].store(false, std::memory_order_release);
+                return 0;
+            }
+
+            _Queues[_I].store(_Queue, std::memory_order_release);
+        }
+
+        _Queue->open();
+        return _I + 1;
+    }
+
+    return 0;
+}
+
+void RemoteFree::release(size_type _Id) noexcept
+{
+    RemoteQueue * _Queue = queue(_Id);
+    if (_Queue == nullptr) {
+        return;
+    }
+
+    // 先关闭再归还编号，之后压入的线程会失败并自行处理
+    _Queue->close();
+    _Used[_Id - 1].store(false, std::memory_order_release);
+}
+
+RemoteQueue * RemoteFree::queue(size_type _Id) noexcept
+{
+    if (_Id == 0 || _Id > MAX_REMOTE_QUEUE_NUM) {
+        return nullptr;
+    }
+
+    return _Queues[_Id - 1].load(std::memory_order_acquire);
+}
+
+void RemoteFree::lock() noexcept
+{
+    _Mutex.lock();
+}
+
+void RemoteFree::unlock() noexcept
+{
+    _Mutex.unlock();
+}
+
+} // namespace WW
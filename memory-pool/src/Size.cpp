@@ -1,72 +1,225 @@
 #include "Size.h"
 
+#include <cstdint>
+
 namespace WW
 {
 
+namespace
+{
+
+/**
+ * 编译期生成查找表
+ * 小于等于1024字节的大小按8字节为粒度查找，其余按128字节为粒度查找，
+ * 每一段粒度内的大小都属于同一个大小类别
+ */
+
+constexpr size_type SMALL_MAX_SIZE = 1024;                                  // 小表覆盖的最大大小
+constexpr size_type SMALL_SHIFT = 3;                                        // 小表粒度位移
+constexpr size_type LARGE_SHIFT = 7;                                        // 大表粒度位移
+constexpr size_type SMALL_TABLE_SIZE = (SMALL_MAX_SIZE >> SMALL_SHIFT) + 1;     // 小表长度
+constexpr size_type LARGE_TABLE_SIZE = (MAX_MEMORY_SIZE >> LARGE_SHIFT) + 1;    // 大表长度
+
+/**
+ * @brief 编译期索引序列
+ */
+template <size_type... _Indexes>
+class IndexSequence
+{
+};
+
+/**
+ * @brief 拼接两个索引序列，第二个序列整体偏移第一个序列的长度
+ */
+template <typename _First, typename _Second>
+class ConcatSequence;
+
+template <size_type... _First, size_type... _Second>
+class ConcatSequence<IndexSequence<_First...>, IndexSequence<_Second...>>
+{
+public:
+    using type = IndexSequence<_First..., (sizeof...(_First) + _Second)...>;
+};
+
+/**
+ * @brief 生成`[0, _Length)`的索引序列
+ * @details 对半拆分，模板递归深度为对数级别
+ */
+template <size_type _Length>
+class MakeIndexSequence
+{
+public:
+    using type = typename ConcatSequence<
+        typename MakeIndexSequence<_Length / 2>::type,
+        typename MakeIndexSequence<_Length - _Length / 2>::type
+    >::type;
+};
+
+template <>
+class MakeIndexSequence<0>
+{
+public:
+    using type = IndexSequence<>;
+};
+
+template <>
+class MakeIndexSequence<1>
+{
+public:
+    using type = IndexSequence<0>;
+};
+
+/**
+ * @brief 查找表
+ */
+template <typename _Value, size_type _Length>
+class Table
+{
+public:
+    _Value values[_Length];
+};
+
+/**
+ * @brief 计算内存块大小所在的数组索引
+ */
+constexpr size_type _Compute_index(size_type _Size) noexcept
+{
+    return _Size == 0 ? 0
+        // 8, 16, ..., 128 → 共16类，索引0~15
+        : _Size <= 128 ? (_Size + 7) / 8 - 1
+        // 144, 160, ..., 1024 → 步长16，共56类，索引16~71
+        : _Size <= 1024 ? 16 + (_Size - 129) / 16
+        // 1152, 1280, ..., 8192 → 步长128，共56类，索引72~127
+        : _Size <= 8192 ? 72 + (_Size - 1025) / 128
+        // 9216, 10240, ..., 65536 → 步长1024，共56类，索引128~183
+        : _Size <= 65536 ? 128 + (_Size - 8193) / 1024
+        // 73728, 81920, ..., 262144 → 步长8192，共24类，索引184~207
+        : 184 + (_Size - 65537) / 8192;
+}
+
+/**
+ * @brief 计算数组索引对应的内存块大小
+ */
+constexpr size_type _Compute_size(size_type _Index) noexcept
+{
+    return _Index <= 15 ? (_Index + 1) * 8
+        : _Index <= 71 ? 128 + 16 * (_Index - 15)
+        : _Index <= 127 ? 1024 + 128 * (_Index - 71)
+        : _Index <= 183 ? 8192 + 1024 * (_Index - 127)
+        : 65536 + 8192 * (_Index - 183);
+}
+
+/**
+ * @brief 计算数组索引对应的每批内存块数量
+ */
+constexpr size_type _Compute_batch(size_type _Index) noexcept
+{
+    return MAX_BATCH_SIZE / _Compute_size(_Index) < MIN_BLOCK_NUM ? MIN_BLOCK_NUM
+        : MAX_BATCH_SIZE / _Compute_size(_Index) > MAX_BLOCK_NUM ? MAX_BLOCK_NUM
+        : MAX_BATCH_SIZE / _Compute_size(_Index);
+}
+
+template <size_type... _Indexes>
+constexpr Table<std::uint8_t, sizeof...(_Indexes)> _Make_small_table(IndexSequence<_Indexes...>) noexcept
+{
+    return {{ static_cast<std::uint8_t>(_Compute_index(_Indexes << SMALL_SHIFT))... }};
+}
+
+template <size_type... _Indexes>
+constexpr Table<std::uint8_t, sizeof...(_Indexes)> _Make_large_table(IndexSequence<_Indexes...>) noexcept
+{
+    return {{ static_cast<std::uint8_t>(_Compute_index(_Indexes << LARGE_SHIFT))... }};
+}
+
+template <size_type... _Indexes>
+constexpr Table<std::uint32_t, sizeof...(_Indexes)> _Make_size_table(IndexSequence<_Indexes...>) noexcept
+{
+    return {{ static_cast<std::uint32_t>(_Compute_size(_Indexes))... }};
+}
+
+template <size_type... _Indexes>
+constexpr Table<std::uint16_t, sizeof...(_Indexes)> _Make_batch_table(IndexSequence<_Indexes...>) noexcept
+{
+    return {{ static_cast<std::uint16_t>(_Compute_batch(_Indexes))... }};
+}
+
+// 8字节粒度的索引表，覆盖[0, 1024]
+constexpr Table<std::uint8_t, SMALL_TABLE_SIZE> SMALL_INDEX_TABLE =
+    _Make_small_table(MakeIndexSequence<SMALL_TABLE_SIZE>::type());
+
+// 128字节粒度的索引表，覆盖(1024, 262144]
+constexpr Table<std::uint8_t, LARGE_TABLE_SIZE> LARGE_INDEX_TABLE =
+    _Make_large_table(MakeIndexSequence<LARGE_TABLE_SIZE>::type());
+
+// 索引到内存块大小的表
+constexpr Table<std::uint32_t, MAX_ARRAY_SIZE> SIZE_TABLE =
+    _Make_size_table(MakeIndexSequence<MAX_ARRAY_SIZE>::type());
+
+// 索引到每批内存块数量的表
+constexpr Table<std::uint16_t, MAX_ARRAY_SIZE> BATCH_TABLE =
+    _Make_batch_table(MakeIndexSequence<MAX_ARRAY_SIZE>::type());
+
+static_assert(_Compute_index(MAX_MEMORY_SIZE) == MAX_ARRAY_SIZE - 1, "size classes do not match MAX_ARRAY_SIZE");
+static_assert(_Compute_size(MAX_ARRAY_SIZE - 1) == MAX_MEMORY_SIZE, "size classes do not match MAX_MEMORY_SIZE");
+
+/**
+ * @brief 查找内存块大小所在的数组索引
+ */
+inline size_type _Lookup_index(size_type _Size) noexcept
+{
+    if (_Size <= SMALL_MAX_SIZE) {
+        return SMALL_INDEX_TABLE.values[(_Size + (1 << SMALL_SHIFT) - 1) >> SMALL_SHIFT];
+    }
+
+    return LARGE_INDEX_TABLE.values[(_Size + (1 << LARGE_SHIFT) - 1) >> LARGE_SHIFT];
+}
+
+} // namespace
+
 size_type Size::index_to_size(size_type _Index) noexcept
 {
-    if (_Index <= 15) {
-        // 8 * (_Index + 1)
-        return (_Index + 1) * 8;
-    } else if (_Index <= 71) {
-        // 144 + 16 * (_Index - 16)
-        return 128 + 16 * (_Index - 15);
-    } else if (_Index <= 127) {
-        // 1152 + 128 * (_Index - 72)
-        return 1024 + 128 * (_Index - 71);
-    } else if (_Index <= 183) {
-        // 9216 + 1024 * (_Index - 128)
-        return 8192 + 1024 * (_Index - 127);
-    } else if (_Index <= 207) {
-        // 73728 + 8192 * (_Index - 184)
-        return 65536 + 8192 * (_Index - 183);
-    } else {
+    if (_Index >= MAX_ARRAY_SIZE) {
         // 不存在这种情况
         return 0;
     }
+
+    return SIZE_TABLE.values[_Index];
 }
 
 size_type Size::size_to_index(size_type _Size) noexcept
 {
-    if (_Size <= 128) {
-        // 8, 16, ..., 128 → 共16类，索引0~15
-        return (_Size + 7) / 8 - 1;
-    } else if (_Size <= 1024) {
-        // 144, 160, ..., 1024 → 步长16，共56类，索引16~71
-        return 16 + (_Size - 129) / 16;
-    } else if (_Size <= 8192) {
-        // 1152, 1280, ..., 8192 → 步长128，共56类，索引72~127
-        return 72 + (_Size - 1025) / 128;
-    } else if (_Size <= 65536) {
-        // 9216, 10240, ..., 65536 → 步长1024，共56类，索引128~183
-        return 128 + (_Size - 8193) / 1024;
-    } else if (_Size <= 262144) {
-        // 73728, 81920, ..., 262144 → 步长8192，共24类，索引184~207
-        return 184 + (_Size - 65537) / 8192;
-    } else {
+    if (_Size > MAX_MEMORY_SIZE) {
         // 不存在这种情况
         return 0;
     }
+
+    return _Lookup_index(_Size);
+}
+
+size_type Size::batch_size(size_type _Index) noexcept
+{
+    if (_Index >= MAX_ARRAY_SIZE) {
+        // 不存在这种情况
+        return MIN_BLOCK_NUM;
+    }
+
+    return BATCH_TABLE.values[_Index];
 }
 
 size_type Size::round_up(size_type _Size) noexcept
 {
-    if (_Size <= 128) {
-        // [0, 128]，按照8字节对齐
-        return (_Size + 8 - 1) & ~(8 - 1);
-    } else if (_Size <= 1024) {
-        // [129, 1024]，按照16字节对齐
-        return (_Size + 16 - 1) & ~(16 - 1);
-    } else if (_Size <= 8192) {
-        // [1025, 8192]，按照128字节对齐
-        return (_Size + 128 - 1) & ~(128 - 1);
-    } else if (_Size <= 65536) {
-        // [8193, 65536]，按照1024字节对齐
-        return (_Size + 1024 - 1) & ~(1024 - 1);
-    } else {
-        // [65537, 262144]，按照8192字节对齐
-        return (_Size + 8192 - 1) & ~(8192 - 1);
+    if (_Size > MAX_MEMORY_SIZE) {
+        // 超出管理范围，按照8192字节对齐
+        return (_Size + 8192 - 1) & ~static_cast<size_type>(8192 - 1);
     }
+
+    return SIZE_TABLE.values[_Lookup_index(_Size)];
+}
+
+SizeClass Size::size_to_class(size_type _Size) noexcept
+{
+    size_type _Index = _Lookup_index(_Size);
+    return SizeClass{ _Index, SIZE_TABLE.values[_Index] };
 }
 
-} // namespace WW
\ No newline at end of file
+} // namespace WW
@@ -4,12 +4,23 @@ namespace WW
 {
 
 Span::Span()
+    : Span(0)
+{
+}
+
+Span::Span(size_type _Node)
     : _Free_list()
     , _Page_id(0)
     , _Prev(nullptr)
     , _Next(nullptr)
     , _Page_count(0)
     , _Used(0)
+    , _Is_use(false)
+    , _Object_size(0)
+    , _Is_released(false)
+    , _Is_large(false)
+    , _Owner(0)
+    , _Node(_Node)
 {
 }
 
@@ -63,6 +74,61 @@ void Span::set_used(size_type _Used) noexcept
     this->_Used = _Used;
 }
 
+bool Span::is_use() const noexcept
+{
+    return _Is_use;
+}
+
+void Span::set_use(bool _Is_use) noexcept
+{
+    this->_Is_use = _Is_use;
+}
+
+size_type Span::object_size() const noexcept
+{
+    return _Object_size;
+}
+
+void Span::set_object_size(size_type _Object_size) noexcept
+{
+    this->_Object_size = _Object_size;
+}
+
+bool Span::is_large() const noexcept
+{
+    return _Is_large;
+}
+
+void Span::set_large(bool _Is_large) noexcept
+{
+    this->_Is_large = _Is_large;
+}
+
+bool Span::is_released() const noexcept
+{
+    return _Is_released;
+}
+
+void Span::set_released(bool _Is_released) noexcept
+{
+    this->_Is_released = _Is_released;
+}
+
+size_type Span::owner() const noexcept
+{
+    return _Owner.load(std::memory_order_relaxed);
+}
+
+void Span::set_owner(size_type _Owner) noexcept
+{
+    this->_Owner.store(_Owner, std::memory_order_relaxed);
+}
+
+size_type Span::node() const noexcept
+{
+    return _Node;
+}
+
 FreeList * Span::get_free_list() noexcept
 {
     return &_Free_list;
@@ -166,6 +232,15 @@ void SpanList::push_front(Span * _Span) noexcept
     _Head.set_next(_Span);
 }
 
+void SpanList::push_back(Span * _Span) noexcept
+{
+    Span * _Prev = _Head.prev();
+    _Span->set_prev(_Prev);
+    _Span->set_next(&_Head);
+    _Prev->set_next(_Span);
+    _Head.set_prev(_Span);
+}
+
 void SpanList::pop_front() noexcept
 {
     Span * _Front = _Head.next();
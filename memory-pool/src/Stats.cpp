@@ -0,0 +1,279 @@
+#include "Stats.h"
+
+#include <new>
+#include <cstdio>
+
+#include <ThreadCache.h>
+#include <CentralCache.h>
+#include <CpuCache.h>
+#include <Platform.h>
+#include <Size.h>
+#include <Numa.h>
+
+namespace WW
+{
+
+namespace
+{
+
+/**
+ * @brief 登记到登记表中的线程统计
+ * @details 作为线程局部变量，构造时登记，线程退出时删除
+ */
+class ThreadStatsEntry
+{
+public:
+    ThreadStats stats;          // 线程统计
+
+public:
+    ThreadStatsEntry()
+        : stats()
+    {
+        StatsRegistry::get_stats_registry().add(&stats);
+    }
+
+    ~ThreadStatsEntry()
+    {
+        StatsRegistry::get_stats_registry().remove(&stats);
+    }
+};
+
+/**
+ * @brief 将字节数格式化为便于阅读的字符串
+ */
+void _Append_bytes(std::string & _Out, const char * _Name, size_type _Bytes)
+{
+    char _Buffer[128];
+    std::snprintf(_Buffer, sizeof(_Buffer), "%-28s %16zu (%10.1f MiB)\n",
+        _Name, _Bytes, static_cast<double>(_Bytes) / (1024.0 * 1024.0));
+    _Out += _Buffer;
+}
+
+} // namespace
+
+StatsCounter::StatsCounter() noexcept
+    : _Value(0)
+{
+}
+
+ThreadStats::ThreadStats()
+    : allocate_count()
+    , deallocate_count()
+    , thread_cached()
+    , fetch_count()
+    , return_count()
+    , underflow_count()
+    , overflow_count()
+    , remote_free_count()
+    , large_allocate_count()
+    , large_deallocate_count()
+    , _Prev(nullptr)
+    , _Next(nullptr)
+{
+}
+
+ThreadStats & ThreadStats::get_thread_stats()
+{
+    static thread_local ThreadStatsEntry _Entry;
+    return _Entry.stats;
+}
+
+void ThreadStats::merge(const ThreadStats & _Other) noexcept
+{
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        allocate_count[_I].add(_Other.allocate_count[_I].load());
+        deallocate_count[_I].add(_Other.deallocate_count[_I].load());
+        thread_cached[_I].add(_Other.thread_cached[_I].load());
+        fetch_count[_I].add(_Other.fetch_count[_I].load());
+        return_count[_I].add(_Other.return_count[_I].load());
+        underflow_count[_I].add(_Other.underflow_count[_I].load());
+        overflow_count[_I].add(_Other.overflow_count[_I].load());
+        remote_free_count[_I].add(_Other.remote_free_count[_I].load());
+    }
+
+    large_allocate_count.add(_Other.large_allocate_count.load());
+    large_deallocate_count.add(_Other.large_deallocate_count.load());
+}
+
+StatsRegistry::StatsRegistry()
+    : _Head()
+    , _Retired()
+    , _Mutex()
+{
+    _Head._Next = &_Head;
+    _Head._Prev = &_Head;
+}
+
+StatsRegistry & StatsRegistry::get_stats_registry()
+{
+#ifdef WW_MALLOC_OVERRIDE
+    WW_NEVER_DESTROYED(StatsRegistry, _Instance, ());
+    return *_Instance;
+#else
+    static StatsRegistry _Instance;
+    return _Instance;
+#endif
+}
+
+void StatsRegistry::add(ThreadStats * _Stats) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    ThreadStats * _Next = _Head._Next;
+    _Stats->_Next = _Next;
+    _Stats->_Prev = &_Head;
+    _Next->_Prev = _Stats;
+    _Head._Next = _Stats;
+}
+
+void StatsRegistry::remove(ThreadStats * _Stats) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    _Stats->_Prev->_Next = _Stats->_Next;
+    _Stats->_Next->_Prev = _Stats->_Prev;
+
+    // 保留已退出线程的计数
+    _Retired.merge(*_Stats);
+}
+
+void StatsRegistry::collect(ThreadStats & _Total) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    _Total.merge(_Retired);
+    for (ThreadStats * _Stats = _Head._Next; _Stats != &_Head; _Stats = _Stats->_Next) {
+        _Total.merge(*_Stats);
+    }
+}
+
+void StatsRegistry::lock() noexcept
+{
+    _Mutex.lock();
+}
+
+void StatsRegistry::unlock() noexcept
+{
+    _Mutex.unlock();
+}
+
+MemoryStats get_stats()
+{
+    MemoryStats _Stats = MemoryStats();
+
+    // 合并所有线程的计数
+    ThreadStats _Total;
+    StatsRegistry::get_stats_registry().collect(_Total);
+
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        SizeClassStats & _Class = _Stats.size_classes[_I];
+        _Class.size = Size::index_to_size(_I);
+        _Class.allocate_count = _Total.allocate_count[_I].load();
+        _Class.deallocate_count = _Total.deallocate_count[_I].load();
+        _Class.thread_cached = _Total.thread_cached[_I].load();
+        _Class.fetch_count = _Total.fetch_count[_I].load();
+        _Class.return_count = _Total.return_count[_I].load();
+        _Class.underflow_count = _Total.underflow_count[_I].load();
+        _Class.overflow_count = _Total.overflow_count[_I].load();
+        _Class.remote_free_count = _Total.remote_free_count[_I].load();
+        _Stats.thread_cache_bytes += _Class.thread_cached * _Class.size;
+    }
+
+    _Stats.large_allocate_count = _Total.large_allocate_count.load();
+    _Stats.large_deallocate_count = _Total.large_deallocate_count.load();
+
+    _Stats.thread_cache_limit_bytes = ThreadCacheRegistry::get_thread_cache_registry().max_size();
+
+    // 依次读取各层缓存
+    CpuCache::get_cpu_cache().collect_stats(_Stats);
+    for (size_type _Node = 0; _Node < Numa::get_numa().max_node_count(); ++_Node) {
+        CentralCache::get_central_cache(_Node).collect_stats(_Stats);
+        PageCache::get_page_cache(_Node).collect_stats(_Stats);
+    }
+
+    _Stats.system_allocated_bytes = Platform::system_allocated_size();
+    _Stats.system_reserved_bytes = Platform::system_reserved_size();
+
+    // 从页段中取出的内存块，除去还在各层缓存中的，就是正在使用的
+    for (SizeClassStats & _Class : _Stats.size_classes) {
+        size_type _Cached = _Class.thread_cached + _Class.cpu_cached + _Class.transfer_cached;
+        // 各层不是同一时刻读取的，可能短暂出现缓存多于取出的情况
+        _Class.in_use = _Class.in_use > _Cached ? _Class.in_use - _Cached : 0;
+        _Stats.in_use_bytes += _Class.in_use * _Class.size;
+    }
+
+    return _Stats;
+}
+
+std::string format_stats(const MemoryStats & _Stats)
+{
+    std::string _Out;
+    char _Buffer[256];
+
+    _Out += "------------------------------------------------\n";
+    _Out += "WW-Memory-Pool statistics\n";
+    _Out += "------------------------------------------------\n";
+    _Append_bytes(_Out, "in use by application", _Stats.in_use_bytes);
+    _Append_bytes(_Out, "thread cache free", _Stats.thread_cache_bytes);
+    _Append_bytes(_Out, "thread cache limit", _Stats.thread_cache_limit_bytes);
+    _Append_bytes(_Out, "cpu cache free", _Stats.cpu_cache_bytes);
+    _Append_bytes(_Out, "transfer cache free", _Stats.transfer_cache_bytes);
+    _Append_bytes(_Out, "central cache free", _Stats.central_cache_bytes);
+    _Append_bytes(_Out, "span fragmentation", _Stats.fragmented_bytes);
+    _Append_bytes(_Out, "span cache free", _Stats.span_cache_bytes);
+    _Append_bytes(_Out, "page cache free", _Stats.page_cache_bytes);
+    _Append_bytes(_Out, "page cache released", _Stats.page_cache_released_bytes);
+    _Append_bytes(_Out, "direct mapped", _Stats.direct_mapped_bytes);
+    _Append_bytes(_Out, "system allocated", _Stats.system_allocated_bytes);
+    _Append_bytes(_Out, "system reserved", _Stats.system_reserved_bytes);
+    std::snprintf(_Buffer, sizeof(_Buffer), "%-28s %16zu\n%-28s %16zu\n",
+        "large allocations", _Stats.large_allocate_count,
+        "large deallocations", _Stats.large_deallocate_count);
+    _Out += _Buffer;
+
+    // 只输出使用过的大小
+    _Out += "------------------------------------------------\n";
+    _Out += "class     size     in use   thread      cpu transfer  central  spans  pages     allocs      frees  fetches  returns underflows overflows   remote\n";
+    for (size_type _I = 0; _I < MAX_ARRAY_SIZE; ++_I) {
+        const SizeClassStats & _Class = _Stats.size_classes[_I];
+        if (_Class.allocate_count == 0 && _Class.spans == 0 && _Class.fetch_count == 0) {
+            continue;
+        }
+
+        std::snprintf(_Buffer, sizeof(_Buffer),
+            "%5zu %8zu %10zu %8zu %8zu %8zu %8zu %6zu %6zu %10zu %10zu %8zu %8zu %10zu %9zu %8zu\n",
+            _I, _Class.size, _Class.in_use, _Class.thread_cached, _Class.cpu_cached,
+            _Class.transfer_cached, _Class.central_cached, _Class.spans, _Class.pages,
+            _Class.allocate_count, _Class.deallocate_count, _Class.fetch_count, _Class.return_count,
+            _Class.underflow_count, _Class.overflow_count, _Class.remote_free_count);
+        _Out += _Buffer;
+    }
+
+    // 只输出有空闲页段的页数
+    _Out += "------------------------------------------------\n";
+    _Out += "pages  free spans  released spans\n";
+    for (size_type _I = 0; _I < MAX_PAGE_NUM; ++_I) {
+        if (_Stats.free_spans[_I] == 0) {
+            continue;
+        }
+
+        std::snprintf(_Buffer, sizeof(_Buffer), "%5zu %11zu %15zu\n",
+            _I + 1, _Stats.free_spans[_I], _Stats.released_spans[_I]);
+        _Out += _Buffer;
+    }
+
+    if (_Stats.large_free_spans != 0) {
+        std::snprintf(_Buffer, sizeof(_Buffer), ">%4zu %11zu\n", MAX_PAGE_NUM, _Stats.large_free_spans);
+        _Out += _Buffer;
+    }
+
+    return _Out;
+}
+
+void print_stats()
+{
+    std::string _Text = format_stats(get_stats());
+    std::fputs(_Text.c_str(), stderr);
+}
+
+} // namespace WW
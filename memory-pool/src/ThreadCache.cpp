@@ -1,23 +1,59 @@
 #include "ThreadCache.h"
 
+#include <new>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
 #include <Size.h>
+#include <CpuCache.h>
+#include <RemoteFree.h>
+#include <Numa.h>
+#include <Trace.h>
+#include <Profiler.h>
 
 namespace WW
 {
 
 ThreadCache::ThreadCache()
     : _Free_lists()
+    , _Overages()
+    , _Cached_size(0)
+    , _Max_cached_size(0)
+    , _Remote_id(0)
+    , _Node(Numa::get_numa().current_node())
+    , _Bytes_until_sample(Profiler::get_profiler().next_sample_interval())
+    , _Hooks(0)
+    , _Stats(ThreadStats::get_thread_stats())
+    , _Prev(nullptr)
+    , _Next(nullptr)
 {
+    // 通过环境变量开始记录时先打开钩子，登记时一起取得
+    Trace::get_trace();
+    ThreadCacheRegistry::get_thread_cache_registry().add(this);
+
+    // 启用远程释放时占用一个队列
+    RemoteFree & _Remote_free = RemoteFree::get_remote_free();
+    if (_Remote_free.enabled()) {
+        _Remote_id = _Remote_free.acquire();
+    }
 }
 
 ThreadCache::~ThreadCache()
 {
+    // 关闭远程释放队列，剩余的内存块归还中心缓存
+    if (_Remote_id != 0) {
+        RemoteFree::get_remote_free().release(_Remote_id);
+    }
+
     // 归还所有内存块
     for (size_type _I = 0; _I < _Free_lists.size(); ++_I) {
         if (!_Free_lists[_I].empty()) {
             _Return_to_central_cache(_I, _Free_lists[_I].size());
         }
     }
+
+    ThreadCacheRegistry::get_thread_cache_registry().remove(this);
 }
 
 ThreadCache & ThreadCache::get_thread_cache()
@@ -27,30 +63,77 @@ ThreadCache & ThreadCache::get_thread_cache()
     return _ThreadCache;
 }
 
+bool ThreadCache::_Hook_enabled(ThreadCacheHook _Hook) const noexcept
+{
+    return (_Hooks.load(std::memory_order_relaxed) & static_cast<unsigned>(_Hook)) != 0;
+}
+
 void * ThreadCache::allocate(size_type _Size) noexcept
+{
+    void * _Ptr = _Allocate(_Size);
+
+    // 记录分配轨迹时在申请之后记录
+    if (_Hook_enabled(ThreadCacheHook::TRACE) && _Ptr != nullptr) {
+        Trace::get_trace().record_allocate(_Ptr, _Size);
+    }
+
+    // 未采样的申请只减少倒计时
+    if (_Size < _Bytes_until_sample) {
+        _Bytes_until_sample -= _Size;
+    } else {
+        _Sample(_Ptr, _Size);
+    }
+
+    return _Ptr;
+}
+
+void ThreadCache::_Sample(void * _Ptr, size_type _Size) noexcept
+{
+    // 先重新计时，采样过程中再次申请内存不会重复进入
+    Profiler & _Profiler = Profiler::get_profiler();
+    _Bytes_until_sample = _Profiler.next_sample_interval();
+    if (_Ptr != nullptr && _Profiler.enabled()) {
+        _Profiler.record_allocate(_Ptr, _Size);
+    }
+}
+
+void * ThreadCache::_Allocate(size_type _Size) noexcept
 {
     if (_Size == 0) {
         return nullptr;
     }
 
     if (_Size > MAX_MEMORY_SIZE) {
-        // 超出管理范围，直接从堆获取
-        return ::operator new(_Size, std::nothrow);
+        // 超出管理范围，直接从页缓存获取
+        return _Allocate_large(_Size);
     }
 
-    // 获取对齐后的大小
-    size_type _Round_size = Size::round_up(_Size);
-    // 找到所在的索引
-    size_type _Index = Size::size_to_index(_Round_size);
+    // 一次查表得到索引和对齐后的大小
+    SizeClass _Class = Size::size_to_class(_Size);
+    size_type _Index = _Class.index;
+    _Stats.allocate_count[_Index].add(1);
+
+    // 启用CPU缓存时优先从当前CPU获取
+    CpuCache & _Cpu_cache = CpuCache::get_cpu_cache();
+    if (_Cpu_cache.enabled() && _Free_lists[_Index].empty()) {
+        void * _Ptr = _Cpu_cache.allocate(_Index, _Class.size);
+        if (_Ptr != nullptr) {
+            return _Ptr;
+        }
+    }
 
-    if (_Free_lists[_Index].empty()) {
-        // 没有这种内存块，需要申请
-        _Fetch_from_central_cache(_Round_size);
+    if (_Free_lists[_Index].empty() && !_Fetch_from_remote_queue(_Index)) {
+        // 没有这种内存块，其他线程也没有归还，需要申请
+        if (_Fetch_from_central_cache(_Index, _Class.size) == 0) {
+            return nullptr;
+        }
     }
 
     // 有这种内存块，取一个出来
     FreeObject * _Obj = _Free_lists[_Index].front();
     _Free_lists[_Index].pop_front();
+    _Cached_size -= _Class.size;
+    _Stats.thread_cached[_Index].sub(1);
     return reinterpret_cast<void *>(_Obj);
 }
 
@@ -60,71 +143,602 @@ void ThreadCache::deallocate(void * _Ptr, size_type _size) noexcept
         return;
     }
 
+    // 记录分配轨迹时在释放之前记录
+    if (_Hook_enabled(ThreadCacheHook::TRACE)) {
+        Trace::get_trace().record_deallocate(_Ptr, _size);
+    }
+
+    if (_Hook_enabled(ThreadCacheHook::PROFILE)) {
+        Profiler::get_profiler().record_deallocate(_Ptr);
+    }
+
     if (_size > MAX_MEMORY_SIZE) {
-        // 从系统释放
-        ::operator delete(_Ptr, std::nothrow);
+        // 归还页缓存
+        _Deallocate_large(PageCache::get_page_cache().object_to_span(_Ptr));
+        return;
+    }
+
+    // 一次查表得到索引和对齐后的大小
+    SizeClass _Class = Size::size_to_class(_size);
+
+#ifndef NDEBUG
+    // 检查调用者提供的大小是否和页段记录的一致
+    Span * _Span = PageCache::get_page_cache().object_to_span(_Ptr);
+    assert(_Span != nullptr && _Span->object_size() == _Class.size);
+#endif
+
+    size_type _Index = _Class.index;
+    _Stats.deallocate_count[_Index].add(1);
+
+    // 启用CPU缓存时优先归还到当前CPU
+    CpuCache & _Cpu_cache = CpuCache::get_cpu_cache();
+    if (_Cpu_cache.enabled() && _Cpu_cache.deallocate(_Ptr, _Index, _Class.size)) {
+        return;
+    }
+
+    // 启用远程释放时归还到申请线程
+    if (RemoteFree::get_remote_free().enabled() && _Push_to_remote_queue(_Ptr, _Index, nullptr)) {
+        return;
+    }
+
+    // 把内存插入自由表
+    FreeObject * _Obj = reinterpret_cast<FreeObject *>(_Ptr);
+    _Free_lists[_Index].push_front(_Obj);
+    _Cached_size += _Class.size;
+    _Stats.thread_cached[_Index].add(1);
+
+    // 检查是否需要归还给中心缓存
+    if (_Should_return(_Index)) {
+        _List_too_long(_Index);
+    }
+
+    // 检查是否超过线程缓存的上限
+    if (_Cached_size > _Max_cached_size.load(std::memory_order_relaxed)) {
+        _Scavenge();
+    }
+}
+
+void ThreadCache::deallocate(void * _Ptr) noexcept
+{
+    if (_Ptr == nullptr) {
+        return;
+    }
+
+    if (_Hook_enabled(ThreadCacheHook::TRACE)) {
+        Trace::get_trace().record_deallocate(_Ptr, 0);
+    }
+
+    if (_Hook_enabled(ThreadCacheHook::PROFILE)) {
+        Profiler::get_profiler().record_deallocate(_Ptr);
+    }
+
+    // 通过页号映射找到所属页段
+    Span * _Span = PageCache::get_page_cache().object_to_span(_Ptr);
+    if (_Span == nullptr) {
+        // 不属于内存池，不应该出现
+        assert(false);
+        return;
+    }
+
+    if (_Span->is_large()) {
+        // 大内存，页段本身就是一个内存块
+        _Deallocate_large(_Span);
+        return;
+    }
+
+    // 页段记录的就是对齐后的大小
+    size_type _Index = Size::size_to_index(_Span->object_size());
+    _Stats.deallocate_count[_Index].add(1);
+
+    // 启用CPU缓存时优先归还到当前CPU
+    CpuCache & _Cpu_cache = CpuCache::get_cpu_cache();
+    if (_Cpu_cache.enabled() && _Cpu_cache.deallocate(_Ptr, _Index, _Span->object_size())) {
+        return;
+    }
+
+    // 启用远程释放时归还到申请线程
+    if (RemoteFree::get_remote_free().enabled() && _Push_to_remote_queue(_Ptr, _Index, _Span)) {
         return;
     }
 
-    // 获取对齐后的大小
-    size_type _Round_size = Size::round_up(_size);
-    // 找到所在的索引
-    size_type _Index = Size::size_to_index(_Round_size);
     // 把内存插入自由表
     FreeObject * _Obj = reinterpret_cast<FreeObject *>(_Ptr);
     _Free_lists[_Index].push_front(_Obj);
+    _Cached_size += _Span->object_size();
+    _Stats.thread_cached[_Index].add(1);
 
     // 检查是否需要归还给中心缓存
     if (_Should_return(_Index)) {
-        _Return_to_central_cache(_Index, _Free_lists[_Index].max_size());
+        _List_too_long(_Index);
+    }
+
+    // 检查是否超过线程缓存的上限
+    if (_Cached_size > _Max_cached_size.load(std::memory_order_relaxed)) {
+        _Scavenge();
+    }
+}
+
+void * ThreadCache::allocate_aligned(size_type _Size, size_type _Alignment) noexcept
+{
+    if (_Alignment == 0 || (_Alignment & (_Alignment - 1)) != 0) {
+        return nullptr;
+    }
+
+    if (_Size == 0) {
+        return nullptr;
+    }
+
+    size_type _Class_size = _Aligned_class_size(_Size, _Alignment);
+    if (_Class_size != 0) {
+        // 有大小是对齐倍数的内存块
+        return allocate(_Class_size);
+    }
+
+    if (_Size > static_cast<size_type>(-1) - PAGE_SIZE) {
+        return nullptr;
+    }
+
+    // 页段首页对齐，释放时通过页段的标记区分大内存
+    size_type _Pages = (_Size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    size_type _Align_pages = _Alignment > PAGE_SIZE ? _Alignment >> PAGE_SHIFT : 1;
+    Span * _Span = PageCache::get_page_cache(_Node).fetch_aligned_span(_Pages, _Align_pages);
+    if (_Span == nullptr) {
+        return nullptr;
+    }
+
+    _Span->set_object_size(_Pages << PAGE_SHIFT);
+    _Span->set_large(true);
+    _Stats.large_allocate_count.add(1);
+
+    void * _Ptr = Span::id_to_ptr(_Span->page_id());
+    if (_Hook_enabled(ThreadCacheHook::TRACE)) {
+        Trace::get_trace().record_allocate(_Ptr, _Size);
+    }
+
+    if (_Size < _Bytes_until_sample) {
+        _Bytes_until_sample -= _Size;
+    } else {
+        _Sample(_Ptr, _Size);
+    }
+
+    return _Ptr;
+}
+
+void ThreadCache::deallocate_aligned(void * _Ptr, size_type _Size, size_type _Alignment) noexcept
+{
+    if (_Ptr == nullptr) {
+        return;
+    }
+
+    size_type _Class_size = _Aligned_class_size(_Size, _Alignment);
+    if (_Class_size != 0) {
+        deallocate(_Ptr, _Class_size);
+        return;
+    }
+
+    if (_Hook_enabled(ThreadCacheHook::TRACE)) {
+        Trace::get_trace().record_deallocate(_Ptr, _Size);
+    }
+
+    if (_Hook_enabled(ThreadCacheHook::PROFILE)) {
+        Profiler::get_profiler().record_deallocate(_Ptr);
+    }
+
+    // 对齐的大内存需要通过页段归还
+    _Deallocate_large(PageCache::get_page_cache().object_to_span(_Ptr));
+}
+
+void * ThreadCache::reallocate(void * _Ptr, size_type _Old_size, size_type _New_size) noexcept
+{
+    if (_Ptr == nullptr) {
+        return allocate(_New_size);
+    }
+
+    if (_New_size == 0) {
+        deallocate(_Ptr, _Old_size);
+        return nullptr;
+    }
+
+    Span * _Span = PageCache::get_page_cache().object_to_span(_Ptr);
+    assert(_Span != nullptr);
+    size_type _Usable_size = _Span->object_size();
+
+    if (!_Span->is_large()) {
+        // 仍是同一种大小的内存块，之后按新大小释放时也能找到同一个自由表
+        if (_New_size <= MAX_MEMORY_SIZE && Size::round_up(_New_size) == _Usable_size) {
+            return _Ptr;
+        }
+    } else if (_New_size > MAX_MEMORY_SIZE && _New_size <= static_cast<size_type>(-1) - PAGE_SIZE) {
+        // 大内存原地调整页数，不能小于大内存的管理范围
+        size_type _Pages = (_New_size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        if (_Pages << PAGE_SHIFT == _Usable_size ||
+            PageCache::get_page_cache(_Span->node()).resize_span(_Span, _Pages)) {
+            _Span->set_object_size(_Pages << PAGE_SHIFT);
+            return _Ptr;
+        }
+    }
+
+    void * _New_ptr = allocate(_New_size);
+    if (_New_ptr == nullptr) {
+        return nullptr;
+    }
+
+    std::memcpy(_New_ptr, _Ptr, _Old_size < _New_size ? _Old_size : _New_size);
+    deallocate(_Ptr);
+    return _New_ptr;
+}
+
+size_type ThreadCache::usable_size(void * _Ptr) const noexcept
+{
+    if (_Ptr == nullptr) {
+        return 0;
     }
+
+    Span * _Span = PageCache::get_page_cache().object_to_span(_Ptr);
+    return _Span != nullptr ? _Span->object_size() : 0;
+}
+
+size_type ThreadCache::cached_size() const noexcept
+{
+    return _Cached_size;
+}
+
+size_type ThreadCache::max_cached_size() const noexcept
+{
+    return _Max_cached_size.load(std::memory_order_relaxed);
+}
+
+void * ThreadCache::_Allocate_large(size_type _Size) noexcept
+{
+    if (_Size > static_cast<size_type>(-1) - PAGE_SIZE) {
+        // 页数计算会溢出
+        return nullptr;
+    }
+
+    size_type _Pages = (_Size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    Span * _Span = PageCache::get_page_cache(_Node).fetch_span(_Pages);
+    if (_Span == nullptr) {
+        return nullptr;
+    }
+
+    // 记录整个页段的大小，释放时通过标记区分大内存
+    _Span->set_object_size(_Pages << PAGE_SHIFT);
+    _Span->set_large(true);
+    _Stats.large_allocate_count.add(1);
+
+    return Span::id_to_ptr(_Span->page_id());
+}
+
+void ThreadCache::_Deallocate_large(Span * _Span) noexcept
+{
+    assert(_Span != nullptr && _Span->is_large());
+
+    _Stats.large_deallocate_count.add(1);
+    _Span->set_object_size(0);
+    _Span->set_large(false);
+    // 归还到页段所属节点的页缓存
+    PageCache::get_page_cache(_Span->node()).return_span(_Span);
+}
+
+size_type ThreadCache::_Aligned_class_size(size_type _Size, size_type _Alignment) noexcept
+{
+    if (_Alignment > PAGE_SIZE || _Size > MAX_MEMORY_SIZE) {
+        return 0;
+    }
+
+    // 从对齐后的大小开始，找到第一个大小是对齐倍数的内存块
+    size_type _Aligned_size = (_Size + _Alignment - 1) & ~(_Alignment - 1);
+    while (_Aligned_size <= MAX_MEMORY_SIZE) {
+        size_type _Class_size = Size::round_up(_Aligned_size);
+        if ((_Class_size & (_Alignment - 1)) == 0) {
+            return _Class_size;
+        }
+
+        _Aligned_size = (_Class_size + _Alignment) & ~(_Alignment - 1);
+    }
+
+    return 0;
 }
 
 bool ThreadCache::_Should_return(size_type _Index) const noexcept
 {
-    // 超过一次申请的最大数量的两倍，归还一半
-    if (_Free_lists[_Index].size() >= _Free_lists[_Index].max_size() * 2) {
+    // 超过最大长度就归还
+    if (_Free_lists[_Index].size() > _Free_lists[_Index].max_size()) {
         return true;
     }
 
     return false;
 }
 
-void ThreadCache::_Fetch_from_central_cache(size_type _Size) noexcept
+bool ThreadCache::_Fetch_from_remote_queue(size_type _Index) noexcept
+{
+    RemoteQueue * _Queue = RemoteFree::get_remote_free().queue(_Remote_id);
+    if (_Queue == nullptr) {
+        return false;
+    }
+
+    FreeObject * _Begin = nullptr;
+    FreeObject * _End = nullptr;
+    size_type _Count = _Queue->pop_all(_Index, _Begin, _End);
+    if (_Count == 0) {
+        return false;
+    }
+
+    // 整段拼接到自由表，超出最大长度的部分在之后释放时归还
+    _Free_lists[_Index].push_range(_Begin, _End, _Count);
+    _Cached_size += _Count * Size::index_to_size(_Index);
+    _Stats.thread_cached[_Index].add(_Count);
+    return true;
+}
+
+bool ThreadCache::_Push_to_remote_queue(void * _Ptr, size_type _Index, Span * _Span) noexcept
+{
+    if (_Span == nullptr) {
+        _Span = PageCache::get_page_cache().object_to_span(_Ptr);
+        if (_Span == nullptr) {
+            return false;
+        }
+    }
+
+    size_type _Owner = _Span->owner();
+    if (_Owner == 0 || _Owner == _Remote_id) {
+        return false;
+    }
+
+    RemoteQueue * _Queue = RemoteFree::get_remote_free().queue(_Owner);
+    if (_Queue == nullptr || !_Queue->push(_Index, reinterpret_cast<FreeObject *>(_Ptr))) {
+        return false;
+    }
+
+    _Stats.remote_free_count[_Index].add(1);
+    return true;
+}
+
+void ThreadCache::_Scavenge() noexcept
 {
-    // 每次申请按照最大数量申请，并且提升最大数量
-    size_type _Index = Size::size_to_index(_Size);
-    size_type _Count = _Free_lists[_Index].max_size();
-    if (_Count > MAX_BLOCK_NUM) {
-        _Count = MAX_BLOCK_NUM;
+    // 每个自由表归还一半，常用的自由表很快会重新获取
+    for (size_type _I = 0; _I < _Free_lists.size(); ++_I) {
+        size_type _Size = _Free_lists[_I].size();
+        if (_Size != 0) {
+            _Return_to_central_cache(_I, (_Size + 1) / 2);
+        }
     }
 
-    FreeObject * _Obj = CentralCache::get_central_cache().fetch_range(_Size, _Count);
-    FreeObject * _Cur = _Obj;
-    
-    while (_Cur != nullptr) {
-        FreeObject * _Next = _Cur->next();
-        _Free_lists[_Index].push_front(_Cur);
-        _Cur = _Next;
+    ThreadCacheRegistry::get_thread_cache_registry().steal(this);
+}
+
+size_type ThreadCache::_Fetch_from_central_cache(size_type _Index, size_type _Size) noexcept
+{
+    // 每次最多申请一批，最大长度还没有达到一批时按照最大长度申请
+    size_type _Batch = Size::batch_size(_Index);
+    size_type _Max_size = _Free_lists[_Index].max_size();
+    size_type _Count = _Max_size < _Batch ? _Max_size : _Batch;
+
+    FreeObject * _Begin = nullptr;
+    FreeObject * _End = nullptr;
+    // 记录页段的所属线程，其他线程释放其中的内存块时归还到这里
+    size_type _Fetched = CentralCache::get_central_cache(_Node).fetch_range(_Size, _Count, _Begin, _End, _Remote_id);
+    if (_Fetched == 0) {
+        // 系统内存不足
+        return 0;
     }
 
-    // 提升最大数量
-    _Free_lists[_Index].set_max_size(_Count + 1);
+    // 整段拼接到自由表
+    _Free_lists[_Index].push_range(_Begin, _End, _Fetched);
+    _Cached_size += _Fetched * _Size;
+    _Stats.thread_cached[_Index].add(_Fetched);
+    _Stats.underflow_count[_Index].add(1);
+
+    // 持续缺少时最大长度成倍增长，直到一批数量的若干倍
+    size_type _Limit = _Batch * MAX_LIST_BATCH_NUM;
+    _Max_size = _Max_size * 2 < _Limit ? _Max_size * 2 : _Limit;
+    _Free_lists[_Index].set_max_size(_Max_size);
+
+    return _Fetched;
+}
+
+void ThreadCache::_List_too_long(size_type _Index) noexcept
+{
+    _Stats.overflow_count[_Index].add(1);
+
+    // 归还一批
+    size_type _Batch = Size::batch_size(_Index);
+    _Return_to_central_cache(_Index, _Batch);
+
+    size_type _Max_size = _Free_lists[_Index].max_size();
+    if (_Max_size < _Batch) {
+        // 还没有达到一批，说明释放多于申请，缓慢增长
+        _Free_lists[_Index].set_max_size(_Max_size + 1);
+    } else if (_Max_size > _Batch) {
+        // 连续超长多次，说明缓存的内存块用不完，缩短一批
+        if (++_Overages[_Index] > MAX_LIST_OVERAGES) {
+            _Free_lists[_Index].set_max_size(_Max_size - _Batch);
+            _Overages[_Index] = 0;
+        }
+    }
 }
 
 void ThreadCache::_Return_to_central_cache(size_type _Index, size_type _Nums) noexcept
 {
     // 取出nums个内存块组成链表
-    FreeObject * _Head = nullptr;
+    FreeObject * _Begin = nullptr;
+    FreeObject * _End = nullptr;
+    size_type _Count = _Free_lists[_Index].pop_range(_Nums, _Begin, _End);
+    size_type _Size = Size::index_to_size(_Index);
+    _Cached_size -= _Count * _Size;
+    _Stats.thread_cached[_Index].sub(_Count);
+
+    CentralCache::get_central_cache(_Node).return_range(_Size, _Begin, _End, _Count);
+}
 
-    for (size_type _I = 0; _I < _Nums; ++_I) {
-        FreeObject * _Obj = _Free_lists[_Index].front();
-        _Free_lists[_Index].pop_front();
-        _Obj->set_next(_Head);
-        _Head = _Obj;
+ThreadCacheRegistry::ThreadCacheRegistry()
+    : _Head(nullptr)
+    , _Next_steal(nullptr)
+    , _Max_size(DEFAULT_THREAD_CACHE_SIZE)
+    , _Unclaimed_size(0)
+    , _Hooks(0)
+    , _Mutex()
+{
+    const char * _Env = std::getenv("WW_THREAD_CACHE_SIZE");
+    if (_Env != nullptr) {
+        char * _End = nullptr;
+        unsigned long long _Value = std::strtoull(_Env, &_End, 10);
+        if (_End != _Env && *_End == '\0') {
+            _Max_size = static_cast<size_type>(_Value);
+        }
+    }
+
+    _Unclaimed_size = static_cast<std::ptrdiff_t>(_Max_size);
+}
+
+ThreadCacheRegistry & ThreadCacheRegistry::get_thread_cache_registry()
+{
+#ifdef WW_MALLOC_OVERRIDE
+    WW_NEVER_DESTROYED(ThreadCacheRegistry, _Instance, ());
+    return *_Instance;
+#else
+    static ThreadCacheRegistry _Instance;
+    return _Instance;
+#endif
+}
+
+void ThreadCacheRegistry::add(ThreadCache * _Cache) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    // 总量不足时也保证最小上限
+    _Cache->_Max_cached_size.store(MIN_THREAD_CACHE_SIZE, std::memory_order_relaxed);
+    _Cache->_Hooks.store(_Hooks, std::memory_order_relaxed);
+    _Unclaimed_size -= static_cast<std::ptrdiff_t>(MIN_THREAD_CACHE_SIZE);
+
+    _Cache->_Prev = nullptr;
+    _Cache->_Next = _Head;
+    if (_Head != nullptr) {
+        _Head->_Prev = _Cache;
+    }
+    _Head = _Cache;
+}
+
+void ThreadCacheRegistry::remove(ThreadCache * _Cache) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    _Unclaimed_size += static_cast<std::ptrdiff_t>(_Cache->_Max_cached_size.load(std::memory_order_relaxed));
+
+    if (_Next_steal == _Cache) {
+        _Next_steal = _Cache->_Next;
+    }
+
+    if (_Cache->_Prev != nullptr) {
+        _Cache->_Prev->_Next = _Cache->_Next;
+    } else {
+        _Head = _Cache->_Next;
+    }
+
+    if (_Cache->_Next != nullptr) {
+        _Cache->_Next->_Prev = _Cache->_Prev;
+    }
+}
+
+void ThreadCacheRegistry::steal(ThreadCache * _Cache) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    constexpr std::ptrdiff_t _Steal_size = static_cast<std::ptrdiff_t>(THREAD_CACHE_STEAL_SIZE);
+    if (_Unclaimed_size >= _Steal_size) {
+        // 还有未分配的内存
+        _Unclaimed_size -= _Steal_size;
+        _Cache->_Max_cached_size.fetch_add(THREAD_CACHE_STEAL_SIZE, std::memory_order_relaxed);
+        return;
+    }
+
+    // 轮流从其他线程获取，避免总是减小同一个线程的上限
+    for (size_type _I = 0; _I < MAX_STEAL_TRIES; ++_I) {
+        if (_Next_steal == nullptr) {
+            _Next_steal = _Head;
+        }
+
+        ThreadCache * _Victim = _Next_steal;
+        _Next_steal = _Victim->_Next;
+        if (_Victim == _Cache) {
+            continue;
+        }
+
+        size_type _Victim_size = _Victim->_Max_cached_size.load(std::memory_order_relaxed);
+        if (_Victim_size < MIN_THREAD_CACHE_SIZE + THREAD_CACHE_STEAL_SIZE) {
+            continue;
+        }
+
+        _Victim->_Max_cached_size.store(_Victim_size - THREAD_CACHE_STEAL_SIZE, std::memory_order_relaxed);
+        _Cache->_Max_cached_size.fetch_add(THREAD_CACHE_STEAL_SIZE, std::memory_order_relaxed);
+        return;
+    }
+}
+
+size_type ThreadCacheRegistry::max_size() noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+    return _Max_size;
+}
+
+void ThreadCacheRegistry::set_max_size(size_type _Size) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    size_type _Claimed = 0;
+    for (ThreadCache * _Cache = _Head; _Cache != nullptr; _Cache = _Cache->_Next) {
+        _Claimed += _Cache->_Max_cached_size.load(std::memory_order_relaxed);
+    }
+
+    // 已分配的上限超出新的总量时按比例缩小
+    if (_Claimed > _Size) {
+        double _Ratio = static_cast<double>(_Size) / static_cast<double>(_Claimed);
+        _Claimed = 0;
+        for (ThreadCache * _Cache = _Head; _Cache != nullptr; _Cache = _Cache->_Next) {
+            size_type _Cache_size = static_cast<size_type>(
+                static_cast<double>(_Cache->_Max_cached_size.load(std::memory_order_relaxed)) * _Ratio);
+            if (_Cache_size < MIN_THREAD_CACHE_SIZE) {
+                _Cache_size = MIN_THREAD_CACHE_SIZE;
+            }
+
+            _Cache->_Max_cached_size.store(_Cache_size, std::memory_order_relaxed);
+            _Claimed += _Cache_size;
+        }
+    }
+
+    _Max_size = _Size;
+    _Unclaimed_size = static_cast<std::ptrdiff_t>(_Size) - static_cast<std::ptrdiff_t>(_Claimed);
+}
+
+size_type ThreadCacheRegistry::unclaimed_size() noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+    return _Unclaimed_size > 0 ? static_cast<size_type>(_Unclaimed_size) : 0;
+}
+
+void ThreadCacheRegistry::set_hook(ThreadCacheHook _Hook, bool _Enabled) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    unsigned _Bit = static_cast<unsigned>(_Hook);
+    _Hooks = _Enabled ? _Hooks | _Bit : _Hooks & ~_Bit;
+    for (ThreadCache * _Cache = _Head; _Cache != nullptr; _Cache = _Cache->_Next) {
+        if (_Enabled) {
+            _Cache->_Hooks.fetch_or(_Bit, std::memory_order_relaxed);
+        } else {
+            _Cache->_Hooks.fetch_and(~_Bit, std::memory_order_relaxed);
+        }
     }
+}
 
-    CentralCache::get_central_cache().return_range(Size::index_to_size(_Index), _Head);
+void ThreadCacheRegistry::lock() noexcept
+{
+    _Mutex.lock();
+}
+
+void ThreadCacheRegistry::unlock() noexcept
+{
+    _Mutex.unlock();
 }
 
 } // namespace WW
@@ -0,0 +1,403 @@
+#include "Trace.h"
+
+#include <new>
+#include <cstdlib>
+#include <cstring>
+
+#include <ObjectPool.h>
+#include <ThreadCache.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace WW
+{
+
+/**
+ * @brief 线程的事件缓冲区
+ * @details 只有所属线程添加事件，写入文件时加锁，缓冲区不会销毁，线程退出后留给新线程使用
+ */
+class TraceBuffer
+{
+public:
+    TraceEvent events[TRACE_BUFFER_SIZE];   // 事件
+    std::atomic<size_type> count;           // 已添加的事件数
+    size_type flushed;                      // 已写入文件的事件数
+    size_type epoch;                        // 事件属于第几次记录
+    std::uint64_t last_time;                // 上一个事件的时间
+    std::uint16_t thread;                   // 线程编号
+    bool owned;                             // 是否被线程占用
+    std::mutex mutex;                       // 写入文件时加锁
+    TraceBuffer * next;                     // 链表中的下一个缓冲区
+};
+
+/**
+ * @brief 线程退出时写入并交还缓冲区
+ */
+class TraceThreadGuard
+{
+public:
+    TraceThreadGuard() = default;
+
+    ~TraceThreadGuard();
+};
+
+namespace
+{
+
+/**
+ * @brief 轨迹文件头
+ */
+class TraceHeader
+{
+public:
+    char magic[8];                  // 固定为`WWTRACE`
+    std::uint32_t version;          // 格式版本
+    std::uint32_t event_size;       // 每个事件的大小
+};
+
+constexpr char TRACE_MAGIC[8] = "WWTRACE";
+constexpr std::uint32_t TRACE_VERSION = 1;
+
+thread_local TraceBuffer * _Current_buffer = nullptr;   // 当前线程的缓冲区
+thread_local bool _Thread_exited = false;               // 当前线程是否正在退出
+
+/**
+ * @brief 缓冲区的内存池，由`Trace`的锁保护
+ */
+ObjectPool<TraceBuffer> & _Buffer_pool()
+{
+    WW_NEVER_DESTROYED(ObjectPool<TraceBuffer>, _Pool, ());
+    return *_Pool;
+}
+
+/**
+ * @brief 获取单调时间，单位为纳秒
+ */
+std::uint64_t _Now() noexcept
+{
+#if defined(__linux__)
+    timespec _Time;
+    clock_gettime(CLOCK_MONOTONIC, &_Time);
+    return static_cast<std::uint64_t>(_Time.tv_sec) * 1000000000ULL + static_cast<std::uint64_t>(_Time.tv_nsec);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief 写入全部内容
+ */
+bool _Write_all(int _Fd, const void * _Data, size_type _Size) noexcept
+{
+#if defined(__linux__)
+    const char * _Cursor = static_cast<const char *>(_Data);
+    while (_Size > 0) {
+        ssize_t _Written = ::write(_Fd, _Cursor, _Size);
+        if (_Written <= 0) {
+            return false;
+        }
+        _Cursor += _Written;
+        _Size -= static_cast<size_type>(_Written);
+    }
+    return true;
+#else
+    (void)_Fd;
+    (void)_Data;
+    (void)_Size;
+    return false;
+#endif
+}
+
+} // namespace
+
+TraceThreadGuard::~TraceThreadGuard()
+{
+    TraceBuffer * _Buffer = _Current_buffer;
+    _Current_buffer = nullptr;
+    _Thread_exited = true;
+    if (_Buffer == nullptr) {
+        return;
+    }
+
+    Trace & _Trace = Trace::get_trace();
+    _Buffer->mutex.lock();
+    _Trace._Flush(_Buffer);
+    _Buffer->mutex.unlock();
+
+    // 之后的新线程可以继续使用
+    std::lock_guard<std::mutex> _Lock(_Trace._Mutex);
+    _Buffer->owned = false;
+}
+
+Trace::Trace()
+    : _Enabled(false)
+    , _Epoch(0)
+    , _Thread_count(0)
+    , _Start(0)
+    , _Fd(-1)
+    , _Buffers(nullptr)
+    , _Mutex()
+{
+    // 通过环境变量开始记录
+    const char * _Env = std::getenv("WW_TRACE");
+    if (_Env != nullptr && _Env[0] != '\0') {
+        start(_Env);
+    }
+}
+
+Trace & Trace::get_trace()
+{
+    WW_NEVER_DESTROYED(Trace, _Instance, ());
+    return *_Instance;
+}
+
+bool Trace::enabled() const noexcept
+{
+    return _Enabled.load(std::memory_order_relaxed);
+}
+
+bool Trace::start(const char * _Path) noexcept
+{
+#if defined(__linux__)
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+    if (_Fd >= 0) {
+        return false;
+    }
+
+    int _File = ::open(_Path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (_File < 0) {
+        return false;
+    }
+
+    TraceHeader _Header;
+    std::memcpy(_Header.magic, TRACE_MAGIC, sizeof(_Header.magic));
+    _Header.version = TRACE_VERSION;
+    _Header.event_size = sizeof(TraceEvent);
+    if (!_Write_all(_File, &_Header, sizeof(_Header))) {
+        ::close(_File);
+        return false;
+    }
+
+    // 缓冲区发现记录次数变化后丢弃之前的事件
+    _Fd = _File;
+    _Start = _Now();
+    _Epoch.fetch_add(1, std::memory_order_release);
+    _Enabled.store(true, std::memory_order_release);
+    ThreadCacheRegistry::get_thread_cache_registry().set_hook(ThreadCacheHook::TRACE, true);
+    return true;
+#else
+    (void)_Path;
+    return false;
+#endif
+}
+
+void Trace::stop() noexcept
+{
+    TraceBuffer * _Head = nullptr;
+    {
+        std::lock_guard<std::mutex> _Lock(_Mutex);
+        if (_Fd < 0) {
+            return;
+        }
+
+        _Enabled.store(false, std::memory_order_relaxed);
+        ThreadCacheRegistry::get_thread_cache_registry().set_hook(ThreadCacheHook::TRACE, false);
+        _Head = _Buffers;
+    }
+
+    // 缓冲区只会插入到链表头部，不需要持有链表锁遍历
+    for (TraceBuffer * _Buffer = _Head; _Buffer != nullptr; _Buffer = _Buffer->next) {
+        _Buffer->mutex.lock();
+        _Flush(_Buffer);
+        _Buffer->mutex.unlock();
+    }
+
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+#if defined(__linux__)
+    ::close(_Fd);
+#endif
+    _Fd = -1;
+}
+
+void Trace::record_allocate(void * _Ptr, size_type _Size) noexcept
+{
+    // 停止记录时其他线程可能还没有看到钩子关闭
+    if (!enabled()) {
+        return;
+    }
+
+    _Record(TraceEventType::ALLOCATE, _Ptr, _Size);
+}
+
+void Trace::record_deallocate(void * _Ptr, size_type _Size) noexcept
+{
+    if (!enabled()) {
+        return;
+    }
+
+    _Record(TraceEventType::DEALLOCATE, _Ptr, _Size);
+}
+
+bool Trace::load(const char * _Path, std::vector<TraceEvent> & _Events)
+{
+#if defined(__linux__)
+    int _File = ::open(_Path, O_RDONLY | O_CLOEXEC);
+    if (_File < 0) {
+        return false;
+    }
+
+    TraceHeader _Header;
+    bool _Valid = ::read(_File, &_Header, sizeof(_Header)) == static_cast<ssize_t>(sizeof(_Header)) &&
+        std::memcmp(_Header.magic, TRACE_MAGIC, sizeof(_Header.magic)) == 0 &&
+        _Header.version == TRACE_VERSION && _Header.event_size == sizeof(TraceEvent);
+
+    // 按块读取，末尾不完整的事件丢弃
+    TraceEvent _Chunk[TRACE_BUFFER_SIZE];
+    size_type _Pending = 0;
+    while (_Valid) {
+        ssize_t _Length = ::read(_File, reinterpret_cast<char *>(_Chunk) + _Pending, sizeof(_Chunk) - _Pending);
+        if (_Length <= 0) {
+            _Valid = _Length == 0;
+            break;
+        }
+
+        _Pending += static_cast<size_type>(_Length);
+        size_type _Count = _Pending / sizeof(TraceEvent);
+        _Events.insert(_Events.end(), _Chunk, _Chunk + _Count);
+        _Pending -= _Count * sizeof(TraceEvent);
+        std::memmove(_Chunk, _Chunk + _Count, _Pending);
+    }
+
+    ::close(_File);
+    return _Valid;
+#else
+    (void)_Path;
+    (void)_Events;
+    return false;
+#endif
+}
+
+void Trace::lock() noexcept
+{
+    _Mutex.lock();
+}
+
+void Trace::unlock() noexcept
+{
+    _Mutex.unlock();
+}
+
+void Trace::_Record(TraceEventType _Type, void * _Ptr, size_type _Size) noexcept
+{
+    TraceBuffer * _Buffer = _Thread_buffer();
+    if (_Buffer == nullptr) {
+        return;
+    }
+
+    // 重新开始记录后丢弃上次剩余的事件
+    size_type _Current_epoch = _Epoch.load(std::memory_order_acquire);
+    if (_Buffer->epoch != _Current_epoch) {
+        std::lock_guard<std::mutex> _Lock(_Buffer->mutex);
+        _Buffer->count.store(0, std::memory_order_relaxed);
+        _Buffer->flushed = 0;
+        _Buffer->epoch = _Current_epoch;
+        _Buffer->last_time = _Start;
+    }
+
+    std::uint64_t _Time = _Now();
+    std::uint64_t _Delta = _Time > _Buffer->last_time ? _Time - _Buffer->last_time : 0;
+    _Buffer->last_time = _Time;
+
+    TraceEvent _Events[2];
+    size_type _Event_count = 0;
+    if (_Delta > UINT32_MAX) {
+        // 间隔过长，先单独记录时间
+        _Events[_Event_count++] = TraceEvent{ 0, _Delta, 0, _Buffer->thread, static_cast<std::uint16_t>(TraceEventType::TIME) };
+        _Delta = 0;
+    }
+    _Events[_Event_count++] = TraceEvent{ static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(_Ptr)),
+        static_cast<std::uint64_t>(_Size), static_cast<std::uint32_t>(_Delta), _Buffer->thread, static_cast<std::uint16_t>(_Type) };
+
+    for (size_type _I = 0; _I < _Event_count; ++_I) {
+        size_type _Count = _Buffer->count.load(std::memory_order_relaxed);
+        if (_Count == TRACE_BUFFER_SIZE) {
+            // 缓冲区满，整体写入文件
+            std::lock_guard<std::mutex> _Lock(_Buffer->mutex);
+            _Flush(_Buffer);
+            _Buffer->count.store(0, std::memory_order_relaxed);
+            _Buffer->flushed = 0;
+            _Count = 0;
+        }
+
+        _Buffer->events[_Count] = _Events[_I];
+        _Buffer->count.store(_Count + 1, std::memory_order_release);
+    }
+}
+
+TraceBuffer * Trace::_Thread_buffer() noexcept
+{
+    if (_Current_buffer != nullptr) {
+        return _Current_buffer;
+    }
+
+    if (_Thread_exited) {
+        return nullptr;
+    }
+
+    TraceBuffer * _Buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> _Lock(_Mutex);
+
+        // 优先使用已退出线程留下的缓冲区
+        for (TraceBuffer * _Free = _Buffers; _Free != nullptr; _Free = _Free->next) {
+            if (!_Free->owned) {
+                _Buffer = _Free;
+                break;
+            }
+        }
+
+        if (_Buffer == nullptr) {
+            _Buffer = _Buffer_pool().create();
+            if (_Buffer == nullptr) {
+                return nullptr;
+            }
+
+            _Buffer->count.store(0, std::memory_order_relaxed);
+            _Buffer->flushed = 0;
+            _Buffer->next = _Buffers;
+            _Buffers = _Buffer;
+        }
+
+        // 新线程使用新的编号，首个事件时重置
+        _Buffer->owned = true;
+        _Buffer->epoch = static_cast<size_type>(-1);
+        _Buffer->thread = _Thread_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 线程退出时交还缓冲区，注册时可能再次申请内存，需要先设置当前缓冲区
+    _Current_buffer = _Buffer;
+    static thread_local TraceThreadGuard _Guard;
+    (void)&_Guard;
+
+    return _Buffer;
+}
+
+void Trace::_Flush(TraceBuffer * _Buffer) noexcept
+{
+    size_type _Count = _Buffer->count.load(std::memory_order_acquire);
+    if (_Count <= _Buffer->flushed) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+    if (_Fd >= 0 && _Buffer->epoch == _Epoch.load(std::memory_order_relaxed)) {
+        _Write_all(_Fd, _Buffer->events + _Buffer->flushed, (_Count - _Buffer->flushed) * sizeof(TraceEvent));
+    }
+    _Buffer->flushed = _Count;
+}
+
+} // namespace WW
@@ -0,0 +1,116 @@
+#include "TransferCache.h"
+
+namespace WW
+{
+
+TransferCache::TransferCache()
+    : _Batches()
+    , _Size(0)
+    , _Object_count(0)
+    , _Max_object_count(0)
+    , _Mutex()
+{
+}
+
+void TransferCache::set_max_object_count(size_type _Max_object_count) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+    this->_Max_object_count = _Max_object_count;
+}
+
+bool TransferCache::insert(FreeObject * _Begin, FreeObject * _End, size_type _Count) noexcept
+{
+    if (_Count == 0) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    if (_Size == MAX_TRANSFER_NUM || _Object_count + _Count > _Max_object_count) {
+        return false;
+    }
+
+    _Batches[_Size].begin = _Begin;
+    _Batches[_Size].end = _End;
+    _Batches[_Size].count = _Count;
+    ++_Size;
+    _Object_count += _Count;
+
+    return true;
+}
+
+size_type TransferCache::remove(size_type _Count, FreeObject *& _Begin, FreeObject *& _End) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    if (_Size == 0 || _Count == 0) {
+        _Begin = nullptr;
+        _End = nullptr;
+        return 0;
+    }
+
+    Batch & _Batch = _Batches[_Size - 1];
+    _Begin = _Batch.begin;
+
+    if (_Batch.count <= _Count) {
+        // 整批取走
+        _Count = _Batch.count;
+        _End = _Batch.end;
+        --_Size;
+    } else {
+        // 只取前_Count个，剩余部分仍然作为一批
+        FreeObject * _Last = _Begin;
+        for (size_type _I = 1; _I < _Count; ++_I) {
+            _Last = _Last->next();
+        }
+
+        _Batch.begin = _Last->next();
+        _Batch.count -= _Count;
+        _Last->set_next(nullptr);
+        _End = _Last;
+    }
+
+    _Object_count -= _Count;
+
+    return _Count;
+}
+
+size_type TransferCache::remove_all(FreeObject *& _Begin, FreeObject *& _End) noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+
+    _Begin = nullptr;
+    _End = nullptr;
+    for (size_type _I = 0; _I < _Size; ++_I) {
+        // 把每一批接到链表头部
+        _Batches[_I].end->set_next(_Begin);
+        _Begin = _Batches[_I].begin;
+        if (_End == nullptr) {
+            _End = _Batches[_I].end;
+        }
+    }
+
+    size_type _Count = _Object_count;
+    _Size = 0;
+    _Object_count = 0;
+
+    return _Count;
+}
+
+size_type TransferCache::object_count() noexcept
+{
+    std::lock_guard<std::mutex> _Lock(_Mutex);
+    return _Object_count;
+}
+
+void TransferCache::lock() noexcept
+{
+    _Mutex.lock();
+}
+
+void TransferCache::unlock() noexcept
+{
+    _Mutex.unlock();
+}
+
+} // namespace WW
@@ -1,7 +1,11 @@
 #include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <CentralCache.h>
+#include <PageCache.h>
+#include <Stats.h>
+#include <Size.h>
 
 class CentralCacheTest : public testing::Test
 {
@@ -45,7 +49,7 @@ TEST_F(CentralCacheTest, SingleThreadFetchAndReturn)
     EXPECT_EQ(count, 12);
 
     // 归还512个8字节内存块
-    // 此时整个页段完整，应当被直接还给页缓存
+    // 此时整个页段完整，完全空闲的页段不超过上限时留在中心缓存
     central_cache.return_range(8, free_object_512);
 
     // 归还500个16字节内存块
@@ -53,7 +57,7 @@ TEST_F(CentralCacheTest, SingleThreadFetchAndReturn)
     central_cache.return_range(16, free_object_500);
 
     // 归还12个16字节内存块
-    // 此时页段完整，应当被直接还给页缓存
+    // 此时页段完整，同样留在中心缓存的完全空闲链表中
     central_cache.return_range(16, free_object_20);
 }
 
@@ -85,4 +89,106 @@ TEST_F(CentralCacheTest, MultiThreadFetchAndReturn)
     for (int i = 0; i < THREAD_NUM; ++i) {
         threads[i].join();
     }
-}
\ No newline at end of file
+}
+
+TEST_F(CentralCacheTest, TransferCache)
+{
+    // 一个线程整批归还的内存块，另一个线程可以整批取走
+    WW::FreeObject * begin = nullptr;
+    WW::FreeObject * end = nullptr;
+    std::size_t count = central_cache.fetch_range(48, 100, begin, end);
+    ASSERT_EQ(count, 100);
+    EXPECT_EQ(end->next(), nullptr);
+
+    central_cache.return_range(48, begin, end, count);
+
+    std::thread([&]() {
+        WW::FreeObject * other_begin = nullptr;
+        WW::FreeObject * other_end = nullptr;
+
+        // 只取一部分，剩余部分留在传输缓存中
+        EXPECT_EQ(central_cache.fetch_range(48, 30, other_begin, other_end), 30);
+        EXPECT_EQ(other_begin, begin);
+        EXPECT_EQ(other_end->next(), nullptr);
+        central_cache.return_range(48, other_begin);
+
+        EXPECT_EQ(central_cache.fetch_range(48, 100, other_begin, other_end), 70);
+        EXPECT_EQ(other_end, end);
+        central_cache.return_range(48, other_begin);
+    }).join();
+}
+
+TEST_F(CentralCacheTest, FlushTransferCaches)
+{
+    // 整批归还的内存块留在传输缓存中
+    constexpr std::size_t SIZE = 1024;
+    std::size_t index = WW::Size::size_to_index(SIZE);
+    WW::FreeObject * begin = nullptr;
+    WW::FreeObject * end = nullptr;
+    std::size_t count = central_cache.fetch_range(SIZE, 100, begin, end);
+    ASSERT_EQ(count, 100);
+    central_cache.return_range(SIZE, begin, end, count);
+
+    WW::MemoryStats stats = WW::get_stats();
+    EXPECT_EQ(stats.size_classes[index].transfer_cached, 100);
+    EXPECT_GE(stats.transfer_cache_bytes, 100 * SIZE);
+
+    // 向系统归还内存时先清空传输缓存，内存块回到页段中
+    WW::PageCache::get_page_cache().release_free_memory();
+    stats = WW::get_stats();
+    EXPECT_EQ(stats.size_classes[index].transfer_cached, 0);
+    EXPECT_EQ(stats.size_classes[index].in_use, 0);
+    EXPECT_EQ(stats.size_classes[index].spans, 0);
+}
+
+TEST_F(CentralCacheTest, SpanLists)
+{
+    // 8K的内存块每个页段128页，切出64个
+    constexpr std::size_t SIZE = 8192;
+    constexpr std::size_t BLOCK_NUM = WW::MAX_PAGE_NUM * WW::PAGE_SIZE / SIZE;
+    std::size_t index = WW::Size::size_to_index(SIZE);
+    std::size_t spans = WW::get_stats().size_classes[index].spans;
+
+    // 取空两个页段
+    std::vector<WW::FreeObject *> first;
+    std::vector<WW::FreeObject *> second;
+    for (WW::FreeObject * head = central_cache.fetch_range(SIZE, BLOCK_NUM); head != nullptr; head = head->next()) {
+        first.emplace_back(head);
+    }
+    for (WW::FreeObject * head = central_cache.fetch_range(SIZE, BLOCK_NUM); head != nullptr; head = head->next()) {
+        second.emplace_back(head);
+    }
+    ASSERT_EQ(first.size(), BLOCK_NUM);
+    ASSERT_EQ(second.size(), BLOCK_NUM);
+    EXPECT_EQ(WW::get_stats().size_classes[index].spans, spans + 2);
+
+    // 第一个页段归还一半，第二个页段只归还一个
+    for (std::size_t i = 0; i < BLOCK_NUM / 2; ++i) {
+        first[i]->set_next(nullptr);
+        central_cache.return_range(SIZE, first[i]);
+    }
+    second[0]->set_next(nullptr);
+    central_cache.return_range(SIZE, second[0]);
+
+    // 优先从空闲最少的页段中获取
+    WW::FreeObject * fetched = central_cache.fetch_range(SIZE, 1);
+    EXPECT_EQ(fetched, second[0]);
+    fetched->set_next(nullptr);
+    central_cache.return_range(SIZE, fetched);
+
+    // 全部归还
+    for (std::size_t i = BLOCK_NUM / 2; i < BLOCK_NUM; ++i) {
+        first[i]->set_next(nullptr);
+        central_cache.return_range(SIZE, first[i]);
+    }
+    for (std::size_t i = 1; i < BLOCK_NUM; ++i) {
+        second[i]->set_next(nullptr);
+        central_cache.return_range(SIZE, second[i]);
+    }
+    EXPECT_EQ(WW::get_stats().size_classes[index].in_use, 0);
+
+    // 完全空闲的页段在上限内留在中心缓存，向系统归还内存时还给页缓存
+    EXPECT_GT(WW::get_stats().size_classes[index].spans, 0);
+    WW::PageCache::get_page_cache().release_free_memory();
+    EXPECT_EQ(WW::get_stats().size_classes[index].spans, 0);
+}
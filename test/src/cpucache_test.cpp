@@ -0,0 +1,125 @@
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <ThreadCache.h>
+#include <CpuCache.h>
+#include <Stats.h>
+#include <Size.h>
+
+class CpuCacheTest : public testing::Test
+{
+public:
+    WW::CpuCache & cpu_cache = WW::CpuCache::get_cpu_cache();
+
+protected:
+    void SetUp() override
+    {
+        if (!cpu_cache.set_enabled(true)) {
+            GTEST_SKIP() << "rseq is not available";
+        }
+    }
+
+    void TearDown() override
+    {
+        cpu_cache.set_enabled(false);
+    }
+};
+
+TEST_F(CpuCacheTest, AllocateAndDeallocate)
+{
+    // 归还到当前CPU后可以马上取回
+    void * ptr = cpu_cache.allocate(0, 8);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_TRUE(cpu_cache.deallocate(ptr, 0, 8));
+
+    void * again = cpu_cache.allocate(0, 8);
+    EXPECT_EQ(again, ptr);
+    EXPECT_TRUE(cpu_cache.deallocate(again, 0, 8));
+
+    // 超过容量时一半归还中心缓存，不会失败
+    std::vector<void *> ptrs;
+    for (int i = 0; i < 1000; ++i) {
+        void * p = cpu_cache.allocate(1, 16);
+        ASSERT_NE(p, nullptr);
+        ptrs.emplace_back(p);
+    }
+    for (void * p : ptrs) {
+        EXPECT_TRUE(cpu_cache.deallocate(p, 1, 16));
+    }
+
+    // 大内存块不经过CPU缓存，直接在中心缓存申请和归还
+    void * large = cpu_cache.allocate(WW::MAX_ARRAY_SIZE - 1, WW::MAX_MEMORY_SIZE);
+    ASSERT_NE(large, nullptr);
+    EXPECT_TRUE(cpu_cache.deallocate(large, WW::MAX_ARRAY_SIZE - 1, WW::MAX_MEMORY_SIZE));
+}
+
+TEST_F(CpuCacheTest, LargeObjectsSkipThreadCache)
+{
+    // 启用CPU缓存后大内存块不会留在线程缓存中
+    constexpr std::size_t SIZE = 64 * 1024;
+    std::size_t index = WW::Size::size_to_index(SIZE);
+    WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+
+    std::vector<void *> ptrs;
+    for (int i = 0; i < 16; ++i) {
+        void * ptr = thread_cache.allocate(SIZE);
+        ASSERT_NE(ptr, nullptr);
+        ptrs.emplace_back(ptr);
+    }
+    for (void * ptr : ptrs) {
+        thread_cache.deallocate(ptr, SIZE);
+    }
+
+    EXPECT_EQ(WW::get_stats().size_classes[index].thread_cached, 0);
+}
+
+TEST_F(CpuCacheTest, MultiThreadAllocateAndDeallocate)
+{
+    constexpr int THREAD_NUM = 8;
+    constexpr int COUNT = 2000;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<void *>> ptrs(THREAD_NUM);
+
+    for (int i = 0; i < THREAD_NUM; ++i) {
+        threads.emplace_back([i, &ptrs]() {
+            WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+            for (int round = 0; round < 10; ++round) {
+                for (int j = 0; j < COUNT; ++j) {
+                    void * ptr = thread_cache.allocate(64);
+                    ASSERT_NE(ptr, nullptr);
+                    // 写入内存，重复分配会被其他线程覆盖
+                    *static_cast<int *>(ptr) = i;
+                    ptrs[i].emplace_back(ptr);
+                }
+                for (void * ptr : ptrs[i]) {
+                    EXPECT_EQ(*static_cast<int *>(ptr), i);
+                    thread_cache.deallocate(ptr, 64);
+                }
+                ptrs[i].clear();
+            }
+
+            for (int j = 0; j < COUNT; ++j) {
+                ptrs[i].emplace_back(thread_cache.allocate(64));
+            }
+        });
+    }
+
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    // 同时存活的内存块不能重复
+    std::set<void *> unique;
+    for (auto & thread_ptrs : ptrs) {
+        for (void * ptr : thread_ptrs) {
+            EXPECT_TRUE(unique.insert(ptr).second);
+        }
+    }
+
+    WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+    for (void * ptr : unique) {
+        thread_cache.deallocate(ptr, 64);
+    }
+}
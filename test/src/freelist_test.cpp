@@ -0,0 +1,50 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <FreeList.h>
+
+TEST(FreeListTest, PushAndPopRange)
+{
+    constexpr std::size_t COUNT = 10;
+    std::vector<WW::FreeObject> objects(COUNT);
+
+    // 串成一条链表
+    for (std::size_t i = 0; i + 1 < COUNT; ++i) {
+        objects[i].set_next(&objects[i + 1]);
+    }
+    objects[COUNT - 1].set_next(nullptr);
+
+    WW::FreeList free_list;
+    free_list.push_range(&objects[0], &objects[COUNT - 1], COUNT);
+    EXPECT_EQ(free_list.size(), COUNT);
+    EXPECT_EQ(free_list.front(), &objects[0]);
+
+    // 取出一部分
+    WW::FreeObject * begin = nullptr;
+    WW::FreeObject * end = nullptr;
+    EXPECT_EQ(free_list.pop_range(3, begin, end), 3);
+    EXPECT_EQ(begin, &objects[0]);
+    EXPECT_EQ(end, &objects[2]);
+    EXPECT_EQ(end->next(), nullptr);
+    EXPECT_EQ(free_list.size(), COUNT - 3);
+    EXPECT_EQ(free_list.front(), &objects[3]);
+
+    // 放回头部，再整体取出
+    free_list.push_range(begin, end, 3);
+    EXPECT_EQ(free_list.pop_range(COUNT * 2, begin, end), COUNT);
+    EXPECT_EQ(begin, &objects[0]);
+    EXPECT_EQ(end, &objects[COUNT - 1]);
+    EXPECT_TRUE(free_list.empty());
+
+    // 空链表取不出内存块
+    EXPECT_EQ(free_list.pop_range(1, begin, end), 0);
+    EXPECT_EQ(begin, nullptr);
+
+    // 单个插入后尾节点同样有效
+    free_list.push_front(&objects[5]);
+    free_list.push_range(&objects[0], &objects[2], 3);
+    EXPECT_EQ(free_list.pop_range(4, begin, end), 4);
+    EXPECT_EQ(end, &objects[5]);
+    EXPECT_EQ(end->next(), nullptr);
+    EXPECT_TRUE(free_list.empty());
+}
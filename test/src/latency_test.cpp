@@ -0,0 +1,100 @@
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+#include <Latency.h>
+#include <ThreadCache.h>
+
+TEST(LatencyTest, Buckets)
+{
+    // 每个值落在所在桶的上下界之间，桶号随值单调增加
+    std::size_t last = 0;
+    for (std::uint64_t value = 0; value < 100000; ++value) {
+        std::size_t index = WW::LatencyHistogram::bucket_index(value);
+        ASSERT_LT(index, WW::LATENCY_BUCKET_NUM);
+        EXPECT_LE(WW::LatencyHistogram::bucket_lower(index), value);
+        EXPECT_GE(WW::LatencyHistogram::bucket_upper(index), value);
+        EXPECT_GE(index, last);
+        last = index;
+    }
+
+    // 相邻的桶首尾相接
+    for (std::size_t index = 1; index < WW::LATENCY_BUCKET_NUM; ++index) {
+        EXPECT_EQ(WW::LatencyHistogram::bucket_lower(index), WW::LatencyHistogram::bucket_upper(index - 1) + 1);
+    }
+    EXPECT_EQ(WW::LatencyHistogram::bucket_index(UINT64_MAX), WW::LATENCY_BUCKET_NUM - 1);
+    EXPECT_EQ(WW::LatencyHistogram::bucket_upper(WW::LATENCY_BUCKET_NUM - 1), UINT64_MAX);
+}
+
+TEST(LatencyTest, Percentile)
+{
+    WW::LatencyHistogram histogram = WW::LatencyHistogram();
+    EXPECT_EQ(histogram.percentile(0.5), 0);
+
+    // 1到1000各一次
+    for (std::uint64_t value = 1; value <= 1000; ++value) {
+        ++histogram.buckets[WW::LatencyHistogram::bucket_index(value)];
+        ++histogram.count;
+        histogram.total_cycles += value;
+    }
+    histogram.max_cycles = 1000;
+
+    // 误差不超过桶宽
+    EXPECT_NEAR(static_cast<double>(histogram.percentile(0.5)), 500.0, 500.0 / 16);
+    EXPECT_NEAR(static_cast<double>(histogram.percentile(0.99)), 990.0, 990.0 / 16);
+    EXPECT_EQ(histogram.percentile(1.0), 1000);
+    EXPECT_DOUBLE_EQ(histogram.mean(), 500.5);
+}
+
+TEST(LatencyTest, RecordTiers)
+{
+    WW::Latency & latency = WW::Latency::get_latency();
+    latency.set_enabled(true);
+    latency.reset();
+
+    // 新线程的自由表为空，需要从中心缓存获取，退出时归还；大内存直接使用页段
+    std::thread([]() {
+        WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+        std::vector<void *> ptrs;
+        for (int i = 0; i < 1000; ++i) {
+            ptrs.emplace_back(thread_cache.allocate(64));
+        }
+        for (int i = 0; i < 64; ++i) {
+            ptrs.emplace_back(thread_cache.allocate(WW::MAX_MEMORY_SIZE * 4));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            thread_cache.deallocate(ptrs[i], 64);
+        }
+        for (int i = 1000; i < 1064; ++i) {
+            thread_cache.deallocate(ptrs[i], WW::MAX_MEMORY_SIZE * 4);
+        }
+    }).join();
+
+    WW::LatencySnapshot snapshot = WW::get_latency_snapshot();
+    EXPECT_GT(snapshot.cycles_per_ns, 0);
+    for (std::size_t tier = 0; tier < static_cast<std::size_t>(WW::LatencyTier::COUNT); ++tier) {
+        const WW::LatencyHistogram & histogram = snapshot.tiers[tier];
+        EXPECT_GT(histogram.count, 0) << WW::Latency::tier_name(static_cast<WW::LatencyTier>(tier));
+        EXPECT_GE(histogram.max_cycles, histogram.percentile(0.99));
+    }
+
+    std::string text = WW::format_latency(snapshot);
+    EXPECT_NE(text.find("fetch_range"), std::string::npos);
+    EXPECT_NE(text.find("system_fetch"), std::string::npos);
+
+    // 关闭后不再记录
+    latency.set_enabled(false);
+    std::uint64_t count = snapshot.tiers[static_cast<std::size_t>(WW::LatencyTier::FETCH_RANGE)].count;
+    std::thread([]() {
+        WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+        thread_cache.deallocate(thread_cache.allocate(64), 64);
+    }).join();
+    snapshot = WW::get_latency_snapshot();
+    EXPECT_EQ(snapshot.tiers[static_cast<std::size_t>(WW::LatencyTier::FETCH_RANGE)].count, count);
+
+    latency.reset();
+    snapshot = WW::get_latency_snapshot();
+    EXPECT_EQ(snapshot.tiers[static_cast<std::size_t>(WW::LatencyTier::FETCH_RANGE)].count, 0);
+}
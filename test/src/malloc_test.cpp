@@ -0,0 +1,223 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+bool is_aligned(void * ptr, std::size_t alignment) {
+    return reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0;
+}
+
+TEST(MallocTest, MallocAndFree)
+{
+    // 100字节对齐到112字节的内存块，glibc会得到104字节
+    void * ptr = malloc(100);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_TRUE(is_aligned(ptr, 16));
+    EXPECT_EQ(malloc_usable_size(ptr), 112);
+    free(ptr);
+
+    // malloc(0)返回可以释放的指针
+    ptr = malloc(0);
+    EXPECT_NE(ptr, nullptr);
+    free(ptr);
+
+    // 超出管理范围的内存
+    ptr = malloc(1 << 20);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_GE(malloc_usable_size(ptr), 1 << 20);
+    free(ptr);
+
+    free(nullptr);
+}
+
+TEST(MallocTest, CallocAndRealloc)
+{
+    // 复用的内存块也需要清零
+    char * ptr = static_cast<char *>(malloc(64));
+    std::memset(ptr, 0xff, 64);
+    free(ptr);
+
+    ptr = static_cast<char *>(calloc(8, 8));
+    ASSERT_NE(ptr, nullptr);
+    for (int i = 0; i < 64; ++i) {
+        EXPECT_EQ(ptr[i], 0);
+    }
+
+    // 内存块放得下时原地返回
+    for (int i = 0; i < 64; ++i) {
+        ptr[i] = static_cast<char>(i);
+    }
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ptr);
+    char * same = static_cast<char *>(realloc(ptr, 60));
+    ASSERT_NE(same, nullptr);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(same), address);
+
+    // 扩大后内容保持不变
+    ptr = static_cast<char *>(realloc(same, 4096));
+    ASSERT_NE(ptr, nullptr);
+    for (int i = 0; i < 64; ++i) {
+        EXPECT_EQ(ptr[i], static_cast<char>(i));
+    }
+
+    ptr = static_cast<char *>(realloc(ptr, 1 << 20));
+    ASSERT_NE(ptr, nullptr);
+    for (int i = 0; i < 64; ++i) {
+        EXPECT_EQ(ptr[i], static_cast<char>(i));
+    }
+    free(ptr);
+
+    // 溢出时返回空指针
+    volatile std::size_t count = static_cast<std::size_t>(-1) / 8;
+    EXPECT_EQ(calloc(count, 16), nullptr);
+}
+
+TEST(MallocTest, AlignedAllocation)
+{
+    for (std::size_t alignment = 8; alignment <= 65536; alignment <<= 1) {
+        void * ptr = nullptr;
+        ASSERT_EQ(posix_memalign(&ptr, alignment, 100), 0);
+        EXPECT_TRUE(is_aligned(ptr, alignment));
+        free(ptr);
+
+        ptr = aligned_alloc(alignment, alignment * 2);
+        ASSERT_NE(ptr, nullptr);
+        EXPECT_TRUE(is_aligned(ptr, alignment));
+        free(ptr);
+
+        ptr = memalign(alignment, 3);
+        ASSERT_NE(ptr, nullptr);
+        EXPECT_TRUE(is_aligned(ptr, alignment));
+        free(ptr);
+    }
+
+    // 超过页大小的对齐只占用需要的页数
+    void * ptr = nullptr;
+    ASSERT_EQ(posix_memalign(&ptr, 8192, 64), 0);
+    EXPECT_TRUE(is_aligned(ptr, 8192));
+    EXPECT_EQ(malloc_usable_size(ptr), 4096);
+    free(ptr);
+
+    EXPECT_EQ(posix_memalign(&ptr, 24, 100), EINVAL);
+
+    ptr = valloc(10);
+    EXPECT_TRUE(is_aligned(ptr, 4096));
+    free(ptr);
+}
+
+TEST(MallocTest, OperatorNewAndDelete)
+{
+    int * value = new int(42);
+    EXPECT_EQ(*value, 42);
+    delete value;
+
+    std::vector<std::string> strings;
+    for (int i = 0; i < 1000; ++i) {
+        strings.emplace_back(std::string(i % 100 + 20, 'a'));
+    }
+    EXPECT_EQ(strings[999].size(), 119);
+}
+
+TEST(MallocTest, Fork)
+{
+    void * ptr = malloc(128);
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+
+    if (pid == 0) {
+        // 子进程中可以继续分配和释放
+        std::vector<void *> ptrs;
+        for (int i = 0; i < 1000; ++i) {
+            ptrs.emplace_back(malloc(i + 1));
+        }
+        for (void * p : ptrs) {
+            free(p);
+        }
+        free(ptr);
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    free(ptr);
+}
+
+TEST(MallocTest, ForkDuringLargeMalloc)
+{
+    // 其他线程正在直接向系统映射内存时fork，子进程仍然可以申请大内存
+    constexpr std::size_t LARGE_SIZE = 32 * 1024 * 1024;
+    std::atomic<bool> stop(false);
+    std::thread worker([&stop]() {
+        while (!stop.load()) {
+            free(malloc(LARGE_SIZE));
+        }
+    });
+
+    for (int i = 0; i < 20; ++i) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+
+        if (pid == 0) {
+            // 死锁时由信号结束
+            alarm(10);
+            void * ptr = malloc(LARGE_SIZE);
+            free(ptr);
+            _exit(ptr == nullptr ? 1 : 0);
+        }
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+
+    stop.store(true);
+    worker.join();
+}
+
+TEST(MallocTest, MultiThreadMallocAndFree)
+{
+    constexpr int THREAD_NUM = 4;
+    constexpr int COUNT = 1000;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<void *>> ptrs(THREAD_NUM);
+
+    for (int i = 0; i < THREAD_NUM; ++i) {
+        threads.emplace_back([i, &ptrs]() {
+            for (int j = 0; j < COUNT; ++j) {
+                void * ptr = malloc((j % 64 + 1) * (i + 1));
+                EXPECT_NE(ptr, nullptr);
+                ptrs[i].emplace_back(ptr);
+            }
+        });
+    }
+
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    // 在其他线程中释放
+    threads.clear();
+    for (int i = 0; i < THREAD_NUM; ++i) {
+        threads.emplace_back([i, &ptrs]() {
+            for (void * ptr : ptrs[(i + 1) % THREAD_NUM]) {
+                free(ptr);
+            }
+        });
+    }
+
+    for (auto & thread : threads) {
+        thread.join();
+    }
+}
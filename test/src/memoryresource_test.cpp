@@ -0,0 +1,60 @@
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <MemoryResource.h>
+#include <ThreadCache.h>
+
+TEST(MemoryResourceTest, AllocateAndDeallocate)
+{
+    WW::MemoryResource * resource = WW::MemoryResource::get_memory_resource();
+    ASSERT_NE(resource, nullptr);
+
+    // 按照对齐选择内存块，超过页大小的对齐使用页段
+    for (std::size_t alignment = 1; alignment <= 4 * WW::PAGE_SIZE; alignment <<= 1) {
+        for (std::size_t bytes : { std::size_t(0), std::size_t(24), std::size_t(3000), WW::MAX_MEMORY_SIZE + 1 }) {
+            void * ptr = resource->allocate(bytes, alignment);
+            ASSERT_NE(ptr, nullptr);
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(ptr) % alignment, 0);
+            resource->deallocate(ptr, bytes, alignment);
+        }
+    }
+
+    // 所有实例共用同一个内存池
+    WW::MemoryResource other;
+    EXPECT_TRUE(resource->is_equal(other));
+    EXPECT_FALSE(resource->is_equal(*std::pmr::new_delete_resource()));
+
+    // 无效的对齐
+    EXPECT_THROW(static_cast<void>(resource->allocate(64, 3)), std::bad_alloc);
+}
+
+TEST(MemoryResourceTest, PmrContainers)
+{
+    WW::MemoryResource * resource = WW::MemoryResource::get_memory_resource();
+
+    std::pmr::vector<std::pmr::string> strings(resource);
+    for (int i = 0; i < 1000; ++i) {
+        strings.emplace_back(std::to_string(i) + " hello, world! hello, world!");
+    }
+
+    // 元素使用容器的内存资源
+    EXPECT_EQ(strings.back().get_allocator().resource(), resource);
+
+    // 其他线程释放
+    std::thread([moved = std::move(strings)]() mutable {
+        EXPECT_EQ(moved[999], "999 hello, world! hello, world!");
+        moved.clear();
+        moved.shrink_to_fit();
+    }).join();
+
+    // 作为上游的内存资源
+    std::pmr::unsynchronized_pool_resource pool(resource);
+    std::pmr::vector<int> numbers(&pool);
+    for (int i = 0; i < 10000; ++i) {
+        numbers.push_back(i);
+    }
+    EXPECT_EQ(numbers[9999], 9999);
+}
@@ -0,0 +1,92 @@
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <Numa.h>
+#include <ThreadCache.h>
+#include <PageCache.h>
+
+TEST(NumaTest, NodeCount)
+{
+    WW::Numa & numa = WW::Numa::get_numa();
+    EXPECT_GE(numa.system_node_count(), 1);
+
+    // 限制在1到MAX_NUMA_NODE_NUM之间
+    numa.set_node_count(0);
+    EXPECT_EQ(numa.node_count(), 1);
+    EXPECT_FALSE(numa.enabled());
+    EXPECT_EQ(numa.system_node(0), WW::NO_NUMA_NODE);
+
+    numa.set_node_count(WW::MAX_NUMA_NODE_NUM + 1);
+    EXPECT_EQ(numa.node_count(), WW::MAX_NUMA_NODE_NUM);
+    EXPECT_EQ(numa.max_node_count(), WW::MAX_NUMA_NODE_NUM);
+    EXPECT_TRUE(numa.enabled());
+
+    // 模拟的节点轮流对应系统节点
+    for (std::size_t node = 0; node < WW::MAX_NUMA_NODE_NUM; ++node) {
+        EXPECT_EQ(numa.system_node(node), node % numa.system_node_count());
+    }
+
+    numa.set_node_count(1);
+}
+
+TEST(NumaTest, PerNodeArena)
+{
+    WW::Numa & numa = WW::Numa::get_numa();
+    numa.set_node_count(2);
+
+    constexpr std::size_t SMALL = 64;
+    constexpr std::size_t LARGE = WW::MAX_MEMORY_SIZE + 1;
+    constexpr int COUNT = 100;
+    std::vector<void *> ptrs[2];
+
+    // 线程在第一次申请之前指定节点，之后从该节点的页缓存获取内存
+    std::vector<std::thread> threads;
+    for (std::size_t node = 0; node < 2; ++node) {
+        threads.emplace_back([&, node]() {
+            WW::Numa::bind_thread(node);
+            EXPECT_EQ(WW::Numa::get_numa().current_node(), node);
+
+            WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+            WW::PageCache & page_cache = WW::PageCache::get_page_cache();
+            for (int i = 0; i < COUNT; ++i) {
+                void * ptr = thread_cache.allocate(SMALL);
+                ASSERT_NE(ptr, nullptr);
+                EXPECT_EQ(page_cache.object_to_span(ptr)->node(), node);
+                ptrs[node].emplace_back(ptr);
+            }
+
+            void * large = thread_cache.allocate(LARGE);
+            ASSERT_NE(large, nullptr);
+            EXPECT_EQ(page_cache.object_to_span(large)->node(), node);
+            ptrs[node].emplace_back(large);
+        });
+    }
+
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    // 交叉释放，内存块和页段归还到所属节点
+    threads.clear();
+    for (std::size_t node = 0; node < 2; ++node) {
+        threads.emplace_back([&, node]() {
+            WW::Numa::bind_thread(node);
+            WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+            for (void * ptr : ptrs[1 - node]) {
+                thread_cache.deallocate(ptr);
+            }
+        });
+    }
+
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    // 第0个节点就是默认的页缓存
+    EXPECT_EQ(&WW::PageCache::get_page_cache(0), &WW::PageCache::get_page_cache());
+    EXPECT_EQ(WW::PageCache::get_page_cache(1).node(), 1);
+    EXPECT_EQ(&WW::CentralCache::get_central_cache(0), &WW::CentralCache::get_central_cache());
+
+    numa.set_node_count(1);
+}
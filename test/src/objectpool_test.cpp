@@ -0,0 +1,61 @@
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <ObjectPool.h>
+#include <SpanList.h>
+
+TEST(ObjectPoolTest, CreateAndDestroy)
+{
+    constexpr int COUNT = 10000;
+    WW::ObjectPool<WW::Span> pool;
+    std::vector<WW::Span *> spans;
+    std::set<WW::Span *> unique;
+
+    for (int i = 0; i < COUNT; ++i) {
+        WW::Span * span = pool.create();
+        ASSERT_NE(span, nullptr);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(span) % alignof(WW::Span), 0);
+        // 新建的对象已经构造
+        EXPECT_EQ(span->page_count(), 0);
+        EXPECT_FALSE(span->is_use());
+        span->set_page_count(i + 1);
+        EXPECT_TRUE(unique.insert(span).second);
+        spans.emplace_back(span);
+    }
+    EXPECT_EQ(pool.size(), COUNT);
+
+    // 对象之间互不覆盖
+    for (int i = 0; i < COUNT; ++i) {
+        EXPECT_EQ(spans[i]->page_count(), i + 1);
+    }
+
+    // 释放后优先复用
+    WW::Span * last = spans.back();
+    spans.pop_back();
+    pool.destroy(last);
+    EXPECT_EQ(pool.create(), last);
+    EXPECT_EQ(last->page_count(), 0);
+    spans.emplace_back(last);
+
+    for (WW::Span * span : spans) {
+        pool.destroy(span);
+    }
+    EXPECT_EQ(pool.size(), 0);
+}
+
+TEST(ObjectPoolTest, SmallObject)
+{
+    // 对象小于指针时按指针大小分配
+    WW::ObjectPool<char> pool;
+    char * first = pool.create('a');
+    char * second = pool.create('b');
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    EXPECT_GE(static_cast<std::size_t>(second - first), sizeof(void *));
+    EXPECT_EQ(*first, 'a');
+    EXPECT_EQ(*second, 'b');
+
+    pool.destroy(first);
+    pool.destroy(second);
+}
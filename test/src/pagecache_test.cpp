@@ -1,4 +1,5 @@
 #include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <PageCache.h>
@@ -79,4 +80,218 @@ TEST_F(PageCacheTest, MultiThreadFetchAndReturn)
     for (int i = 0; i < THREAD_NUM; ++i) {
         threads[i].join();
     }
-}
\ No newline at end of file
+}
+TEST_F(PageCacheTest, ObjectToSpan)
+{
+    // 申请一个8页的页段
+    WW::Span * span = page_cache.fetch_span(8);
+    ASSERT_NE(span, nullptr);
+
+    // 页段中的每一页都能找到该页段
+    char * base = static_cast<char *>(WW::Span::id_to_ptr(span->page_id()));
+    for (std::size_t i = 0; i < span->page_count(); ++i) {
+        EXPECT_EQ(page_cache.object_to_span(base + i * WW::PAGE_SIZE), span);
+        EXPECT_EQ(page_cache.object_to_span(base + i * WW::PAGE_SIZE + WW::PAGE_SIZE - 1), span);
+    }
+
+    // 不属于内存池的地址找不到页段
+    int local = 0;
+    EXPECT_EQ(page_cache.object_to_span(&local), nullptr);
+
+    page_cache.return_span(span);
+}
+
+TEST_F(PageCacheTest, ReleaseFreeMemory)
+{
+    // 申请并写入一个最大页段，归还后页缓存中至少有128个空闲页
+    WW::Span * span = page_cache.fetch_span(WW::MAX_PAGE_NUM);
+    ASSERT_NE(span, nullptr);
+    char * base = static_cast<char *>(WW::Span::id_to_ptr(span->page_id()));
+    for (std::size_t i = 0; i < WW::MAX_PAGE_NUM; ++i) {
+        base[i * WW::PAGE_SIZE] = 1;
+    }
+    page_cache.return_span(span);
+
+    EXPECT_GE(page_cache.release_free_memory(), WW::MAX_PAGE_NUM);
+
+    // 已经归还的页段不会重复归还
+    EXPECT_EQ(page_cache.release_free_memory(), 0);
+
+    // 再次使用已归还的页段不需要额外操作，内容被清零
+    span = page_cache.fetch_span(WW::MAX_PAGE_NUM);
+    ASSERT_NE(span, nullptr);
+    EXPECT_FALSE(span->is_released());
+    base = static_cast<char *>(WW::Span::id_to_ptr(span->page_id()));
+    for (std::size_t i = 0; i < WW::MAX_PAGE_NUM; ++i) {
+        EXPECT_EQ(base[i * WW::PAGE_SIZE], 0);
+        base[i * WW::PAGE_SIZE] = 1;
+    }
+    page_cache.return_span(span);
+}
+
+TEST_F(PageCacheTest, ReleaseOnlyCommittedPages)
+{
+    // 先归还所有空闲内存
+    page_cache.release_free_memory();
+
+    // 从已归还的页段中切出4页并归还，它不能和相邻的已归还页段合并
+    WW::Span * span = page_cache.fetch_span(4);
+    ASSERT_NE(span, nullptr);
+    EXPECT_FALSE(span->is_released());
+    page_cache.return_span(span);
+
+    // 只统计新归还的4页
+    EXPECT_EQ(page_cache.release_free_memory(), 4);
+    EXPECT_EQ(page_cache.release_free_memory(), 0);
+}
+
+TEST_F(PageCacheTest, ReleaseWithoutDrain)
+{
+    page_cache.release_free_memory();
+
+    // 页缓存中有足够的未归还空闲页
+    WW::Span * large = page_cache.fetch_span(WW::MAX_PAGE_NUM + 1);
+    ASSERT_NE(large, nullptr);
+    page_cache.return_span(large);
+
+    // 页段缓存中的页段
+    WW::Span * span = page_cache.fetch_span(3);
+    ASSERT_NE(span, nullptr);
+    page_cache.return_span(span);
+
+    // 只需归还页缓存中的空闲页，页段缓存保持不变
+    EXPECT_EQ(page_cache.release_free_memory(WW::MAX_PAGE_NUM + 1), WW::MAX_PAGE_NUM + 1);
+    WW::Span * again = page_cache.fetch_span(3);
+    EXPECT_EQ(again, span);
+    page_cache.return_span(again);
+}
+
+TEST_F(PageCacheTest, Scavenger)
+{
+    // 先归还其他测试留下的空闲内存，只剩下一个未归还的页段
+    page_cache.release_free_memory();
+    WW::Span * span = page_cache.fetch_span(WW::MAX_PAGE_NUM);
+    ASSERT_NE(span, nullptr);
+    page_cache.return_span(span);
+
+    // 后台线程按照回收速率归还内存
+    page_cache.set_release_rate(WW::MAX_PAGE_NUM);
+    page_cache.start_scavenger();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    page_cache.stop_scavenger();
+    page_cache.set_release_rate(WW::DEFAULT_RELEASE_RATE);
+
+    EXPECT_EQ(page_cache.release_free_memory(), 0);
+}
+
+TEST_F(PageCacheTest, SpanCache)
+{
+    // 刚归还的页段放入页段缓存，再次申请同样页数时直接取回
+    WW::Span * span = page_cache.fetch_span(3);
+    ASSERT_NE(span, nullptr);
+    page_cache.return_span(span);
+
+    WW::Span * again = page_cache.fetch_span(3);
+    EXPECT_EQ(again, span);
+    EXPECT_EQ(again->page_count(), 3);
+
+    // 页段缓存中的页段仍然可以通过页号找到
+    page_cache.return_span(again);
+    EXPECT_EQ(page_cache.object_to_span(WW::Span::id_to_ptr(span->page_id())), span);
+
+    // 清空页段缓存后页段变为空闲并参与合并
+    page_cache.flush_span_caches();
+    EXPECT_FALSE(span->is_use());
+    EXPECT_GE(span->page_count(), 3);
+}
+
+TEST_F(PageCacheTest, LargeSpan)
+{
+    // 超过最大页数的页段
+    WW::Span * span = page_cache.fetch_span(WW::MAX_PAGE_NUM * 3);
+    ASSERT_NE(span, nullptr);
+    EXPECT_EQ(span->page_count(), WW::MAX_PAGE_NUM * 3);
+    char * base = static_cast<char *>(WW::Span::id_to_ptr(span->page_id()));
+    EXPECT_EQ(page_cache.object_to_span(base + (WW::MAX_PAGE_NUM * 3 - 1) * WW::PAGE_SIZE), span);
+
+    // 归还后合并不受最大页数限制，可以从中切出其他大小的页段
+    page_cache.return_span(span);
+    page_cache.flush_span_caches();
+    EXPECT_GE(span->page_count(), WW::MAX_PAGE_NUM * 3);
+
+    WW::Span * large = page_cache.fetch_span(WW::MAX_PAGE_NUM * 2);
+    ASSERT_NE(large, nullptr);
+    WW::Span * small = page_cache.fetch_span(WW::MAX_PAGE_NUM);
+    ASSERT_NE(small, nullptr);
+    page_cache.return_span(large);
+    page_cache.return_span(small);
+
+    // 直接映射的页段
+    WW::Span * direct = page_cache.fetch_span(WW::DIRECT_MMAP_SIZE >> WW::PAGE_SHIFT);
+    ASSERT_NE(direct, nullptr);
+    base = static_cast<char *>(WW::Span::id_to_ptr(direct->page_id()));
+    base[0] = 1;
+    base[WW::DIRECT_MMAP_SIZE - 1] = 1;
+    EXPECT_EQ(page_cache.object_to_span(base), direct);
+    page_cache.return_span(direct);
+    EXPECT_EQ(page_cache.object_to_span(base), nullptr);
+}
+
+
+TEST_F(PageCacheTest, AlignedSpan)
+{
+    for (std::size_t align_pages = 1; align_pages <= 64; align_pages <<= 1) {
+        WW::Span * span = page_cache.fetch_aligned_span(3, align_pages);
+        ASSERT_NE(span, nullptr);
+        EXPECT_EQ(span->page_count(), 3);
+        EXPECT_EQ(span->page_id() % align_pages, 0);
+        EXPECT_TRUE(span->is_use());
+
+        // 每一页都可以找到页段
+        char * base = static_cast<char *>(WW::Span::id_to_ptr(span->page_id()));
+        EXPECT_EQ(page_cache.object_to_span(base), span);
+        EXPECT_EQ(page_cache.object_to_span(base + 2 * WW::PAGE_SIZE), span);
+        page_cache.return_span(span);
+    }
+
+    // 直接映射的页段同样对齐
+    constexpr std::size_t ALIGN_PAGES = std::size_t(1) << 10;
+    WW::Span * direct = page_cache.fetch_aligned_span(WW::DIRECT_MMAP_SIZE >> WW::PAGE_SHIFT, ALIGN_PAGES);
+    ASSERT_NE(direct, nullptr);
+    EXPECT_EQ(direct->page_id() % ALIGN_PAGES, 0);
+    char * base = static_cast<char *>(WW::Span::id_to_ptr(direct->page_id()));
+    base[0] = 1;
+    base[WW::DIRECT_MMAP_SIZE - 1] = 1;
+    page_cache.return_span(direct);
+}
+
+TEST_F(PageCacheTest, ResizeSpan)
+{
+    WW::Span * span = page_cache.fetch_span(WW::MAX_PAGE_NUM);
+    ASSERT_NE(span, nullptr);
+    char * base = static_cast<char *>(WW::Span::id_to_ptr(span->page_id()));
+
+    // 缩小后多出的页成为空闲页段
+    EXPECT_TRUE(page_cache.resize_span(span, 10));
+    EXPECT_EQ(span->page_count(), 10);
+    WW::Span * tail = page_cache.object_to_span(base + 10 * WW::PAGE_SIZE);
+    ASSERT_NE(tail, nullptr);
+    EXPECT_FALSE(tail->is_use());
+
+    // 增大时使用后面的空闲页，新增的页都可以找到页段
+    EXPECT_TRUE(page_cache.resize_span(span, 20));
+    EXPECT_EQ(span->page_count(), 20);
+    EXPECT_EQ(page_cache.object_to_span(base + 19 * WW::PAGE_SIZE), span);
+
+    // 后面的页被占用时失败
+    WW::Span * next = page_cache.fetch_span(1);
+    ASSERT_NE(next, nullptr);
+    if (next->page_id() == span->page_id() + span->page_count()) {
+        EXPECT_FALSE(page_cache.resize_span(span, 21));
+    }
+    page_cache.return_span(next);
+
+    // 直接映射的页段不能调整
+    EXPECT_FALSE(page_cache.resize_span(span, WW::DIRECT_MMAP_SIZE >> WW::PAGE_SHIFT));
+    page_cache.return_span(span);
+}
@@ -22,4 +22,66 @@ TEST(PatformTest, AlignedMallocAndFree)
     for (int i = 0; i < COUNT; ++i) {
         WW::Platform::aligned_free(ptrs[i]);
     }
-}
\ No newline at end of file
+}
+
+TEST(PatformTest, SystemMalloc)
+{
+    constexpr int COUNT = 1000;
+    std::vector<char *> ptrs;
+
+    for (int i = 0; i < COUNT; ++i) {
+        char * ptr = static_cast<char *>(WW::Platform::system_malloc(WW::PAGE_SIZE * WW::MAX_PAGE_NUM));
+        ASSERT_NE(ptr, nullptr);
+        ASSERT_TRUE(is_aligned(ptr, WW::PAGE_SIZE));
+        // 内存块之间不能重叠
+        ptr[0] = 1;
+        ptr[WW::PAGE_SIZE * WW::MAX_PAGE_NUM - 1] = 1;
+        if (!ptrs.empty()) {
+            ASSERT_TRUE(ptr >= ptrs.back() + WW::PAGE_SIZE * WW::MAX_PAGE_NUM || ptr + WW::PAGE_SIZE * WW::MAX_PAGE_NUM <= ptrs.back());
+        }
+        ptrs.emplace_back(ptr);
+    }
+
+    // 超过预留大小的内存
+    char * ptr = static_cast<char *>(WW::Platform::system_malloc(WW::SYSTEM_RESERVE_SIZE + WW::PAGE_SIZE));
+    ASSERT_NE(ptr, nullptr);
+    ptr[WW::SYSTEM_RESERVE_SIZE] = 1;
+}
+
+TEST(PatformTest, HugePages)
+{
+    WW::Platform::PageMode mode = WW::Platform::page_mode();
+
+    // 系统不支持大页时退回普通页，仍然可以获取内存
+    for (WW::Platform::PageMode huge : { WW::Platform::PageMode::TRANSPARENT_HUGE, WW::Platform::PageMode::EXPLICIT_HUGE }) {
+        WW::Platform::set_page_mode(huge);
+        EXPECT_EQ(WW::Platform::page_mode(), huge);
+
+        char * ptr = static_cast<char *>(WW::Platform::system_malloc(WW::HUGE_PAGE_SIZE));
+        ASSERT_NE(ptr, nullptr);
+        EXPECT_TRUE(is_aligned(ptr, WW::HUGE_PAGE_SIZE));
+        ptr[0] = 1;
+        ptr[WW::HUGE_PAGE_SIZE - 1] = 1;
+    }
+
+    WW::Platform::set_page_mode(mode);
+}
+
+TEST(PatformTest, ReleaseExplicitHugePages)
+{
+    WW::Platform::PageMode mode = WW::Platform::page_mode();
+
+    char * ptr = static_cast<char *>(WW::Platform::system_malloc(WW::HUGE_PAGE_SIZE));
+    ASSERT_NE(ptr, nullptr);
+    ptr[0] = 1;
+    EXPECT_TRUE(WW::Platform::release(ptr, WW::HUGE_PAGE_SIZE));
+
+    // 显式大页不支持按页归还
+    WW::Platform::set_page_mode(WW::Platform::PageMode::EXPLICIT_HUGE);
+    ptr = static_cast<char *>(WW::Platform::system_malloc(WW::HUGE_PAGE_SIZE));
+    ASSERT_NE(ptr, nullptr);
+    ptr[0] = 1;
+    EXPECT_FALSE(WW::Platform::release(ptr, WW::PAGE_SIZE));
+
+    WW::Platform::set_page_mode(mode);
+}
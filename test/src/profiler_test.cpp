@@ -0,0 +1,153 @@
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include <gtest/gtest.h>
+#include <Profiler.h>
+#include <ThreadCache.h>
+
+namespace
+{
+
+/**
+ * @brief 读取整个文件
+ */
+std::string read_file(const std::string & path)
+{
+    std::string content;
+    FILE * file = std::fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return content;
+    }
+
+    char buffer[4096];
+    std::size_t length = 0;
+    while ((length = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, length);
+    }
+    std::fclose(file);
+    return content;
+}
+
+} // namespace
+
+TEST(ProfilerTest, SampleAndRelease)
+{
+    WW::Profiler & profiler = WW::Profiler::get_profiler();
+    std::size_t base_count = profiler.sample_count();
+
+    // 已有线程最多在申请`PROFILER_RECHECK_SIZE`后才使用新的间隔，在新线程中申请
+    profiler.set_sample_rate(1);
+    EXPECT_TRUE(profiler.enabled());
+
+    std::vector<void *> ptrs;
+    std::thread([&]() {
+        WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+        for (int i = 0; i < 1000; ++i) {
+            ptrs.emplace_back(thread_cache.allocate(64));
+        }
+        ptrs.emplace_back(thread_cache.allocate(WW::MAX_MEMORY_SIZE + 1));
+    }).join();
+    profiler.set_sample_rate(0);
+
+    // 平均每字节采样一次，每次申请都会被采样
+    EXPECT_EQ(profiler.sample_count(), base_count + ptrs.size());
+
+    std::vector<WW::ProfileSample> samples;
+    profiler.snapshot(samples);
+    ASSERT_EQ(samples.size(), base_count + ptrs.size());
+    for (const WW::ProfileSample & sample : samples) {
+        EXPECT_GT(sample.depth, 0);
+        EXPECT_EQ(sample.rate, 1);
+    }
+
+    // 关闭后不再采样，已有的采样在释放时删除
+    WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+    void * unsampled = thread_cache.allocate(64);
+    EXPECT_EQ(profiler.sample_count(), base_count + ptrs.size());
+    thread_cache.deallocate(unsampled, 64);
+
+    for (std::size_t i = 0; i < 500; ++i) {
+        thread_cache.deallocate(ptrs[i], 64);
+    }
+    EXPECT_EQ(profiler.sample_count(), base_count + ptrs.size() - 500);
+
+    for (std::size_t i = 500; i < ptrs.size(); ++i) {
+        thread_cache.deallocate(ptrs[i]);
+    }
+    EXPECT_EQ(profiler.sample_count(), base_count);
+}
+
+TEST(ProfilerTest, SampleInterval)
+{
+    WW::Profiler & profiler = WW::Profiler::get_profiler();
+    EXPECT_EQ(profiler.next_sample_interval(), WW::PROFILER_RECHECK_SIZE);
+
+    // 几何分布的平均值接近采样间隔
+    constexpr std::size_t RATE = 512 * 1024;
+    constexpr int COUNT = 100000;
+    profiler.set_sample_rate(RATE);
+    double total = 0;
+    for (int i = 0; i < COUNT; ++i) {
+        std::size_t interval = profiler.next_sample_interval();
+        EXPECT_GT(interval, 0);
+        total += static_cast<double>(interval);
+    }
+    profiler.set_sample_rate(0);
+
+    double mean = total / COUNT;
+    EXPECT_GT(mean, RATE * 0.95);
+    EXPECT_LT(mean, RATE * 1.05);
+}
+
+TEST(ProfilerTest, Dump)
+{
+    WW::Profiler & profiler = WW::Profiler::get_profiler();
+    profiler.set_sample_rate(1);
+
+    std::vector<void *> ptrs;
+    std::thread([&]() {
+        WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+        for (int i = 0; i < 100; ++i) {
+            ptrs.emplace_back(thread_cache.allocate(128));
+        }
+    }).join();
+    profiler.set_sample_rate(0);
+
+    std::string pprof_path = testing::TempDir() + "ww_profile.heap";
+    std::string folded_path = testing::TempDir() + "ww_profile.folded";
+    ASSERT_TRUE(profiler.dump_pprof(pprof_path.c_str()));
+    ASSERT_TRUE(profiler.dump_folded(folded_path.c_str()));
+
+    // pprof堆格式的文件头和映射
+    std::string pprof = read_file(pprof_path);
+    EXPECT_EQ(pprof.compare(0, 13, "heap profile:"), 0);
+    EXPECT_NE(pprof.find("@ heap_v2/1\n"), std::string::npos);
+    EXPECT_NE(pprof.find("MAPPED_LIBRARIES:"), std::string::npos);
+
+    // 折叠格式每行以估计的字节数结尾，总数不少于存活的采样
+    std::string folded = read_file(folded_path);
+    ASSERT_FALSE(folded.empty());
+    double total = 0;
+    std::size_t begin = 0;
+    while (begin < folded.size()) {
+        std::size_t end = folded.find('\n', begin);
+        ASSERT_NE(end, std::string::npos);
+        std::size_t space = folded.rfind(' ', end);
+        ASSERT_NE(space, std::string::npos);
+        ASSERT_GT(space, begin);
+        total += std::strtod(folded.c_str() + space + 1, nullptr);
+        begin = end + 1;
+    }
+    EXPECT_GE(total, 100.0 * 128);
+
+    WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+    for (void * ptr : ptrs) {
+        thread_cache.deallocate(ptr, 128);
+    }
+
+    std::remove(pprof_path.c_str());
+    std::remove(folded_path.c_str());
+}
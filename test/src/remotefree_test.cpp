@@ -0,0 +1,178 @@
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <RemoteFree.h>
+#include <ThreadCache.h>
+#include <CentralCache.h>
+#include <PageCache.h>
+#include <Stats.h>
+#include <Size.h>
+
+TEST(RemoteFreeTest, QueuePushAndPop)
+{
+    WW::RemoteFree & remote_free = WW::RemoteFree::get_remote_free();
+    std::size_t id = remote_free.acquire();
+    ASSERT_NE(id, 0);
+    WW::RemoteQueue * queue = remote_free.queue(id);
+    ASSERT_NE(queue, nullptr);
+
+    constexpr std::size_t INDEX = 3;
+    std::size_t size = WW::Size::index_to_size(INDEX);
+    WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+
+    // 多个线程同时压入
+    constexpr int THREADS = 4;
+    constexpr int COUNT = 1000;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; ++i) {
+        threads.emplace_back([&]() {
+            WW::ThreadCache & local_cache = WW::ThreadCache::get_thread_cache();
+            std::vector<void *> ptrs;
+            for (int j = 0; j < COUNT; ++j) {
+                ptrs.emplace_back(local_cache.allocate(size));
+            }
+
+            for (void * ptr : ptrs) {
+                EXPECT_TRUE(queue->push(INDEX, static_cast<WW::FreeObject *>(ptr)));
+            }
+        });
+    }
+
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    // 一次取走全部
+    WW::FreeObject * begin = nullptr;
+    WW::FreeObject * end = nullptr;
+    EXPECT_EQ(queue->pop_all(INDEX, begin, end), THREADS * COUNT);
+    EXPECT_EQ(end->next(), nullptr);
+    EXPECT_EQ(queue->pop_all(INDEX, begin, end), 0);
+
+    // 关闭时队列中剩余的内存块归还中心缓存，之后压入失败
+    WW::FreeObject * rest = begin->next();
+    EXPECT_TRUE(queue->push(INDEX, begin));
+    remote_free.release(id);
+    EXPECT_FALSE(queue->push(INDEX, rest));
+
+    // 其余内存块归还线程缓存
+    for (WW::FreeObject * obj = rest; obj != nullptr;) {
+        WW::FreeObject * next = obj->next();
+        thread_cache.deallocate(obj, size);
+        obj = next;
+    }
+}
+
+TEST(RemoteFreeTest, ProducerConsumer)
+{
+    constexpr std::size_t SIZE = 96;
+    constexpr int COUNT = 2000;
+    std::size_t index = WW::Size::size_to_index(SIZE);
+
+    WW::RemoteFree & remote_free = WW::RemoteFree::get_remote_free();
+    remote_free.set_enabled(true);
+    WW::MemoryStats before = WW::get_stats();
+
+    std::vector<void *> ptrs;
+    std::set<void *> produced;
+
+    // 生产者申请，消费者释放，生产者再次申请时取回
+    std::thread producer([&]() {
+        WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+        for (int i = 0; i < COUNT; ++i) {
+            void * ptr = thread_cache.allocate(SIZE);
+            ptrs.emplace_back(ptr);
+            produced.insert(ptr);
+        }
+
+        std::thread consumer([&]() {
+            WW::ThreadCache & consumer_cache = WW::ThreadCache::get_thread_cache();
+            for (void * ptr : ptrs) {
+                consumer_cache.deallocate(ptr, SIZE);
+            }
+        });
+        consumer.join();
+
+        // 先用完线程缓存中剩余的，再从远程释放队列取回
+        std::size_t reused = 0;
+        std::vector<void *> again;
+        for (int i = 0; i < 2 * COUNT; ++i) {
+            void * ptr = thread_cache.allocate(SIZE);
+            again.emplace_back(ptr);
+            reused += produced.count(ptr);
+        }
+        EXPECT_EQ(reused, COUNT);
+
+        for (void * ptr : again) {
+            thread_cache.deallocate(ptr, SIZE);
+        }
+    });
+    producer.join();
+
+    WW::MemoryStats after = WW::get_stats();
+    EXPECT_GE(after.size_classes[index].remote_free_count - before.size_classes[index].remote_free_count, COUNT);
+
+    remote_free.set_enabled(false);
+}
+
+TEST(RemoteFreeTest, QueueLimit)
+{
+    WW::RemoteFree & remote_free = WW::RemoteFree::get_remote_free();
+    std::size_t id = remote_free.acquire();
+    ASSERT_NE(id, 0);
+    WW::RemoteQueue * queue = remote_free.queue(id);
+    ASSERT_NE(queue, nullptr);
+
+    constexpr std::size_t SIZE = 64 * 1024;
+    constexpr std::size_t MAX_COUNT = WW::MAX_REMOTE_QUEUE_BYTES / SIZE;
+    std::size_t index = WW::Size::size_to_index(SIZE);
+    WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+
+    std::vector<void *> ptrs;
+    for (std::size_t i = 0; i <= MAX_COUNT; ++i) {
+        ptrs.emplace_back(thread_cache.allocate(SIZE));
+    }
+
+    // 超出最大内存大小时压入失败
+    for (std::size_t i = 0; i < MAX_COUNT; ++i) {
+        EXPECT_TRUE(queue->push(index, static_cast<WW::FreeObject *>(ptrs[i])));
+    }
+    EXPECT_FALSE(queue->push(index, static_cast<WW::FreeObject *>(ptrs[MAX_COUNT])));
+
+    // 取走之后可以继续压入
+    WW::FreeObject * begin = nullptr;
+    WW::FreeObject * end = nullptr;
+    EXPECT_EQ(queue->pop_all(index, begin, end), MAX_COUNT);
+    EXPECT_TRUE(queue->push(index, static_cast<WW::FreeObject *>(ptrs[MAX_COUNT])));
+    EXPECT_EQ(queue->pop_all(index, begin, end), 1);
+    remote_free.release(id);
+
+    for (void * ptr : ptrs) {
+        thread_cache.deallocate(ptr, SIZE);
+    }
+}
+
+TEST(RemoteFreeTest, CarveOwner)
+{
+    constexpr std::size_t SIZE = 8192;
+    constexpr std::size_t OWNER = 7;
+    WW::CentralCache & central_cache = WW::CentralCache::get_central_cache();
+    WW::PageCache & page_cache = WW::PageCache::get_page_cache();
+
+    // 从页段切出时记录所属线程
+    WW::FreeObject * begin = nullptr;
+    WW::FreeObject * end = nullptr;
+    ASSERT_EQ(central_cache.fetch_range(SIZE, 1, begin, end, OWNER), 1);
+    WW::Span * span = page_cache.object_to_span(begin);
+    EXPECT_EQ(span->owner(), OWNER);
+
+    // 没有所属线程时清除之前的记录
+    WW::FreeObject * other = nullptr;
+    ASSERT_EQ(central_cache.fetch_range(SIZE, 1, other, end), 1);
+    EXPECT_EQ(page_cache.object_to_span(other)->owner(), 0);
+
+    central_cache.return_range(SIZE, begin);
+    central_cache.return_range(SIZE, other);
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include <Size.h>
+
+/**
+ * @brief 按照区间逐段对齐，作为查表结果的参照
+ */
+std::size_t reference_round_up(std::size_t size)
+{
+    if (size <= 128) {
+        return (size + 8 - 1) & ~(8 - 1);
+    } else if (size <= 1024) {
+        return (size + 16 - 1) & ~(16 - 1);
+    } else if (size <= 8192) {
+        return (size + 128 - 1) & ~(128 - 1);
+    } else if (size <= 65536) {
+        return (size + 1024 - 1) & ~(1024 - 1);
+    } else {
+        return (size + 8192 - 1) & ~(8192 - 1);
+    }
+}
+
+TEST(SizeTest, SizeToClass)
+{
+    std::size_t last_index = 0;
+
+    for (std::size_t size = 1; size <= WW::MAX_MEMORY_SIZE; ++size) {
+        WW::SizeClass size_class = WW::Size::size_to_class(size);
+
+        EXPECT_EQ(size_class.size, reference_round_up(size));
+        EXPECT_EQ(size_class.index, WW::Size::size_to_index(size));
+        EXPECT_EQ(size_class.size, WW::Size::round_up(size));
+        EXPECT_EQ(WW::Size::index_to_size(size_class.index), size_class.size);
+
+        // 索引随大小单调递增，且每次最多增加1
+        EXPECT_GE(size_class.index, last_index);
+        EXPECT_LE(size_class.index, last_index + 1);
+        last_index = size_class.index;
+    }
+
+    EXPECT_EQ(last_index, WW::MAX_ARRAY_SIZE - 1);
+}
+
+TEST(SizeTest, BatchSize)
+{
+    EXPECT_EQ(WW::Size::batch_size(0), WW::MAX_BLOCK_NUM);
+    EXPECT_EQ(WW::Size::batch_size(WW::MAX_ARRAY_SIZE - 1), WW::MIN_BLOCK_NUM);
+
+    // 内存块越大，每批数量越少
+    for (std::size_t index = 1; index < WW::MAX_ARRAY_SIZE; ++index) {
+        EXPECT_LE(WW::Size::batch_size(index), WW::Size::batch_size(index - 1));
+        EXPECT_GE(WW::Size::batch_size(index), WW::MIN_BLOCK_NUM);
+    }
+}
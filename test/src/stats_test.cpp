@@ -0,0 +1,83 @@
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <ThreadCache.h>
+#include <Stats.h>
+#include <Size.h>
+
+TEST(StatsTest, CountersAndTiers)
+{
+    constexpr int COUNT = 1000;
+    constexpr std::size_t SIZE = 200;
+    std::size_t index = WW::Size::size_to_index(WW::Size::round_up(SIZE));
+
+    WW::MemoryStats before = WW::get_stats();
+
+    WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+    std::vector<void *> ptrs;
+    for (int i = 0; i < COUNT; ++i) {
+        ptrs.emplace_back(thread_cache.allocate(SIZE));
+    }
+
+    WW::MemoryStats during = WW::get_stats();
+    EXPECT_EQ(during.size_classes[index].allocate_count - before.size_classes[index].allocate_count, COUNT);
+    EXPECT_GE(during.size_classes[index].in_use, COUNT);
+    EXPECT_GE(during.in_use_bytes, COUNT * SIZE);
+    EXPECT_GT(during.size_classes[index].fetch_count, before.size_classes[index].fetch_count);
+    EXPECT_GT(during.size_classes[index].spans, 0);
+    EXPECT_GT(during.system_allocated_bytes, 0);
+    EXPECT_GE(during.system_reserved_bytes, during.system_allocated_bytes);
+
+    for (void * ptr : ptrs) {
+        thread_cache.deallocate(ptr, SIZE);
+    }
+
+    WW::MemoryStats after = WW::get_stats();
+    EXPECT_EQ(after.size_classes[index].deallocate_count - before.size_classes[index].deallocate_count, COUNT);
+    EXPECT_EQ(after.size_classes[index].in_use, before.size_classes[index].in_use);
+    // 释放的内存块留在线程缓存或者归还中心缓存
+    EXPECT_GE(after.thread_cache_bytes + after.transfer_cache_bytes + after.central_cache_bytes, COUNT * SIZE);
+}
+
+TEST(StatsTest, ExitedThreads)
+{
+    constexpr int THREAD_NUM = 4;
+    constexpr int COUNT = 100;
+    constexpr std::size_t SIZE = 24;
+    std::size_t index = WW::Size::size_to_index(WW::Size::round_up(SIZE));
+
+    WW::MemoryStats before = WW::get_stats();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREAD_NUM; ++i) {
+        threads.emplace_back([]() {
+            WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+            for (int j = 0; j < COUNT; ++j) {
+                thread_cache.deallocate(thread_cache.allocate(SIZE), SIZE);
+            }
+        });
+    }
+
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    // 已退出线程的计数仍然保留，线程缓存已经全部归还
+    WW::MemoryStats after = WW::get_stats();
+    EXPECT_EQ(after.size_classes[index].allocate_count - before.size_classes[index].allocate_count, THREAD_NUM * COUNT);
+    EXPECT_EQ(after.size_classes[index].deallocate_count - before.size_classes[index].deallocate_count, THREAD_NUM * COUNT);
+    EXPECT_EQ(after.size_classes[index].thread_cached, before.size_classes[index].thread_cached);
+}
+
+TEST(StatsTest, Format)
+{
+    WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+    void * ptr = thread_cache.allocate(64);
+
+    std::string text = WW::format_stats(WW::get_stats());
+    EXPECT_NE(text.find("in use by application"), std::string::npos);
+    EXPECT_NE(text.find("page cache released"), std::string::npos);
+
+    thread_cache.deallocate(ptr, 64);
+}
@@ -1,8 +1,17 @@
+#include <cstdio>
+#include <future>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 #include <ThreadCache.h>
+#include <Size.h>
 
 class ThreadCacheTest : public testing::Test
 {
@@ -61,4 +70,297 @@ TEST_F(ThreadCacheTest, MultiThreadAllocateAndDeallocate)
     for (auto & thread : threads) {
         thread.join();
     }
-}
\ No newline at end of file
+}
+
+TEST_F(ThreadCacheTest, UnsizedDeallocate)
+{
+    // 不同大小的内存都可以不提供大小直接释放
+    std::vector<void *> ptrs;
+    for (std::size_t size = 1; size <= WW::MAX_MEMORY_SIZE; size = size * 3 + 1) {
+        void * ptr = thread_cache.allocate(size);
+        EXPECT_NE(ptr, nullptr);
+        ptrs.emplace_back(ptr);
+    }
+
+    for (void * ptr : ptrs) {
+        thread_cache.deallocate(ptr);
+    }
+
+    // 超出管理范围的内存也可以释放
+    void * large = thread_cache.allocate(WW::MAX_MEMORY_SIZE + 1);
+    EXPECT_NE(large, nullptr);
+    thread_cache.deallocate(large);
+
+    thread_cache.deallocate(nullptr);
+}
+
+TEST_F(ThreadCacheTest, LargeObject)
+{
+    // 大内存由页缓存提供，按页对齐
+    for (std::size_t size : { WW::MAX_MEMORY_SIZE + 1, std::size_t(1) << 20, std::size_t(16) << 20, WW::DIRECT_MMAP_SIZE + 1 }) {
+        char * ptr = static_cast<char *>(thread_cache.allocate(size));
+        ASSERT_NE(ptr, nullptr);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(ptr) % WW::PAGE_SIZE, 0);
+        ptr[0] = 1;
+        ptr[size - 1] = 1;
+
+        WW::Span * span = WW::PageCache::get_page_cache().object_to_span(ptr);
+        ASSERT_NE(span, nullptr);
+        EXPECT_GE(span->object_size(), size);
+
+        thread_cache.deallocate(ptr, size);
+    }
+
+    // 释放的大内存可以马上复用
+    void * first = thread_cache.allocate(std::size_t(4) << 20);
+    thread_cache.deallocate(first);
+    void * second = thread_cache.allocate(std::size_t(4) << 20);
+    EXPECT_EQ(first, second);
+    thread_cache.deallocate(second);
+}
+
+TEST_F(ThreadCacheTest, AlignedAllocation)
+{
+    for (std::size_t alignment = 1; alignment <= (std::size_t(1) << 20); alignment <<= 1) {
+        for (std::size_t size : { std::size_t(1), std::size_t(100), std::size_t(5000), WW::MAX_MEMORY_SIZE + 1 }) {
+            char * ptr = static_cast<char *>(thread_cache.allocate_aligned(size, alignment));
+            ASSERT_NE(ptr, nullptr);
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(ptr) % alignment, 0);
+            ptr[0] = 1;
+            ptr[size - 1] = 1;
+
+            WW::Span * span = WW::PageCache::get_page_cache().object_to_span(ptr);
+            ASSERT_NE(span, nullptr);
+            EXPECT_GE(span->object_size(), size);
+
+            thread_cache.deallocate_aligned(ptr, size, alignment);
+        }
+    }
+
+    // 不超过页大小的对齐使用对应的内存块，可以直接按大小释放
+    void * ptr = thread_cache.allocate_aligned(64, 64);
+    EXPECT_EQ(WW::PageCache::get_page_cache().object_to_span(ptr)->object_size(), 64);
+    thread_cache.deallocate(ptr);
+
+    // 超过页大小的对齐使用按需页数的大内存页段，可以直接释放
+    ptr = thread_cache.allocate_aligned(64, 2 * WW::PAGE_SIZE);
+    WW::Span * span = WW::PageCache::get_page_cache().object_to_span(ptr);
+    EXPECT_TRUE(span->is_large());
+    EXPECT_EQ(span->object_size(), WW::PAGE_SIZE);
+    EXPECT_EQ(thread_cache.usable_size(ptr), WW::PAGE_SIZE);
+    thread_cache.deallocate(ptr);
+
+    // 缩小到小内存时换到对应的内存块
+    ptr = thread_cache.allocate_aligned(100, 4 * WW::PAGE_SIZE);
+    void * moved = thread_cache.reallocate(ptr, 100, 50);
+    ASSERT_NE(moved, nullptr);
+    EXPECT_FALSE(WW::PageCache::get_page_cache().object_to_span(moved)->is_large());
+    thread_cache.deallocate(moved, 50);
+
+    EXPECT_EQ(thread_cache.allocate_aligned(64, 3), nullptr);
+}
+
+TEST_F(ThreadCacheTest, Reallocate)
+{
+    // 小内存在原内存块内调整时返回原指针
+    char * ptr = static_cast<char *>(thread_cache.allocate(100));
+    std::size_t usable = thread_cache.usable_size(ptr);
+    EXPECT_EQ(usable, WW::Size::round_up(100));
+    for (std::size_t i = 0; i < 100; ++i) {
+        ptr[i] = static_cast<char>(i);
+    }
+    EXPECT_EQ(thread_cache.reallocate(ptr, 100, usable), ptr);
+
+    // 缩小到更小的大小时换到对应的内存块，之后可以按新大小释放
+    char * shrunk = static_cast<char *>(thread_cache.reallocate(ptr, usable, 10));
+    ASSERT_NE(shrunk, nullptr);
+    EXPECT_NE(shrunk, ptr);
+    EXPECT_EQ(thread_cache.usable_size(shrunk), WW::Size::round_up(10));
+    for (std::size_t i = 0; i < 10; ++i) {
+        EXPECT_EQ(shrunk[i], static_cast<char>(i));
+    }
+    thread_cache.deallocate(shrunk, 10);
+    ptr = static_cast<char *>(thread_cache.allocate(100));
+    for (std::size_t i = 0; i < 100; ++i) {
+        ptr[i] = static_cast<char>(i);
+    }
+
+    // 超出内存块时重新申请并复制
+    char * moved = static_cast<char *>(thread_cache.reallocate(ptr, 100, usable + 1));
+    ASSERT_NE(moved, nullptr);
+    EXPECT_NE(moved, ptr);
+    EXPECT_GE(thread_cache.usable_size(moved), usable + 1);
+    for (std::size_t i = 0; i < 100; ++i) {
+        EXPECT_EQ(moved[i], static_cast<char>(i));
+    }
+
+    // 大内存缩小时归还多出的页，之后可以原地扩展回来
+    constexpr std::size_t LARGE = std::size_t(1) << 20;
+    char * large = static_cast<char *>(thread_cache.reallocate(moved, usable + 1, LARGE));
+    ASSERT_NE(large, nullptr);
+    EXPECT_EQ(thread_cache.usable_size(large), LARGE);
+    large[0] = 1;
+    EXPECT_EQ(thread_cache.reallocate(large, LARGE, LARGE / 2), large);
+    EXPECT_EQ(thread_cache.usable_size(large), LARGE / 2);
+    EXPECT_EQ(thread_cache.reallocate(large, LARGE / 2, LARGE), large);
+    EXPECT_EQ(thread_cache.usable_size(large), LARGE);
+    EXPECT_EQ(large[0], 1);
+    large[LARGE - 1] = 1;
+
+    EXPECT_EQ(thread_cache.reallocate(large, LARGE, 0), nullptr);
+    EXPECT_EQ(thread_cache.usable_size(nullptr), 0);
+}
+
+TEST_F(ThreadCacheTest, AdaptiveBatch)
+{
+    constexpr std::size_t COUNT = 20000;
+    constexpr std::size_t SIZE = 48;
+    std::size_t index = WW::Size::size_to_index(SIZE);
+    std::size_t batch = WW::Size::batch_size(index);
+
+    // 在新线程中运行，自由表从最小长度开始
+    std::thread thread([&]() {
+        WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+        WW::MemoryStats before = WW::get_stats();
+
+        std::vector<void *> ptrs;
+        for (std::size_t i = 0; i < COUNT; ++i) {
+            ptrs.emplace_back(thread_cache.allocate(SIZE));
+        }
+
+        // 持续缺少时批量成倍增长，获取次数远少于逐次加一
+        WW::MemoryStats during = WW::get_stats();
+        std::size_t underflows = during.size_classes[index].underflow_count - before.size_classes[index].underflow_count;
+        EXPECT_GT(underflows, 0);
+        EXPECT_LT(underflows, 64);
+
+        for (void * ptr : ptrs) {
+            thread_cache.deallocate(ptr, SIZE);
+        }
+
+        // 持续超长时归还中心缓存，线程缓存不超过最大长度
+        WW::MemoryStats after = WW::get_stats();
+        EXPECT_GT(after.size_classes[index].overflow_count, during.size_classes[index].overflow_count);
+        EXPECT_LE(after.size_classes[index].thread_cached, batch * WW::MAX_LIST_BATCH_NUM);
+    });
+    thread.join();
+}
+
+/**
+ * @brief 申请并释放指定总量的内存，使线程缓存达到上限
+ * @details 分散到多种大小，避免单个自由表先达到最大长度
+ */
+void fill_thread_cache(WW::ThreadCache & thread_cache, std::size_t total)
+{
+    constexpr std::size_t STEP = 1024;
+    constexpr std::size_t CLASSES = 64;
+
+    std::vector<std::pair<void *, std::size_t>> ptrs;
+    for (std::size_t size = STEP; size <= STEP * CLASSES; size += STEP) {
+        for (std::size_t bytes = 0; bytes < total / CLASSES; bytes += size) {
+            ptrs.emplace_back(thread_cache.allocate(size), size);
+        }
+    }
+
+    for (auto & ptr : ptrs) {
+        thread_cache.deallocate(ptr.first, ptr.second);
+    }
+}
+
+TEST_F(ThreadCacheTest, CacheBudget)
+{
+    constexpr std::size_t BUDGET = 4 * 1024 * 1024;
+    WW::ThreadCacheRegistry & registry = WW::ThreadCacheRegistry::get_thread_cache_registry();
+    std::size_t old_budget = registry.max_size();
+    registry.set_max_size(BUDGET);
+    EXPECT_EQ(registry.max_size(), BUDGET);
+
+    std::thread thread([&]() {
+        WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+        EXPECT_GE(thread_cache.max_cached_size(), WW::MIN_THREAD_CACHE_SIZE);
+
+        // 释放的内存超过上限时归还中心缓存，上限不会超过总量
+        fill_thread_cache(thread_cache, 8 * 1024 * 1024);
+        EXPECT_LE(thread_cache.cached_size(), thread_cache.max_cached_size());
+        EXPECT_GT(thread_cache.max_cached_size(), WW::MIN_THREAD_CACHE_SIZE);
+        EXPECT_LE(thread_cache.max_cached_size(), BUDGET);
+    });
+    thread.join();
+
+    registry.set_max_size(old_budget);
+}
+
+TEST_F(ThreadCacheTest, StealFromIdleThread)
+{
+    // 除主线程和空闲线程的最小上限外只剩下少量内存
+    constexpr std::size_t BUDGET = 3 * WW::MIN_THREAD_CACHE_SIZE;
+    WW::ThreadCacheRegistry & registry = WW::ThreadCacheRegistry::get_thread_cache_registry();
+    std::size_t old_budget = registry.max_size();
+    registry.set_max_size(BUDGET);
+
+    std::promise<WW::ThreadCache *> filled;
+    std::promise<void> finished;
+
+    // 空闲线程先占用全部未分配的内存
+    std::thread idle([&]() {
+        WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+        fill_thread_cache(thread_cache, 8 * 1024 * 1024);
+        filled.set_value(&thread_cache);
+        finished.get_future().wait();
+    });
+
+    WW::ThreadCache * idle_cache = filled.get_future().get();
+    EXPECT_LT(registry.unclaimed_size(), WW::THREAD_CACHE_STEAL_SIZE);
+    std::size_t idle_size = idle_cache->max_cached_size();
+
+    // 繁忙线程从空闲线程的上限中获取
+    std::thread busy([&]() {
+        WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+        fill_thread_cache(thread_cache, 8 * 1024 * 1024);
+        EXPECT_GT(thread_cache.max_cached_size(), WW::MIN_THREAD_CACHE_SIZE);
+    });
+    busy.join();
+
+    EXPECT_LT(idle_cache->max_cached_size(), idle_size);
+    EXPECT_GE(idle_cache->max_cached_size(), WW::MIN_THREAD_CACHE_SIZE);
+
+    finished.set_value();
+    idle.join();
+
+    registry.set_max_size(old_budget);
+}
+
+TEST_F(ThreadCacheTest, OutOfMemory)
+{
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+
+    if (pid == 0) {
+        // 限制虚拟内存，之后向系统预留内存会失败
+        rlimit limit;
+        limit.rlim_cur = 0;
+        limit.rlim_max = RLIM_INFINITY;
+        long pages = 0;
+        FILE * statm = std::fopen("/proc/self/statm", "r");
+        if (statm == nullptr || std::fscanf(statm, "%ld", &pages) != 1) {
+            _exit(0);
+        }
+        std::fclose(statm);
+        limit.rlim_cur = static_cast<rlim_t>(pages) * sysconf(_SC_PAGESIZE) + 16 * 1024 * 1024;
+        setrlimit(RLIMIT_AS, &limit);
+
+        // 内存耗尽时返回空指针而不是崩溃
+        WW::ThreadCache & cache = WW::ThreadCache::get_thread_cache();
+        for (std::size_t i = 0; i < 1024 * 1024 * 1024 / 64; ++i) {
+            if (cache.allocate(64) == nullptr) {
+                _exit(0);
+            }
+        }
+        _exit(1);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
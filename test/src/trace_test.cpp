@@ -0,0 +1,82 @@
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+#include <Trace.h>
+#include <ThreadCache.h>
+
+TEST(TraceTest, RecordAndLoad)
+{
+    std::string path = testing::TempDir() + "ww_trace_test.bin";
+    WW::Trace & trace = WW::Trace::get_trace();
+    // 开始记录之前创建的线程缓存同样记录
+    WW::ThreadCache & thread_cache = WW::ThreadCache::get_thread_cache();
+    ASSERT_TRUE(trace.start(path.c_str()));
+    EXPECT_TRUE(trace.enabled());
+    EXPECT_FALSE(trace.start(path.c_str()));
+
+    // 超过缓冲区大小，其中一部分交给其他线程释放
+    constexpr std::size_t COUNT = WW::TRACE_BUFFER_SIZE * 2;
+    std::vector<void *> ptrs;
+    for (std::size_t i = 0; i < COUNT; ++i) {
+        ptrs.emplace_back(thread_cache.allocate(i % 256 + 1));
+    }
+
+    std::thread([&]() {
+        WW::ThreadCache & local_cache = WW::ThreadCache::get_thread_cache();
+        for (std::size_t i = 0; i < COUNT / 2; ++i) {
+            local_cache.deallocate(ptrs[i], i % 256 + 1);
+        }
+    }).join();
+
+    for (std::size_t i = COUNT / 2; i < COUNT; ++i) {
+        thread_cache.deallocate(ptrs[i]);
+    }
+
+    trace.stop();
+    EXPECT_FALSE(trace.enabled());
+
+    // 停止后不再记录
+    thread_cache.deallocate(thread_cache.allocate(8), 8);
+
+    std::vector<WW::TraceEvent> events;
+    ASSERT_TRUE(WW::Trace::load(path.c_str(), events));
+    ASSERT_EQ(events.size(), COUNT * 2);
+
+    // 每个线程的事件保持先后顺序，释放的内存块都能找到之前的申请
+    std::map<std::uint16_t, std::size_t> thread_events;
+    std::map<std::uint64_t, std::uint64_t> live;
+    std::size_t allocations = 0;
+    for (const WW::TraceEvent & event : events) {
+        ++thread_events[event.thread];
+        if (event.type == static_cast<std::uint16_t>(WW::TraceEventType::ALLOCATE)) {
+            live[event.object] = event.size;
+            ++allocations;
+        }
+    }
+    EXPECT_EQ(allocations, COUNT);
+    EXPECT_EQ(thread_events.size(), 2);
+    EXPECT_EQ(live.size(), COUNT);
+
+    for (const WW::TraceEvent & event : events) {
+        if (event.type == static_cast<std::uint16_t>(WW::TraceEventType::DEALLOCATE)) {
+            ASSERT_EQ(live.count(event.object), 1);
+            EXPECT_TRUE(event.size == 0 || event.size == live[event.object]);
+        }
+    }
+
+    // 再次记录时覆盖之前的文件
+    ASSERT_TRUE(trace.start(path.c_str()));
+    thread_cache.deallocate(thread_cache.allocate(8), 8);
+    trace.stop();
+    events.clear();
+    ASSERT_TRUE(WW::Trace::load(path.c_str(), events));
+    EXPECT_EQ(events.size(), 2);
+
+    std::remove(path.c_str());
+    EXPECT_FALSE(WW::Trace::load(path.c_str(), events));
+}